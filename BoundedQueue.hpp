@@ -0,0 +1,105 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef BOUNDEDQUEUE_HPP
+#define BOUNDEDQUEUE_HPP
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// Hands work from the render thread to a worker thread. push() blocks
+// while the queue is full, so a slow consumer throttles the producer
+// instead of piling up memory.
+template <typename T>
+class BoundedQueue
+{
+	private:
+		std::deque<T> _items;
+		size_t _capacity;
+		bool _closed;
+		std::mutex _mutex;
+		std::condition_variable _notEmpty;
+		std::condition_variable _notFull;
+
+	public:
+		BoundedQueue(size_t capacity = 8)
+		{
+			_capacity = capacity;
+			_closed = false;
+		}
+
+		// Returns true if the caller had to wait.
+		bool push(const T& item)
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			bool waited = false;
+			while (_items.size() >= _capacity && !_closed)
+			{
+				waited = true;
+				_notFull.wait(lock);
+			}
+			_items.push_back(item);
+			_notEmpty.notify_one();
+			return waited;
+		}
+
+		// Returns false once the queue is closed and drained.
+		bool pop(T& item)
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			while (_items.empty() && !_closed)
+				_notEmpty.wait(lock);
+			if (_items.empty())
+				return false;
+			item = _items.front();
+			_items.pop_front();
+			_notFull.notify_one();
+			return true;
+		}
+
+		// Doesn't wait. Returns false if there's nothing to take.
+		bool tryPop(T& item)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_items.empty())
+				return false;
+			item = _items.front();
+			_items.pop_front();
+			_notFull.notify_one();
+			return true;
+		}
+
+		bool full()
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _items.size() >= _capacity;
+		}
+
+		void close()
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_closed = true;
+			_notEmpty.notify_all();
+			_notFull.notify_all();
+		}
+};
+
+#endif // BOUNDEDQUEUE_HPP
@@ -0,0 +1,246 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "BrickCache.hpp"
+
+
+static size_t brickCacheDataOffset(uint32_t bricks)
+{
+	size_t table = sizeof(BrickCacheHeader)
+		+ (size_t)bricks * bricks * bricks * sizeof(uint32_t);
+	return (table + 4095) & ~(size_t)4095;
+}
+
+BrickCache::BrickCache()
+{
+	_map = NULL;
+	_size = 0;
+	_header = NULL;
+	_table = NULL;
+	_samples = NULL;
+}
+
+BrickCache::~BrickCache()
+{
+	close();
+}
+
+uint64_t BrickCache::hash(const void *data, size_t len, uint64_t h)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	for (size_t i = 0; i < len; i++)
+	{
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+bool BrickCache::open(const char *path, uint64_t key, int res)
+{
+	close();
+
+	int fd = ::open(path, O_RDONLY);
+	if (fd == -1)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(BrickCacheHeader))
+	{
+		::close(fd);
+		return false;
+	}
+
+	void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mem == MAP_FAILED)
+	{
+		perror("mmap");
+		return false;
+	}
+
+	_map = (unsigned char *)mem;
+	_size = st.st_size;
+	_header = (const BrickCacheHeader *)_map;
+
+	uint32_t b = _header->bricks;
+	size_t brickBytes = BRICK_CACHE_SIZE * BRICK_CACHE_SIZE * BRICK_CACHE_SIZE
+		* sizeof(uint16_t);
+	if (_header->magic != BRICK_CACHE_MAGIC
+			|| _header->version != BRICK_CACHE_VERSION
+			|| _header->key != key
+			|| _header->res != (uint32_t)res
+			|| _header->brickSize != BRICK_CACHE_SIZE
+			|| b != (uint32_t)(res + BRICK_CACHE_SIZE - 1) / BRICK_CACHE_SIZE
+			|| _size != brickCacheDataOffset(b) + _header->stored * brickBytes)
+	{
+		close();
+		return false;
+	}
+
+	_table = (const uint32_t *)(_map + sizeof(BrickCacheHeader));
+	_samples = (const uint16_t *)(_map + brickCacheDataOffset(b));
+	return true;
+}
+
+void BrickCache::close()
+{
+	if (_map == NULL)
+		return;
+
+	munmap(_map, _size);
+	_map = NULL;
+	_header = NULL;
+	_table = NULL;
+	_samples = NULL;
+}
+
+int BrickCache::res()
+{
+	return _header->res;
+}
+
+int BrickCache::bricks()
+{
+	return _header->bricks;
+}
+
+int BrickCache::stored()
+{
+	return _header->stored;
+}
+
+const uint16_t *BrickCache::brick(int bx, int by, int bz, uint16_t& value)
+{
+	int b = _header->bricks;
+	uint32_t entry = _table[(bz * b + by) * b + bx];
+	if (entry & BRICK_CACHE_CONSTANT)
+	{
+		value = entry & 0xFFFF;
+		return NULL;
+	}
+
+	// Corrupt files could point anywhere.
+	if (entry >= _header->stored)
+	{
+		value = 0;
+		return NULL;
+	}
+
+	return _samples + (size_t)entry
+		* BRICK_CACHE_SIZE * BRICK_CACHE_SIZE * BRICK_CACHE_SIZE;
+}
+
+bool BrickCache::write(const char *path, uint64_t key, int res,
+		const uint16_t *field)
+{
+	const int S = BRICK_CACHE_SIZE;
+	int b = (res + S - 1) / S;
+
+	std::vector<uint32_t> table(b * b * b);
+	std::vector<uint16_t> samples;
+	std::vector<uint16_t> brick(S * S * S);
+
+	for (int bz = 0; bz < b; bz++)
+		for (int by = 0; by < b; by++)
+			for (int bx = 0; bx < b; bx++)
+			{
+				// Bricks at the far end may stick out of the field.
+				// Repeating the last sample keeps constant bricks
+				// constant.
+				bool constant = true;
+				for (int z = 0; z < S; z++)
+					for (int y = 0; y < S; y++)
+						for (int x = 0; x < S; x++)
+						{
+							int fx = std::min(bx * S + x, res - 1);
+							int fy = std::min(by * S + y, res - 1);
+							int fz = std::min(bz * S + z, res - 1);
+							uint16_t v = field[((size_t)fz * res + fy) * res
+								+ fx];
+							brick[(z * S + y) * S + x] = v;
+							constant = constant && v == brick[0];
+						}
+
+				uint32_t& entry = table[(bz * b + by) * b + bx];
+				if (constant)
+				{
+					entry = BRICK_CACHE_CONSTANT | brick[0];
+				}
+				else
+				{
+					entry = samples.size() / (S * S * S);
+					samples.insert(samples.end(), brick.begin(), brick.end());
+				}
+			}
+
+	BrickCacheHeader header;
+	memset(&header, 0, sizeof header);
+	header.magic = BRICK_CACHE_MAGIC;
+	header.version = BRICK_CACHE_VERSION;
+	header.key = key;
+	header.res = res;
+	header.brickSize = S;
+	header.bricks = b;
+	header.stored = samples.size() / (S * S * S);
+
+	// Other processes might be looking for the same file right now.
+	// They either see all of it or nothing.
+	char pid[32];
+	snprintf(pid, sizeof pid, ".%d", (int)getpid());
+	std::string tmp = std::string(path) + pid;
+
+	FILE *fp = fopen(tmp.c_str(), "wb");
+	if (fp == NULL)
+	{
+		perror("fopen");
+		return false;
+	}
+
+	std::vector<unsigned char> padding(brickCacheDataOffset(b)
+			- sizeof header - table.size() * sizeof(uint32_t));
+	bool ok = fwrite(&header, sizeof header, 1, fp) == 1
+		&& fwrite(table.data(), sizeof(uint32_t), table.size(), fp)
+			== table.size()
+		&& fwrite(padding.data(), 1, padding.size(), fp) == padding.size()
+		&& fwrite(samples.data(), sizeof(uint16_t), samples.size(), fp)
+			== samples.size();
+	if (fclose(fp) != 0)
+		ok = false;
+
+	if (!ok || rename(tmp.c_str(), path) == -1)
+	{
+		perror(tmp.c_str());
+		unlink(tmp.c_str());
+		return false;
+	}
+
+	return true;
+}
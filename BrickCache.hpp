@@ -0,0 +1,94 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef BRICKCACHE_HPP
+#define BRICKCACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// A sampled field (half floats, res^3) on disk, split into bricks of
+// BRICK_CACHE_SIZE^3 samples. Bricks that hold the same value
+// everywhere, like those far away from the surface where the field is
+// clamped, are not stored. Only their value is kept in the table.
+//
+//     BrickCacheHeader
+//     uint32_t table[bricks^3], x fastest
+//     (padding up to 4 KB)
+//     uint16_t samples[stored][BRICK_CACHE_SIZE^3]
+//
+// A table entry with the top bit set holds the value of a constant
+// brick in its lower 16 bits. Otherwise, it's the index of a stored
+// brick. Files are only mapped read-only, so any number of processes
+// can share them. Pages are only read once a brick is looked at.
+
+#define BRICK_CACHE_MAGIC 0x43425047  // "GPBC"
+#define BRICK_CACHE_VERSION 1
+#define BRICK_CACHE_SIZE 8
+#define BRICK_CACHE_CONSTANT 0x80000000u
+
+struct BrickCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint32_t res;
+	uint32_t brickSize;
+	uint32_t bricks;
+	uint32_t stored;
+};
+
+class BrickCache
+{
+	private:
+		unsigned char *_map;
+		size_t _size;
+		const BrickCacheHeader *_header;
+		const uint32_t *_table;
+		const uint16_t *_samples;
+
+	public:
+		BrickCache();
+		~BrickCache();
+
+		// FNV-1a, for building keys out of everything the field
+		// depends on.
+		static uint64_t hash(const void *data, size_t len,
+				uint64_t h = 14695981039346656037ULL);
+
+		// Fails if there's no such file or it's for another key.
+		bool open(const char *path, uint64_t key, int res);
+		void close();
+
+		int res();
+		int bricks();
+		int stored();
+
+		// Samples of one brick. NULL for constant bricks, their value
+		// is returned in "value" instead.
+		const uint16_t *brick(int bx, int by, int bz, uint16_t& value);
+
+		// Split "field" into bricks and save it. The file appears at
+		// "path" only when it's complete.
+		static bool write(const char *path, uint64_t key, int res,
+				const uint16_t *field);
+};
+
+#endif // BRICKCACHE_HPP
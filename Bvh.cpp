@@ -0,0 +1,602 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+
+#include "Bvh.hpp"
+#include "Parallel.hpp"
+
+#define BVH_BINS 16
+
+// Ranges of more triangles are swept in parallel chunks.
+#define BVH_CHUNK 65536
+
+
+struct BvhBox
+{
+	float lo[3];
+	float hi[3];
+
+	void reset()
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			lo[i] = 1e30;
+			hi[i] = -1e30;
+		}
+	}
+
+	void grow(const float *p)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			lo[i] = std::min(lo[i], p[i]);
+			hi[i] = std::max(hi[i], p[i]);
+		}
+	}
+
+	void grow(const BvhBox& b)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			lo[i] = std::min(lo[i], b.lo[i]);
+			hi[i] = std::max(hi[i], b.hi[i]);
+		}
+	}
+
+	float area() const
+	{
+		float d[3];
+		for (int i = 0; i < 3; i++)
+			d[i] = hi[i] - lo[i];
+		if (d[0] < 0)
+			return 0;
+		return 2 * (d[0] * d[1] + d[1] * d[2] + d[2] * d[0]);
+	}
+};
+
+struct BvhBin
+{
+	BvhBox box;
+	int count;
+};
+
+struct BvhRange
+{
+	int first;
+	int count;
+	BvhBox box;
+	BvhBox centers;
+};
+
+// A node of the top of the tree. If it hasn't been split, its subtree
+// is built by a separate task into "nodes".
+struct BvhTop
+{
+	BvhRange range;
+	int depth;
+	int left;
+	int right;
+
+	std::vector<BvhNode> nodes;
+	BvhChild child;
+	int maxDepth;
+};
+
+class BvhBuilder
+{
+	public:
+		std::vector<BvhBox> bounds;
+		std::vector<float> centers;
+		std::vector<int> order;
+		std::vector<BvhTop> tops;
+		int taskSize;
+
+		void measure(BvhRange& r);
+		bool split(const BvhRange& r, BvhRange& left, BvhRange& right);
+		void emit(const BvhRange& r, int depth, std::vector<BvhNode>& out,
+				BvhChild& c, int& maxDepth);
+		int top(const BvhRange& r, int depth);
+		BvhChild assemble(int t, std::vector<BvhNode>& out);
+};
+
+// Most ranges are small. Starting threads for them would take longer
+// than the work itself.
+template <typename F>
+static void sweepChunks(int chunks, F body)
+{
+	if (chunks == 1)
+		body(0);
+	else
+		parallelFor(chunks, body);
+}
+
+static void setBox(BvhChild& c, const BvhBox& b)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		c.lo[i] = b.lo[i];
+		c.hi[i] = b.hi[i];
+	}
+}
+
+void BvhBuilder::measure(BvhRange& r)
+{
+	int chunks = (r.count + BVH_CHUNK - 1) / BVH_CHUNK;
+	std::vector<BvhRange> part(chunks);
+	auto sweep = [&](int c)
+	{
+		part[c].box.reset();
+		part[c].centers.reset();
+		int end = std::min(r.count, (c + 1) * BVH_CHUNK);
+		for (int i = c * BVH_CHUNK; i < end; i++)
+		{
+			int t = order[r.first + i];
+			part[c].box.grow(bounds[t]);
+			part[c].centers.grow(&centers[3 * t]);
+		}
+	};
+	sweepChunks(chunks, sweep);
+
+	r.box.reset();
+	r.centers.reset();
+	for (int c = 0; c < chunks; c++)
+	{
+		r.box.grow(part[c].box);
+		r.centers.grow(part[c].centers);
+	}
+}
+
+bool BvhBuilder::split(const BvhRange& r, BvhRange& left,
+		BvhRange& right)
+{
+	if (r.count <= 1)
+		return false;
+
+	float scale[3];
+	for (int a = 0; a < 3; a++)
+	{
+		float extent = r.centers.hi[a] - r.centers.lo[a];
+		scale[a] = (extent > 0 ? BVH_BINS / extent : 0);
+	}
+
+	auto binOf = [&](int t, int a)
+	{
+		int k = (int)((centers[3 * t + a] - r.centers.lo[a]) * scale[a]);
+		return std::min(k, BVH_BINS - 1);
+	};
+
+	// Count triangles and grow boxes in bins along all three axes.
+	int chunks = (r.count + BVH_CHUNK - 1) / BVH_CHUNK;
+	std::vector<BvhBin> bins(chunks * 3 * BVH_BINS);
+	auto sweep = [&](int c)
+	{
+		BvhBin *b = &bins[c * 3 * BVH_BINS];
+		for (int k = 0; k < 3 * BVH_BINS; k++)
+		{
+			b[k].box.reset();
+			b[k].count = 0;
+		}
+
+		int end = std::min(r.count, (c + 1) * BVH_CHUNK);
+		for (int i = c * BVH_CHUNK; i < end; i++)
+		{
+			int t = order[r.first + i];
+			for (int a = 0; a < 3; a++)
+			{
+				BvhBin& bin = b[a * BVH_BINS + binOf(t, a)];
+				bin.box.grow(bounds[t]);
+				bin.count++;
+			}
+		}
+	};
+	sweepChunks(chunks, sweep);
+	for (int c = 1; c < chunks; c++)
+	{
+		for (int k = 0; k < 3 * BVH_BINS; k++)
+		{
+			bins[k].box.grow(bins[c * 3 * BVH_BINS + k].box);
+			bins[k].count += bins[c * 3 * BVH_BINS + k].count;
+		}
+	}
+
+	// Cost of a split relative to testing all triangles, which is
+	// r.count. Visiting a node costs as much as testing a triangle.
+	float bestCost = 1e30;
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float area = r.box.area();
+	for (int a = 0; a < 3; a++)
+	{
+		if (scale[a] == 0)
+			continue;
+
+		const BvhBin *b = &bins[a * BVH_BINS];
+		float rightArea[BVH_BINS];
+		int rightCount[BVH_BINS];
+		BvhBox box;
+		box.reset();
+		int count = 0;
+		for (int k = BVH_BINS - 1; k > 0; k--)
+		{
+			box.grow(b[k].box);
+			count += b[k].count;
+			rightArea[k] = box.area();
+			rightCount[k] = count;
+		}
+
+		box.reset();
+		count = 0;
+		for (int k = 1; k < BVH_BINS; k++)
+		{
+			box.grow(b[k - 1].box);
+			count += b[k - 1].count;
+			if (count == 0 || rightCount[k] == 0)
+				continue;
+
+			float cost = 1 + (box.area() * count
+					+ rightArea[k] * rightCount[k]) / area;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = a;
+				bestSplit = k;
+			}
+		}
+	}
+
+	if (r.count <= BVH_MAX_LEAF && bestCost >= r.count)
+		return false;
+
+	int mid;
+	if (bestAxis < 0)
+	{
+		// All centers are in the same spot. Any split will do.
+		mid = r.first + r.count / 2;
+	}
+	else
+	{
+		mid = std::partition(order.begin() + r.first,
+				order.begin() + r.first + r.count,
+				[&](int t) { return binOf(t, bestAxis) < bestSplit; })
+			- order.begin();
+	}
+
+	left.first = r.first;
+	left.count = mid - r.first;
+	right.first = mid;
+	right.count = r.first + r.count - mid;
+	measure(left);
+	measure(right);
+	return true;
+}
+
+void BvhBuilder::emit(const BvhRange& r, int depth,
+		std::vector<BvhNode>& out, BvhChild& c, int& maxDepth)
+{
+	setBox(c, r.box);
+
+	BvhRange left, right;
+	if (depth >= BVH_MAX_DEPTH || !split(r, left, right))
+	{
+		c.ref = r.first;
+		c.count = r.count;
+		maxDepth = std::max(maxDepth, depth);
+		return;
+	}
+
+	// "c" may live in "out", so it's not touched after this.
+	int self = out.size();
+	c.ref = self;
+	c.count = 0;
+	out.push_back(BvhNode());
+
+	BvhChild lc, rc;
+	emit(left, depth + 1, out, lc, maxDepth);
+	out[self].child[0] = lc;
+	emit(right, depth + 1, out, rc, maxDepth);
+	out[self].child[1] = rc;
+}
+
+int BvhBuilder::top(const BvhRange& r, int depth)
+{
+	int self = tops.size();
+	tops.push_back(BvhTop());
+	tops[self].range = r;
+	tops[self].depth = depth;
+	tops[self].left = -1;
+	tops[self].right = -1;
+	tops[self].maxDepth = 0;
+
+	BvhRange left, right;
+	if (r.count > taskSize && depth < BVH_MAX_DEPTH
+			&& split(r, left, right))
+	{
+		int l = top(left, depth + 1);
+		int rr = top(right, depth + 1);
+		tops[self].left = l;
+		tops[self].right = rr;
+	}
+
+	return self;
+}
+
+BvhChild BvhBuilder::assemble(int t, std::vector<BvhNode>& out)
+{
+	BvhTop& tp = tops[t];
+	BvhChild c = tp.child;
+
+	if (tp.left < 0)
+	{
+		// Move the subtree to its final place.
+		int offset = out.size();
+		for (size_t i = 0; i < tp.nodes.size(); i++)
+		{
+			BvhNode n = tp.nodes[i];
+			for (int k = 0; k < 2; k++)
+				if (n.child[k].count == 0)
+					n.child[k].ref += offset;
+			out.push_back(n);
+		}
+		if (c.count == 0)
+			c.ref += offset;
+		std::vector<BvhNode>().swap(tp.nodes);
+		return c;
+	}
+
+	int self = out.size();
+	out.push_back(BvhNode());
+	BvhChild lc = assemble(tp.left, out);
+	out[self].child[0] = lc;
+	BvhChild rc = assemble(tp.right, out);
+	out[self].child[1] = rc;
+
+	setBox(c, tp.range.box);
+	c.ref = self;
+	c.count = 0;
+	return c;
+}
+
+
+Bvh::Bvh()
+{
+	_depth = 0;
+}
+
+void Bvh::build(const TriangleMesh& mesh)
+{
+	int n = mesh.triangles();
+	const float *v = mesh.vertexData();
+	const int *idx = mesh.indexData();
+
+	BvhBuilder b;
+	b.bounds.resize(n);
+	b.centers.resize(3 * n);
+	b.order.resize(n);
+	parallelFor(n, [&](int t)
+	{
+		b.bounds[t].reset();
+		for (int k = 0; k < 3; k++)
+			b.bounds[t].grow(&v[3 * idx[3 * t + k]]);
+		for (int a = 0; a < 3; a++)
+			b.centers[3 * t + a] = 0.5 * (b.bounds[t].lo[a]
+					+ b.bounds[t].hi[a]);
+		b.order[t] = t;
+	}, 4096);
+
+	// A few tasks per thread, so big and small subtrees balance out.
+	b.taskSize = std::max(1024, n / (8 * parallelThreads()));
+
+	BvhRange root;
+	root.first = 0;
+	root.count = n;
+	b.measure(root);
+	b.top(root, 0);
+
+	std::vector<int> tasks;
+	for (size_t t = 0; t < b.tops.size(); t++)
+		if (b.tops[t].left < 0)
+			tasks.push_back(t);
+
+	parallelFor(tasks.size(), [&](int i)
+	{
+		BvhTop& tp = b.tops[tasks[i]];
+		b.emit(tp.range, tp.depth, tp.nodes, tp.child, tp.maxDepth);
+	});
+
+	_depth = 0;
+	for (size_t i = 0; i < tasks.size(); i++)
+		_depth = std::max(_depth, b.tops[tasks[i]].maxDepth);
+
+	_nodes.clear();
+	BvhChild c = b.assemble(0, _nodes);
+	if (c.count > 0)
+	{
+		// Just one leaf. The root has to be an inner node, so it gets
+		// the leaf twice.
+		BvhNode node;
+		node.child[0] = c;
+		node.child[1] = c;
+		_nodes.push_back(node);
+	}
+
+	_triangles.resize(9 * n);
+	_original = b.order;
+	parallelFor(n, [&](int i)
+	{
+		const int *t = &idx[3 * _original[i]];
+		float *out = &_triangles[9 * i];
+		for (int a = 0; a < 3; a++)
+		{
+			out[a] = v[3 * t[0] + a];
+			out[3 + a] = v[3 * t[1] + a] - out[a];
+			out[6 + a] = v[3 * t[2] + a] - out[a];
+		}
+	}, 4096);
+}
+
+int Bvh::nodes() const
+{
+	return _nodes.size();
+}
+
+int Bvh::triangles() const
+{
+	return _original.size();
+}
+
+int Bvh::depth() const
+{
+	return _depth;
+}
+
+const BvhNode *Bvh::nodeData() const
+{
+	return _nodes.data();
+}
+
+const float *Bvh::triangleData() const
+{
+	return _triangles.data();
+}
+
+int Bvh::original(int tri) const
+{
+	return _original[tri];
+}
+
+static float boxHit(const BvhChild& c, const float *orig, const float *inv,
+		float tmin, float tmax)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		float t0 = (c.lo[i] - orig[i]) * inv[i];
+		float t1 = (c.hi[i] - orig[i]) * inv[i];
+		tmin = std::max(tmin, std::min(t0, t1));
+		tmax = std::min(tmax, std::max(t0, t1));
+	}
+	return (tmin <= tmax ? tmin : 1e30);
+}
+
+static inline void cross(const float *a, const float *b, float *out)
+{
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static inline float dot(const float *a, const float *b)
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+int Bvh::intersect(const float *orig, const float *dir, float tmin,
+		float tmax, float& t) const
+{
+	float inv[3];
+	for (int i = 0; i < 3; i++)
+		inv[i] = 1 / dir[i];
+
+	int stack[BVH_MAX_DEPTH];
+	float stackT[BVH_MAX_DEPTH];
+	int sp = 0;
+	int node = 0;
+	int hit = -1;
+	t = tmax;
+
+	while (node >= 0)
+	{
+		const BvhNode& n = _nodes[node];
+		float near[2];
+		for (int k = 0; k < 2; k++)
+			near[k] = boxHit(n.child[k], orig, inv, tmin, t);
+		int first = (near[1] < near[0] ? 1 : 0);
+
+		// Leaves right away, the nearer one first.
+		for (int k = 0; k < 2; k++)
+		{
+			const BvhChild& c = n.child[first ^ k];
+			if (c.count == 0 || near[first ^ k] >= t)
+				continue;
+
+			for (int i = c.ref; i < c.ref + c.count; i++)
+			{
+				// Moeller-Trumbore.
+				const float *v0 = &_triangles[9 * i];
+				const float *e1 = v0 + 3;
+				const float *e2 = v0 + 6;
+				float p[3], q[3], s[3];
+				cross(dir, e2, p);
+				float det = dot(e1, p);
+				if (det == 0)
+					continue;
+				float invDet = 1 / det;
+				for (int a = 0; a < 3; a++)
+					s[a] = orig[a] - v0[a];
+				float u = dot(s, p) * invDet;
+				if (u < 0 || u > 1)
+					continue;
+				cross(s, e1, q);
+				float w = dot(dir, q) * invDet;
+				if (w < 0 || u + w > 1)
+					continue;
+				float d = dot(e2, q) * invDet;
+				if (d > tmin && d < t)
+				{
+					t = d;
+					hit = i;
+				}
+			}
+		}
+
+		// Then inner nodes. The far one waits on the stack.
+		bool go[2];
+		for (int k = 0; k < 2; k++)
+			go[k] = (n.child[k].count == 0 && near[k] < t);
+
+		int second = 1 - first;
+		if (go[first] && go[second])
+		{
+			stack[sp] = n.child[second].ref;
+			stackT[sp] = near[second];
+			sp++;
+			node = n.child[first].ref;
+		}
+		else if (go[first] || go[second])
+		{
+			node = n.child[go[first] ? first : second].ref;
+		}
+		else
+		{
+			node = -1;
+			while (sp > 0)
+			{
+				sp--;
+				if (stackT[sp] < t)
+				{
+					node = stack[sp];
+					break;
+				}
+			}
+		}
+	}
+
+	return (hit >= 0 ? _original[hit] : -1);
+}
@@ -0,0 +1,91 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include <vector>
+
+#include "Mesh.hpp"
+
+// Leaves hold at most this many triangles, unless the tree gets deeper
+// than BVH_MAX_DEPTH. Traversal needs a stack of that depth, see
+// objects/d_mesh.glsl.
+#define BVH_MAX_LEAF 8
+#define BVH_MAX_DEPTH 48
+
+// One child of an inner node. Inner children point to another node
+// (count is 0), leaves to a range of triangles.
+struct BvhChild
+{
+	float lo[3];
+	int ref;
+	float hi[3];
+	int count;
+};
+
+// Inner nodes keep the boxes of both children, so a single fetch of 64
+// bytes (four RGBA texels on the GPU) decides where to go next. Nodes
+// are stored depth first: An inner left child always follows its
+// parent directly.
+struct BvhNode
+{
+	BvhChild child[2];
+};
+
+// Bounding volume hierarchy over the triangles of a mesh, built with
+// the surface area heuristic on binned centroids. The top of the tree
+// is split sequentially (each split sweeps its triangles in parallel),
+// the subtrees below are built in parallel. Triangles are reordered so
+// that each leaf refers to a contiguous range.
+class Bvh
+{
+	private:
+		std::vector<BvhNode> _nodes;
+
+		// v0, v1 - v0, v2 - v0 of each triangle, in leaf order.
+		std::vector<float> _triangles;
+
+		// Index in the mesh of each triangle.
+		std::vector<int> _original;
+
+		int _depth;
+
+	public:
+		Bvh();
+
+		void build(const TriangleMesh& mesh);
+
+		int nodes() const;
+		int triangles() const;
+		int depth() const;
+		const BvhNode *nodeData() const;
+		const float *triangleData() const;
+		int original(int tri) const;
+
+		// Nearest hit along orig + t * dir with tmin < t < tmax. Does
+		// the same as the shader: Near child first, far child on a
+		// stack. Returns the index of the triangle in the mesh, -1 on
+		// misses.
+		int intersect(const float *orig, const float *dir, float tmin,
+				float tmax, float& t) const;
+};
+
+#endif // BVH_HPP
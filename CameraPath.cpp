@@ -0,0 +1,327 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <fstream>
+#include <string>
+
+#include "CameraPath.hpp"
+#include "Parallel.hpp"
+
+
+CameraPath::CameraPath()
+{
+	_arcSamples = 64;
+	_dirty = false;
+}
+
+bool CameraPath::load(const char *path)
+{
+	// Read the format written by Viewport::dumpInfos(). Everything
+	// that's not inside a "camera ... end" block (e.g. the lights) is
+	// skipped, so the output of [Space] can be pasted as it is.
+	std::ifstream in(path);
+	if (!in.is_open())
+		return false;
+
+	std::string word;
+	bool inCamera = false;
+	double fov = 60;
+	Vec3 origin, viewdir(0, 0, -1), updir(0, 1, 0);
+
+	while (in >> word)
+	{
+		if (word == "camera")
+		{
+			inCamera = true;
+		}
+		else if (!inCamera)
+		{
+			continue;
+		}
+		else if (word == "fov")
+		{
+			in >> fov;
+		}
+		else if (word == "origin")
+		{
+			in >> origin[0] >> origin[1] >> origin[2];
+		}
+		else if (word == "viewdir")
+		{
+			in >> viewdir[0] >> viewdir[1] >> viewdir[2];
+		}
+		else if (word == "updir")
+		{
+			in >> updir[0] >> updir[1] >> updir[2];
+		}
+		else if (word == "end")
+		{
+			// Rebuild the local axes. Their global coordinates are the
+			// rows of the orientation matrix, see dumpInfos().
+			Vec3 z = -viewdir;
+			z.normalize();
+			Vec3 x = updir ^ z;
+			x.normalize();
+			Vec3 y = z ^ x;
+
+			Mat4 T;
+			T.makeIdentity();
+			for (int i = 0; i < 3; i++)
+			{
+				T[4 * i + 0] = x[i];
+				T[4 * i + 1] = y[i];
+				T[4 * i + 2] = z[i];
+			}
+
+			addKey(origin, Quat4(T), fov);
+			inCamera = false;
+		}
+	}
+
+	prepareIfDirty();
+	return !_keys.empty();
+}
+
+void CameraPath::addKey(Vec3 p, Quat4 q, double f)
+{
+	CameraKey k;
+	k.pos = p;
+	k.ori = q;
+	k.ori.normalize();
+	k.fov = f;
+
+	// q and -q are the same rotation. Stay in one hemisphere so that
+	// interpolation never takes the long way around.
+	if (!_keys.empty() && _keys.back().ori.dot(k.ori) < 0)
+		k.ori = -k.ori;
+
+	// The tables cover all keys, so they're built once before the path
+	// is used, not once per key.
+	_keys.push_back(k);
+	_dirty = true;
+}
+
+int CameraPath::keys()
+{
+	return _keys.size();
+}
+
+double CameraPath::length()
+{
+	prepareIfDirty();
+	return _arcTable.empty() ? 0 : _arcTable.back();
+}
+
+Vec3 CameraPath::positionAt(int seg, double t)
+{
+	// Centripetal Catmull-Rom (alpha = 0.5), evaluated with the
+	// Barry-Goldman pyramid. Missing neighbours at both ends are
+	// mirrored. See:
+	// http://en.wikipedia.org/wiki/Centripetal_Catmull-Rom_spline
+	int n = _keys.size();
+	Vec3 P[4];
+	P[1] = _keys[seg].pos;
+	P[2] = _keys[seg + 1].pos;
+
+	if (seg > 0)
+		P[0] = _keys[seg - 1].pos;
+	else
+		for (int i = 0; i < 3; i++)
+			P[0][i] = 2 * P[1][i] - P[2][i];
+
+	if (seg + 2 < n)
+		P[3] = _keys[seg + 2].pos;
+	else
+		for (int i = 0; i < 3; i++)
+			P[3][i] = 2 * P[2][i] - P[1][i];
+
+	double k[4];
+	k[0] = 0;
+	for (int i = 1; i < 4; i++)
+	{
+		double d = sqrt(P[i].distance(P[i - 1]));
+		k[i] = k[i - 1] + (d > 1e-6 ? d : 1e-6);
+	}
+
+	double u = k[1] + t * (k[2] - k[1]);
+
+	Vec3 C;
+	for (int i = 0; i < 3; i++)
+	{
+		double A1 = ((k[1] - u) * P[0][i] + (u - k[0]) * P[1][i])
+			/ (k[1] - k[0]);
+		double A2 = ((k[2] - u) * P[1][i] + (u - k[1]) * P[2][i])
+			/ (k[2] - k[1]);
+		double A3 = ((k[3] - u) * P[2][i] + (u - k[2]) * P[3][i])
+			/ (k[3] - k[2]);
+
+		double B1 = ((k[2] - u) * A1 + (u - k[0]) * A2) / (k[2] - k[0]);
+		double B2 = ((k[3] - u) * A2 + (u - k[1]) * A3) / (k[3] - k[1]);
+
+		C[i] = ((k[2] - u) * B1 + (u - k[1]) * B2) / (k[2] - k[1]);
+	}
+
+	return C;
+}
+
+Quat4 CameraPath::orientationAt(int seg, double t)
+{
+	// Squad: Smooth across keys, unlike piecewise slerp. See:
+	// Shoemake, "Animating rotation with quaternion curves", 1985.
+	Quat4 a = _keys[seg].ori.slerp(_keys[seg + 1].ori, t);
+	Quat4 b = _squadCtrl[seg].slerp(_squadCtrl[seg + 1], t);
+	return a.slerp(b, 2 * t * (1 - t));
+}
+
+void CameraPath::prepareIfDirty()
+{
+	if (_dirty)
+		prepare();
+}
+
+void CameraPath::prepare()
+{
+	_dirty = false;
+	int n = _keys.size();
+
+	// Squad control points.
+	_squadCtrl.resize(n);
+	for (int i = 0; i < n; i++)
+	{
+		Quat4 qi = _keys[i].ori;
+		Quat4 inv = qi.conjugated();
+		Quat4 prev = _keys[i > 0 ? i - 1 : i].ori;
+		Quat4 next = _keys[i + 1 < n ? i + 1 : i].ori;
+
+		Quat4 lnext = (inv * next).log();
+		Quat4 lprev = (inv * prev).log();
+		Quat4 e = ((lnext + lprev) * -0.25).exp();
+		_squadCtrl[i] = qi * e;
+	}
+
+	// Arc length table. Segments are independent, so they are sampled
+	// in parallel and summed up afterwards.
+	_arcTable.clear();
+	if (n < 2)
+		return;
+
+	int segs = n - 1;
+	std::vector<double> seglen(segs * _arcSamples);
+	parallelFor(segs, [&](int s)
+	{
+		Vec3 last = positionAt(s, 0);
+		for (int k = 1; k <= _arcSamples; k++)
+		{
+			Vec3 cur = positionAt(s, k / (double)_arcSamples);
+			seglen[s * _arcSamples + k - 1] = cur.distance(last);
+			last = cur;
+		}
+	});
+
+	_arcTable.resize(segs * _arcSamples + 1);
+	_arcTable[0] = 0;
+	for (size_t i = 0; i < seglen.size(); i++)
+		_arcTable[i + 1] = _arcTable[i] + seglen[i];
+}
+
+CameraKey CameraPath::evaluate(double u)
+{
+	prepareIfDirty();
+	int n = _keys.size();
+	if (n == 1)
+		return _keys[0];
+
+	int seg = (int)floor(u);
+	if (seg < 0)
+		seg = 0;
+	if (seg > n - 2)
+		seg = n - 2;
+	double t = u - seg;
+
+	CameraKey k;
+	k.pos = positionAt(seg, t);
+	k.ori = orientationAt(seg, t);
+
+	// Catmull-Rom (Hermite form) is good enough for the FOV.
+	double f0 = _keys[seg > 0 ? seg - 1 : seg].fov;
+	double f1 = _keys[seg].fov;
+	double f2 = _keys[seg + 1].fov;
+	double f3 = _keys[seg + 2 < n ? seg + 2 : seg + 1].fov;
+	double m1 = 0.5 * (f2 - f0);
+	double m2 = 0.5 * (f3 - f1);
+	double t2 = t * t, t3 = t2 * t;
+	k.fov = (2*t3 - 3*t2 + 1) * f1 + (t3 - 2*t2 + t) * m1
+		+ (-2*t3 + 3*t2) * f2 + (t3 - t2) * m2;
+
+	return k;
+}
+
+double CameraPath::paramAtFraction(double s)
+{
+	prepareIfDirty();
+	int segs = _keys.size() - 1;
+	if (segs < 1)
+		return 0;
+
+	// Pure rotations have no length: Fall back to uniform pacing.
+	double total = length();
+	if (total < 1e-12)
+		return s * segs;
+
+	double target = s * total;
+	int lo = 0;
+	int hi = _arcTable.size() - 1;
+	if (target <= 0)
+		return 0;
+	if (target >= total)
+		return segs;
+
+	while (hi - lo > 1)
+	{
+		int mid = (lo + hi) / 2;
+		if (_arcTable[mid] <= target)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	double span = _arcTable[hi] - _arcTable[lo];
+	double frac = (span > 0 ? (target - _arcTable[lo]) / span : 0);
+	return (lo + frac) / _arcSamples;
+}
+
+std::vector<CameraKey> CameraPath::frames(int n)
+{
+	std::vector<CameraKey> out;
+	if (_keys.empty() || n < 1)
+		return out;
+
+	// Not from the threads below.
+	prepareIfDirty();
+
+	out.resize(n);
+	parallelFor(n, [&](int i)
+	{
+		double s = (n > 1 ? i / (double)(n - 1) : 0);
+		out[i] = evaluate(paramAtFraction(s));
+	}, 16);
+
+	return out;
+}
@@ -0,0 +1,75 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CAMERAPATH_HPP
+#define CAMERAPATH_HPP
+
+#include <vector>
+
+#include "VecMath.hpp"
+
+struct CameraKey
+{
+	Vec3 pos;
+	Quat4 ori;
+	double fov;
+};
+
+class CameraPath
+{
+	private:
+		std::vector<CameraKey> _keys;
+
+		// Intermediate quaternions for squad, one per key.
+		std::vector<Quat4> _squadCtrl;
+
+		// Cumulative arc length at _arcSamples equidistant values of
+		// the spline parameter per segment.
+		std::vector<double> _arcTable;
+		int _arcSamples;
+
+		// Keys were added since the last prepare().
+		bool _dirty;
+
+		Vec3 positionAt(int seg, double t);
+		Quat4 orientationAt(int seg, double t);
+		void prepare();
+		void prepareIfDirty();
+
+	public:
+		CameraPath();
+
+		bool load(const char *path);
+		void addKey(Vec3 p, Quat4 q, double f);
+		int keys();
+		double length();
+
+		// Evaluate at spline parameter u in [0, keys() - 1].
+		CameraKey evaluate(double u);
+
+		// Spline parameter at which the given fraction of the total arc
+		// length is reached.
+		double paramAtFraction(double s);
+
+		// n evenly paced frames from the first to the last key.
+		std::vector<CameraKey> frames(int n);
+};
+
+#endif // CAMERAPATH_HPP
@@ -0,0 +1,282 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "Capture.hpp"
+#include "Image.hpp"
+
+
+// --- Capture ---
+
+Capture::Capture()
+{
+	_next = 0;
+}
+
+Capture::~Capture()
+{
+	// The GL context may be gone at this point. Buffers are released
+	// together with it.
+}
+
+void Capture::init(int slots)
+{
+	_slots.resize(slots);
+	for (int i = 0; i < slots; i++)
+	{
+		glGenBuffers(1, &_slots[i].pbo);
+		_slots[i].fence = 0;
+		_slots[i].w = 0;
+		_slots[i].h = 0;
+		_slots[i].size = 0;
+	}
+	_next = 0;
+}
+
+void Capture::addSink(FrameSink *sink)
+{
+	if (std::find(_sinks.begin(), _sinks.end(), sink) == _sinks.end())
+		_sinks.push_back(sink);
+}
+
+void Capture::removeSink(FrameSink *sink)
+{
+	_sinks.erase(std::remove(_sinks.begin(), _sinks.end(), sink),
+			_sinks.end());
+}
+
+bool Capture::active()
+{
+	return !_sinks.empty() || !_once.empty();
+}
+
+void Capture::requestOnce(FrameSink *sink)
+{
+	_once.push_back(sink);
+}
+
+bool Capture::ready(Slot& s, bool wait)
+{
+	if (s.fence == 0)
+		return false;
+
+	GLenum r = glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+			wait ? 1000000000ull : 0);
+	return (r == GL_ALREADY_SIGNALED || r == GL_CONDITION_SATISFIED);
+}
+
+void Capture::deliver(Slot& s)
+{
+	glDeleteSync(s.fence);
+	s.fence = 0;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+	const unsigned char *pixels = (const unsigned char *)glMapBufferRange(
+			GL_PIXEL_PACK_BUFFER, 0, s.size, GL_MAP_READ_BIT);
+	if (pixels != NULL)
+	{
+		for (size_t i = 0; i < s.sinks.size(); i++)
+			s.sinks[i]->consume(pixels, s.w, s.h, s.info);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	s.sinks.clear();
+}
+
+void Capture::deliverReady()
+{
+	// Oldest first, and only as long as they're done. Sinks see the
+	// frames in order.
+	int n = _slots.size();
+	for (int i = 0; i < n; i++)
+	{
+		Slot &s = _slots[(_next + i) % n];
+		if (s.fence == 0)
+			continue;
+		if (!ready(s, false))
+			break;
+		deliver(s);
+	}
+}
+
+void Capture::frameEnd(int w, int h, const FrameInfo& info)
+{
+	int n = _slots.size();
+	if (n == 0)
+		return;
+
+	// Hand out what has been read back during earlier frames. The
+	// transfers that aren't done yet stay in flight.
+	deliverReady();
+
+	if (!active())
+		return;
+
+	// All slots busy: The oldest one has to be finished first. It was
+	// queued before the drawing commands of n - 1 frames, so this is
+	// hardly ever a real wait.
+	Slot &s = _slots[_next];
+	if (s.fence != 0)
+	{
+		ready(s, true);
+		deliver(s);
+	}
+
+	s.w = w;
+	s.h = h;
+	s.size = (size_t)w * h * 4;
+	s.info = info;
+	s.sinks = _sinks;
+	s.sinks.insert(s.sinks.end(), _once.begin(), _once.end());
+	_once.clear();
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+	glBufferData(GL_PIXEL_PACK_BUFFER, s.size, NULL, GL_STREAM_READ);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	_next = (_next + 1) % n;
+}
+
+void Capture::poll()
+{
+	deliverReady();
+}
+
+void Capture::flush()
+{
+	int n = _slots.size();
+	for (int i = 0; i < n; i++)
+	{
+		Slot &s = _slots[(_next + i) % n];
+		if (s.fence != 0)
+		{
+			ready(s, true);
+			deliver(s);
+		}
+	}
+}
+
+
+bool Capture::pending()
+{
+	for (size_t i = 0; i < _slots.size(); i++)
+		if (_slots[i].fence != 0)
+			return true;
+	return false;
+}
+
+
+// --- ImageSaver ---
+
+ImageSaver::ImageSaver(const std::string& prefix, const std::string& format)
+	: _queue(16), _free(16)
+{
+	_prefix = prefix;
+	_format = format;
+	_counter = 0;
+	_blocking = false;
+	_dropped = 0;
+
+	_jobs.resize(16);
+	for (size_t i = 0; i < _jobs.size(); i++)
+	{
+		_jobs[i] = new Job;
+		_free.push(_jobs[i]);
+	}
+
+	_thread = std::thread(&ImageSaver::run, this);
+}
+
+ImageSaver::~ImageSaver()
+{
+	finish();
+	for (size_t i = 0; i < _jobs.size(); i++)
+		delete _jobs[i];
+}
+
+void ImageSaver::setBlocking(bool on)
+{
+	_blocking = on;
+}
+
+void ImageSaver::consume(const unsigned char *rgba, int w, int h,
+		const FrameInfo& info)
+{
+	(void)info;
+
+	// All jobs still waiting to be encoded: Rather lose this frame than
+	// hold up the renderer.
+	Job *job = NULL;
+	if (_blocking)
+		_free.pop(job);
+	else if (!_free.tryPop(job))
+	{
+		_dropped++;
+		return;
+	}
+
+	// Only a plain copy into a buffer of an earlier frame here.
+	// Flipping, converting and encoding happens on the writer thread.
+	job->rgba.assign(rgba, rgba + (size_t)w * h * 4);
+	job->w = w;
+	job->h = h;
+
+	char name[1024];
+	snprintf(name, sizeof name, "%s_%06d.%s", _prefix.c_str(), _counter++,
+			_format.c_str());
+	job->path = name;
+
+	_queue.push(job);
+}
+
+void ImageSaver::run()
+{
+	Job *job;
+	Image img;
+	while (_queue.pop(job))
+	{
+		img.fromRGBA(&job->rgba[0], job->w, job->h);
+		if (img.save(job->path.c_str()))
+			std::cout << "Saved `" << job->path << "'." << std::endl;
+		_free.push(job);
+	}
+}
+
+void ImageSaver::finish()
+{
+	_queue.close();
+	if (_thread.joinable())
+		_thread.join();
+
+	if (_dropped > 0)
+	{
+		std::cerr << "Image writer fell behind, " << _dropped
+			<< " frames were dropped." << std::endl;
+		_dropped = 0;
+	}
+}
@@ -0,0 +1,152 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.hpp"
+
+// State of the renderer when a frame was drawn. Travels along with the
+// pixels because they are delivered a frame later.
+struct FrameInfo
+{
+	long frame;
+	float pos[3];
+	float rot[16];
+	float fov;
+	float user_params[2][4];
+};
+
+// Receives captured frames. Pixels are RGBA, 8 bit per channel, rows
+// bottom to top (as OpenGL delivers them). They point into a mapped
+// pixel buffer and are only valid during the call, so consumers must
+// copy what they need and do the heavy lifting elsewhere.
+class FrameSink
+{
+	public:
+		virtual ~FrameSink() {}
+		virtual void consume(const unsigned char *rgba, int w, int h,
+				const FrameInfo& info) = 0;
+};
+
+// Asynchronous readback of the framebuffer. glReadPixels() writes into
+// one of several pixel buffer objects and returns immediately; a fence
+// tells us when the copy is done. Slots whose fence has signaled are
+// handed to the sinks at the end of later frames, the others stay in
+// flight. Only a slot that is about to be reused is waited for.
+class Capture
+{
+	private:
+		struct Slot
+		{
+			GLuint pbo;
+			GLsync fence;
+			int w;
+			int h;
+			size_t size;
+			FrameInfo info;
+			std::vector<FrameSink *> sinks;
+		};
+
+		std::vector<Slot> _slots;
+		int _next;
+		std::vector<FrameSink *> _sinks;
+		std::vector<FrameSink *> _once;
+
+		void deliver(Slot& s);
+		bool ready(Slot& s, bool wait);
+		void deliverReady();
+
+	public:
+		Capture();
+		~Capture();
+
+		void init(int slots = 2);
+
+		// Sinks that get every frame.
+		void addSink(FrameSink *sink);
+		void removeSink(FrameSink *sink);
+		bool active();
+
+		// Hand only the next frame to this sink.
+		void requestOnce(FrameSink *sink);
+
+		// Call after a frame has been rendered into the currently bound
+		// read framebuffer.
+		void frameEnd(int w, int h, const FrameInfo& info);
+
+		// Hand out the readbacks that are done, without waiting.
+		void poll();
+
+		// Wait for all outstanding readbacks.
+		void flush();
+		bool pending();
+};
+
+// Writes frames as image files on a separate thread.
+class ImageSaver : public FrameSink
+{
+	private:
+		struct Job
+		{
+			std::vector<unsigned char> rgba;
+			int w;
+			int h;
+			std::string path;
+		};
+
+		std::string _prefix;
+		std::string _format;
+		int _counter;
+		BoundedQueue<Job *> _queue;
+
+		// Jobs go back here once they're saved, so their buffers are
+		// reused instead of allocated for every frame.
+		BoundedQueue<Job *> _free;
+		std::vector<Job *> _jobs;
+
+		// Without blocking, frames are dropped while all jobs are busy.
+		bool _blocking;
+		int _dropped;
+		std::thread _thread;
+
+		void run();
+
+	public:
+		ImageSaver(const std::string& prefix, const std::string& format);
+		~ImageSaver();
+
+		// Batch modes want every frame and have no frame rate to keep.
+		void setBlocking(bool on);
+
+		void consume(const unsigned char *rgba, int w, int h,
+				const FrameInfo& info);
+		void finish();
+};
+
+#endif // CAPTURE_HPP
@@ -0,0 +1,582 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+#include "CpuMarcher.hpp"
+#include "Parallel.hpp"
+
+// Same as in ray/marching.glsl.
+#define MARCHER_MAXVAL 10.0f
+#define MARCHER_NORMAL_EPS 1e-5f
+
+// What a ray does with the value of its next sample.
+enum MarcherPhase
+{
+	PHASE_START,
+	PHASE_MARCH,
+	PHASE_BISECT,
+	PHASE_NORMAL_X,
+	PHASE_NORMAL_Y,
+	PHASE_NORMAL_Z,
+	PHASE_DONE
+};
+
+// The rays of one thread. A ray's state is spread over the arrays, all
+// at the same index. Each one is in the middle of evaluating its next
+// sample s*, after iter iterations that led to z* and r.
+struct MarcherPool
+{
+	float dx[MARCHER_LANES];
+	float dy[MARCHER_LANES];
+	float dz[MARCHER_LANES];
+
+	// Number of the next step, its distance, the bisection's interval.
+	float n[MARCHER_LANES];
+	float alpha[MARCHER_LANES];
+	float a1[MARCHER_LANES];
+	float cstep[MARCHER_LANES];
+
+	// Last sample of the bisection, the hit in the end, and the normal.
+	float hx[MARCHER_LANES];
+	float hy[MARCHER_LANES];
+	float hz[MARCHER_LANES];
+	float hval[MARCHER_LANES];
+	float nx[MARCHER_LANES];
+	float ny[MARCHER_LANES];
+
+	float sx[MARCHER_LANES];
+	float sy[MARCHER_LANES];
+	float sz[MARCHER_LANES];
+	float zx[MARCHER_LANES];
+	float zy[MARCHER_LANES];
+	float zz[MARCHER_LANES];
+	float r[MARCHER_LANES];
+	float iter[MARCHER_LANES];
+	int ready[MARCHER_LANES];
+
+	int sitStart[MARCHER_LANES];
+	int phase[MARCHER_LANES];
+	int pixel[MARCHER_LANES];
+	int count;
+};
+
+
+// The math below is shared by both marchers, so that they agree bit for
+// bit. It's the same as in the shaders, just in single precision on the
+// CPU.
+
+// Eye and direction of the ray through the center of a pixel, like
+// shader_vertex.glsl and shadeRay().
+static inline void viewRay(const MarcherView& v, int x, int y, float *eye,
+		float *dir)
+{
+	float u = (x + 0.5f) / v.w;
+	float t = (y + 0.5f) / v.h;
+	float plane[3] = {
+		v.planeRect[0] * (1 - u) + v.planeRect[2] * u,
+		v.planeRect[1] * (1 - t) + v.planeRect[3] * t,
+		-v.eyedist
+	};
+
+	float len = 0;
+	for (int j = 0; j < 3; j++)
+	{
+		const float *row = &v.rot[4 * j];
+		eye[j] = row[3] + v.pos[j];
+		dir[j] = row[0] * plane[0] + row[1] * plane[1] + row[2] * plane[2]
+			+ row[3] + v.pos[j] - eye[j];
+		len += dir[j] * dir[j];
+	}
+	len = std::sqrt(len);
+	for (int j = 0; j < 3; j++)
+		dir[j] /= len;
+}
+
+// One iteration of objects/m_mandelbulb.glsl for a point whose |z| is
+// r and still inside. r gets the same epsilon as in the shader.
+static inline void mandelbulbStep(float& zx, float& zy, float& zz, float& r,
+		float cx, float cy, float cz)
+{
+	const float eps = 1e-7f;
+
+	float planeXY = std::sqrt(zx * zx + zy * zy) + eps;
+	r += eps;
+
+	float sinPhi = zy / planeXY;
+	float cosPhi = zx / planeXY;
+	float sinThe = planeXY / r;
+	float cosThe = zz / r;
+
+	// Three cascade levels.
+	for (int level = 0; level < 3; level++)
+	{
+		sinPhi = 2 * sinPhi * cosPhi;
+		cosPhi = 2 * cosPhi * cosPhi - 1;
+		sinThe = 2 * sinThe * cosThe;
+		cosThe = 2 * cosThe * cosThe - 1;
+	}
+
+	// rPow = pow(r, 8)
+	float rPow = r * r;
+	rPow *= rPow;
+	rPow *= rPow;
+
+	zx = sinThe * cosPhi * rPow + cx;
+	zy = sinThe * sinPhi * rPow + cy;
+	zz = cosThe * rPow + cz;
+}
+
+// evalAt() of objects/m_mandelbulb.glsl, one point.
+static float mandelbulb(float x, float y, float z, float iterations)
+{
+	float zx = x;
+	float zy = y;
+	float zz = z;
+	float r = 0;
+	for (float count = 0; count < iterations - 1; count += 1)
+	{
+		r = std::sqrt(zx * zx + zy * zy + zz * zz);
+		if (r > 2)
+			break;
+		mandelbulbStep(zx, zy, zz, r, x, y, z);
+	}
+	return r - 2;
+}
+
+static inline void writeMiss(float *geometry)
+{
+	geometry[0] = 0;
+	geometry[1] = 0;
+	geometry[2] = 0;
+	geometry[3] = -1;
+}
+
+// Normal from the finite differences and the distance, like shadeRay().
+static inline void writeHit(float *geometry, const float *eye,
+		const float *hit, float hval, float nx, float ny, float nz)
+{
+	nx -= hval;
+	ny -= hval;
+	nz -= hval;
+	float len = std::sqrt(nx * nx + ny * ny + nz * nz);
+	geometry[0] = nx / len;
+	geometry[1] = ny / len;
+	geometry[2] = nz / len;
+
+	float ex = hit[0] - eye[0];
+	float ey = hit[1] - eye[1];
+	float ez = hit[2] - eye[2];
+	geometry[3] = std::sqrt(ex * ex + ey * ey + ez * ez);
+}
+
+
+// Where ray i looks next, and the start of evalAt() there.
+static inline void beginSample(MarcherPool& p, int i, const float *eye)
+{
+	switch (p.phase[i])
+	{
+		case PHASE_NORMAL_X:
+			p.sx[i] = p.hx[i] + MARCHER_NORMAL_EPS;
+			p.sy[i] = p.hy[i];
+			p.sz[i] = p.hz[i];
+			break;
+		case PHASE_NORMAL_Y:
+			p.sx[i] = p.hx[i];
+			p.sy[i] = p.hy[i] + MARCHER_NORMAL_EPS;
+			p.sz[i] = p.hz[i];
+			break;
+		case PHASE_NORMAL_Z:
+			p.sx[i] = p.hx[i];
+			p.sy[i] = p.hy[i];
+			p.sz[i] = p.hz[i] + MARCHER_NORMAL_EPS;
+			break;
+		default:
+			p.sx[i] = eye[0] + p.alpha[i] * p.dx[i];
+			p.sy[i] = eye[1] + p.alpha[i] * p.dy[i];
+			p.sz[i] = eye[2] + p.alpha[i] * p.dz[i];
+			break;
+	}
+
+	p.zx[i] = p.sx[i];
+	p.zy[i] = p.sy[i];
+	p.zz[i] = p.sz[i];
+	p.r[i] = 0;
+	p.iter[i] = 0;
+	p.ready[i] = 0;
+}
+
+// Ray i got the value of its sample. The same as findIntersection() in
+// ray/marching.glsl, cut into single samples.
+static void takeSample(MarcherPool& p, int i, float val, const float *eye,
+		float stepsize, float accuracy, float *geometry)
+{
+	int sit = (val < 0);
+	switch (p.phase[i])
+	{
+		case PHASE_START:
+			p.sitStart[i] = sit;
+			p.n[i] += 1;
+			p.alpha[i] = p.cstep[i] * p.n[i];
+			p.phase[i] = PHASE_MARCH;
+			break;
+
+		case PHASE_MARCH:
+			if (sit != p.sitStart[i])
+			{
+				p.a1[i] = p.alpha[i] - stepsize;
+				p.phase[i] = PHASE_BISECT;
+			}
+			else
+			{
+				p.n[i] += 1;
+				p.alpha[i] = p.cstep[i] * p.n[i];
+			}
+			break;
+
+		case PHASE_BISECT:
+			if (sit == p.sitStart[i])
+				p.a1[i] = p.alpha[i];
+			break;
+
+		case PHASE_NORMAL_X:
+			p.nx[i] = val;
+			p.phase[i] = PHASE_NORMAL_Y;
+			break;
+
+		case PHASE_NORMAL_Y:
+			p.ny[i] = val;
+			p.phase[i] = PHASE_NORMAL_Z;
+			break;
+
+		case PHASE_NORMAL_Z:
+		{
+			float hit[3] = { p.hx[i], p.hy[i], p.hz[i] };
+			writeHit(&geometry[4 * p.pixel[i]], eye, hit, p.hval[i],
+					p.nx[i], p.ny[i], val);
+			p.phase[i] = PHASE_DONE;
+			break;
+		}
+	}
+
+	// The last sample of the bisection is the hit.
+	if (p.phase[i] == PHASE_BISECT)
+	{
+		p.hx[i] = p.sx[i];
+		p.hy[i] = p.sy[i];
+		p.hz[i] = p.sz[i];
+		p.hval[i] = val;
+		if (p.cstep[i] > accuracy)
+		{
+			p.cstep[i] *= 0.5f;
+			p.alpha[i] = p.a1[i] + p.cstep[i];
+		}
+		else
+			p.phase[i] = PHASE_NORMAL_X;
+	}
+	else if (p.phase[i] == PHASE_MARCH && !(p.alpha[i] < MARCHER_MAXVAL))
+	{
+		writeMiss(&geometry[4 * p.pixel[i]]);
+		p.phase[i] = PHASE_DONE;
+	}
+}
+
+
+CpuMarcher::CpuMarcher()
+{
+	_stepsize = 0.2;
+	_accuracy = 1e-2;
+	_iterations = 8;
+	_compactEvery = 4;
+	_busy = 0;
+}
+
+void CpuMarcher::setQuality(float stepsize, float accuracy)
+{
+	_stepsize = stepsize;
+	_accuracy = accuracy;
+}
+
+void CpuMarcher::setIterations(float iterations)
+{
+	_iterations = iterations;
+}
+
+void CpuMarcher::setCompaction(int iterations)
+{
+	_compactEvery = std::max(iterations, 1);
+}
+
+void CpuMarcher::march(const MarcherView& view, const int *region,
+		float *geometry)
+{
+	int tilesX = (region[2] + MARCHER_TILE - 1) / MARCHER_TILE;
+	int tilesY = (region[3] + MARCHER_TILE - 1) / MARCHER_TILE;
+	int tiles = tilesX * tilesY;
+	std::atomic<int> nextTile(0);
+
+	int workers = std::max(std::min(parallelThreads(), tiles), 1);
+	std::vector<double> busy(workers, 0);
+	std::vector<double> lanes(workers, 0);
+
+	float eye[3];
+	float dir[3];
+	viewRay(view, 0, 0, eye, dir);
+
+	// With no iterations at all, evalAt() is -2 right away.
+	float limit = _iterations - 1;
+	auto settle = [&](MarcherPool& p, int i, float val)
+	{
+		for (;;)
+		{
+			takeSample(p, i, val, eye, _stepsize, _accuracy, geometry);
+			if (p.phase[i] == PHASE_DONE)
+				return;
+			beginSample(p, i, eye);
+			if (0 < limit)
+				return;
+			val = -2;
+		}
+	};
+
+	parallelFor(workers, [&](int w)
+	{
+		MarcherPool p;
+		p.count = 0;
+
+		// Pixels of the current tile, then the next one.
+		int tile = -1;
+		int next = MARCHER_TILE * MARCHER_TILE;
+		auto refill = [&]()
+		{
+			while (p.count < MARCHER_LANES)
+			{
+				if (next == MARCHER_TILE * MARCHER_TILE)
+				{
+					if (tile >= tiles)
+						return;
+					tile = nextTile.fetch_add(1);
+					next = 0;
+					if (tile >= tiles)
+						return;
+				}
+
+				int x = (tile % tilesX) * MARCHER_TILE + next % MARCHER_TILE;
+				int y = (tile / tilesX) * MARCHER_TILE + next / MARCHER_TILE;
+				next++;
+				if (x >= region[2] || y >= region[3])
+					continue;
+
+				int i = p.count++;
+				float e[3];
+				float d[3];
+				viewRay(view, region[0] + x, region[1] + y, e, d);
+				p.dx[i] = d[0];
+				p.dy[i] = d[1];
+				p.dz[i] = d[2];
+				p.pixel[i] = (region[1] + y) * view.w + region[0] + x;
+
+				// No reprojection and no proxy: ray_start is 0.
+				p.cstep[i] = _stepsize;
+				p.n[i] = 1;
+				p.alpha[i] = p.cstep[i] * p.n[i];
+				p.phase[i] = PHASE_START;
+				beginSample(p, i, eye);
+				if (!(0 < limit))
+					settle(p, i, -2);
+			}
+		};
+
+		refill();
+		while (p.count > 0)
+		{
+			for (int round = 0; round < _compactEvery; round++)
+			{
+				// One iteration of evalAt() for all lanes, the same as
+				// in mandelbulb() above. This loop has no branches, so
+				// it becomes vector code.
+				int live = 0;
+				for (int i = 0; i < p.count; i++)
+				{
+					int on = (p.phase[i] != PHASE_DONE);
+					float rNow = std::sqrt(p.zx[i] * p.zx[i]
+							+ p.zy[i] * p.zy[i] + p.zz[i] * p.zz[i]);
+					float zx = p.zx[i];
+					float zy = p.zy[i];
+					float zz = p.zz[i];
+					float rNext = rNow;
+					mandelbulbStep(zx, zy, zz, rNext, p.sx[i], p.sy[i],
+							p.sz[i]);
+
+					int escaped = (rNow > 2);
+					int go = on & !escaped;
+					p.r[i] = (on ? (escaped ? rNow : rNext) : p.r[i]);
+					p.zx[i] = (go ? zx : p.zx[i]);
+					p.zy[i] = (go ? zy : p.zy[i]);
+					p.zz[i] = (go ? zz : p.zz[i]);
+					p.iter[i] = (go ? p.iter[i] + 1 : p.iter[i]);
+					p.ready[i] = on & (escaped | !(p.iter[i] < limit));
+					live += on;
+				}
+
+				if (live == 0)
+					break;
+				busy[w] += live;
+				lanes[w] += MARCHER_LANES;
+
+				// Rays whose sample is done move on to the next one
+				// right away, so their lanes never wait for others.
+				for (int i = 0; i < p.count; i++)
+					if (p.ready[i])
+						settle(p, i, p.r[i] - 2);
+			}
+
+			// Compaction: The last rays take the lanes of those that are
+			// done, and new ones are appended.
+			for (int i = 0; i < p.count; )
+			{
+				if (p.phase[i] != PHASE_DONE)
+				{
+					i++;
+					continue;
+				}
+
+				int j = --p.count;
+				p.dx[i] = p.dx[j];
+				p.dy[i] = p.dy[j];
+				p.dz[i] = p.dz[j];
+				p.n[i] = p.n[j];
+				p.alpha[i] = p.alpha[j];
+				p.a1[i] = p.a1[j];
+				p.cstep[i] = p.cstep[j];
+				p.hx[i] = p.hx[j];
+				p.hy[i] = p.hy[j];
+				p.hz[i] = p.hz[j];
+				p.hval[i] = p.hval[j];
+				p.nx[i] = p.nx[j];
+				p.ny[i] = p.ny[j];
+				p.sx[i] = p.sx[j];
+				p.sy[i] = p.sy[j];
+				p.sz[i] = p.sz[j];
+				p.zx[i] = p.zx[j];
+				p.zy[i] = p.zy[j];
+				p.zz[i] = p.zz[j];
+				p.r[i] = p.r[j];
+				p.iter[i] = p.iter[j];
+				p.ready[i] = p.ready[j];
+				p.sitStart[i] = p.sitStart[j];
+				p.phase[i] = p.phase[j];
+				p.pixel[i] = p.pixel[j];
+			}
+			refill();
+		}
+	}, 1);
+
+	double b = 0;
+	double l = 0;
+	for (int w = 0; w < workers; w++)
+	{
+		b += busy[w];
+		l += lanes[w];
+	}
+	_busy = (l > 0 ? b / l : 1);
+}
+
+void CpuMarcher::marchScalar(const MarcherView& view, const int *region,
+		float *geometry)
+{
+	parallelFor(region[3], [&](int row)
+	{
+		int y = region[1] + row;
+		for (int x = region[0]; x < region[0] + region[2]; x++)
+		{
+			float eye[3];
+			float dir[3];
+			viewRay(view, x, y, eye, dir);
+			float *g = &geometry[4 * (y * view.w + x)];
+
+			// findIntersection() of ray/marching.glsl, ray_start is 0.
+			float cstep = _stepsize;
+			float n = std::floor(0 / cstep) + 1;
+			float alpha = cstep * n;
+
+			float at[3];
+			for (int j = 0; j < 3; j++)
+				at[j] = eye[j] + alpha * dir[j];
+			float val = mandelbulb(at[0], at[1], at[2], _iterations);
+			bool sit = (val < 0);
+
+			n += 1;
+			alpha = cstep * n;
+
+			bool sitStart = sit;
+			bool hit = false;
+
+			while (alpha < MARCHER_MAXVAL)
+			{
+				for (int j = 0; j < 3; j++)
+					at[j] = eye[j] + alpha * dir[j];
+				val = mandelbulb(at[0], at[1], at[2], _iterations);
+				sit = (val < 0);
+
+				if (sit != sitStart)
+				{
+					float a1 = alpha - _stepsize;
+
+					while (cstep > _accuracy)
+					{
+						cstep *= 0.5f;
+						alpha = a1 + cstep;
+
+						for (int j = 0; j < 3; j++)
+							at[j] = eye[j] + alpha * dir[j];
+						val = mandelbulb(at[0], at[1], at[2], _iterations);
+						sit = (val < 0);
+
+						if (sit == sitStart)
+							a1 = alpha;
+					}
+
+					float e = MARCHER_NORMAL_EPS;
+					writeHit(g, eye, at, val,
+							mandelbulb(at[0] + e, at[1], at[2], _iterations),
+							mandelbulb(at[0], at[1] + e, at[2], _iterations),
+							mandelbulb(at[0], at[1], at[2] + e, _iterations));
+					hit = true;
+					break;
+				}
+
+				n += 1;
+				alpha = cstep * n;
+			}
+
+			if (!hit)
+				writeMiss(g);
+		}
+	});
+}
+
+double CpuMarcher::busy() const
+{
+	return _busy;
+}
@@ -0,0 +1,85 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CPUMARCHER_HPP
+#define CPUMARCHER_HPP
+
+// Rays that take a step together, eight AVX vectors.
+#define MARCHER_LANES 64
+
+// Pixels are handed out to the rays in tiles of this size.
+#define MARCHER_TILE 8
+
+// What the first pass knows about the camera, see shadeRay() in
+// shader_fragment.glsl. rot is row major, planeRect is the part of the
+// viewing plane that the w x h pixels show (left, bottom, right, top).
+struct MarcherView
+{
+	float rot[16];
+	float pos[3];
+	float eyedist;
+	float planeRect[4];
+	int w;
+	int h;
+};
+
+// objects/m_mandelbulb.glsl and ray/marching.glsl on the CPU. Each
+// thread keeps a pool of rays in arrays, one per member of the state
+// (structure of arrays). All of them take one iteration of evalAt() at
+// a time, so the compiler can vectorize it. A ray whose sample is done
+// starts its next one in the same lane right away. Rays that are done
+// leave their lane idle until the pool is compacted every few
+// iterations, then new rays from the current tile take the free lanes.
+class CpuMarcher
+{
+	private:
+		float _stepsize;
+		float _accuracy;
+		float _iterations;
+		int _compactEvery;
+
+		// Of the last march().
+		double _busy;
+
+	public:
+		CpuMarcher();
+
+		void setQuality(float stepsize, float accuracy);
+		void setIterations(float iterations);
+		void setCompaction(int iterations);
+
+		// Fills the pixels of region (x, y, width, height) in geometry,
+		// which has four floats for each of the w x h pixels, bottom row
+		// first: The normal and the distance of the hit like
+		// out_geometry, -1 on misses.
+		void march(const MarcherView& view, const int *region,
+				float *geometry);
+
+		// The same, one ray after the other like the shader. The result
+		// is exactly the same.
+		void marchScalar(const MarcherView& view, const int *region,
+				float *geometry);
+
+		// Fraction of the lanes that were busy with an iteration of
+		// evalAt() in the last march().
+		double busy() const;
+};
+
+#endif // CPUMARCHER_HPP
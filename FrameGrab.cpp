@@ -0,0 +1,76 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+
+#include "Image.hpp"
+#include "SharedFrameReader.hpp"
+
+// Example for the reader side of the shared memory export: Follows the
+// frames published by "tracer --shm NAME" and optionally saves the
+// next one to an image file.
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " NAME [image file]"
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	SharedFrameReader reader;
+	while (!reader.open(argv[1]))
+		usleep(100000);
+
+	uint64_t last = 0;
+	for (;;)
+	{
+		if (reader.published() == last)
+		{
+			usleep(1000);
+			continue;
+		}
+
+		SharedFrameView view;
+		if (!reader.latest(view))
+			continue;
+
+		if (argc > 2)
+		{
+			Image img;
+			img.fromRGBA(view.pixels, view.meta.width, view.meta.height);
+			if (!reader.valid(view))
+				continue;
+			img.save(argv[2]);
+			std::cout << "Saved frame " << view.meta.frame << " to `"
+				<< argv[2] << "'." << std::endl;
+			return EXIT_SUCCESS;
+		}
+
+		std::cout << "Frame " << view.meta.frame << ": "
+			<< view.meta.width << "x" << view.meta.height << ", camera at "
+			<< view.meta.pos[0] << " " << view.meta.pos[1] << " "
+			<< view.meta.pos[2] << std::endl;
+		last = view.meta.frame;
+	}
+}
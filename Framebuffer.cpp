@@ -0,0 +1,169 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <iostream>
+
+#include "Framebuffer.hpp"
+
+
+Framebuffer::Framebuffer()
+{
+	_fbo = 0;
+	_color = 0;
+	_extra = 0;
+	_depth = 0;
+	_w = 0;
+	_h = 0;
+}
+
+Framebuffer::~Framebuffer()
+{
+	destroy();
+}
+
+static GLuint colorTexture(int w, int h, GLenum format)
+{
+	GLuint tex;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, w, h, 0, GL_RGBA, GL_FLOAT,
+			NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return tex;
+}
+
+bool Framebuffer::create(int w, int h, GLenum format, GLenum extraFormat)
+{
+	destroy();
+
+	_w = w;
+	_h = h;
+
+	_color = colorTexture(w, h, format);
+	if (extraFormat != 0)
+		_extra = colorTexture(w, h, extraFormat);
+
+	glGenRenderbuffers(1, &_depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, _depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &_fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			GL_TEXTURE_2D, _color, 0);
+	if (_extra != 0)
+	{
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+				GL_TEXTURE_2D, _extra, 0);
+
+		// Draw buffers are part of the framebuffer object's state.
+		GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, buffers);
+	}
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+			GL_RENDERBUFFER, _depth);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "Framebuffer " << w << "x" << h
+			<< " incomplete: 0x" << std::hex << status << std::dec
+			<< std::endl;
+		destroy();
+		return false;
+	}
+
+	return true;
+}
+
+void Framebuffer::destroy()
+{
+	if (_fbo != 0)
+		glDeleteFramebuffers(1, &_fbo);
+	if (_color != 0)
+		glDeleteTextures(1, &_color);
+	if (_extra != 0)
+		glDeleteTextures(1, &_extra);
+	if (_depth != 0)
+		glDeleteRenderbuffers(1, &_depth);
+
+	_fbo = 0;
+	_color = 0;
+	_extra = 0;
+	_depth = 0;
+}
+
+void Framebuffer::bind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+	glViewport(0, 0, _w, _h);
+}
+
+void Framebuffer::unbind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Framebuffer::blitTo(GLuint target)
+{
+	GLint read, draw;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read);
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &draw);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, _fbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+	glBlitFramebuffer(0, 0, _w, _h, 0, 0, _w, _h, GL_COLOR_BUFFER_BIT,
+			GL_NEAREST);
+
+	// Depth on its own: If the window's depth buffer has a different
+	// format, only this one fails.
+	glBlitFramebuffer(0, 0, _w, _h, 0, 0, _w, _h, GL_DEPTH_BUFFER_BIT,
+			GL_NEAREST);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, read);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, draw);
+}
+
+GLuint Framebuffer::id()
+{
+	return _fbo;
+}
+
+GLuint Framebuffer::texture(int i)
+{
+	return (i == 0 ? _color : _extra);
+}
+
+int Framebuffer::w()
+{
+	return _w;
+}
+
+int Framebuffer::h()
+{
+	return _h;
+}
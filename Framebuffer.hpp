@@ -0,0 +1,61 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef FRAMEBUFFER_HPP
+#define FRAMEBUFFER_HPP
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+// An offscreen render target: One color texture plus a depth buffer.
+// Optionally, a second color texture can be attached. Both are drawn to
+// then (gl_FragData[0] and [1]).
+class Framebuffer
+{
+	private:
+		GLuint _fbo;
+		GLuint _color;
+		GLuint _extra;
+		GLuint _depth;
+		int _w;
+		int _h;
+
+	public:
+		Framebuffer();
+		~Framebuffer();
+
+		bool create(int w, int h, GLenum format = GL_RGBA8,
+				GLenum extraFormat = 0);
+		void destroy();
+		void bind();
+		static void unbind();
+
+		// Copy the color and depth buffers to another framebuffer
+		// object, 0 is the window. The current binding is left alone.
+		void blitTo(GLuint target);
+
+		GLuint id();
+		GLuint texture(int i = 0);
+		int w();
+		int h();
+};
+
+#endif // FRAMEBUFFER_HPP
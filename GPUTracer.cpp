@@ -19,26 +19,104 @@
 
 
 #define GL_GLEXT_PROTOTYPES
-#include <GL/glut.h>
+#include <GL/freeglut.h>
 
 #include <cstdlib>
 #include <cstdio>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
 
 #include "Viewport.hpp"
+#include "CameraPath.hpp"
+#include "Framebuffer.hpp"
+#include "Image.hpp"
+#include "Sweep.hpp"
+#include "Capture.hpp"
+#include "VideoStream.hpp"
+#include "SharedFrameWriter.hpp"
+#include "Offscreen.hpp"
+#include "BrickCache.hpp"
+#include "Mesh.hpp"
+#include "Bvh.hpp"
+#include "Instances.hpp"
+#include "Lights.hpp"
+#include "CpuMarcher.hpp"
+#include "Wavefront.hpp"
+#include "Parallel.hpp"
 
 Viewport win;
 static const double rotationDegree = 2;
 static GLuint shader;
-static GLint handle_rot;
-static GLint handle_pos;
-static GLint handle_eyedist;
-static GLint handle_stepsize;
-static GLint handle_accuracy;
-static GLint handle_user_params0;
-static GLint handle_user_params1;
+static GLint handle_pass;
+static GLint handle_viewport_size;
+static GLint handle_aa_samples;
+static GLint handle_aa_depth;
+static GLint handle_aa_normal;
+static GLint handle_light_count;
+static GLint handle_reproject;
+static GLint handle_reproject_margin;
+static GLint handle_reproject_offset;
+static GLint handle_proxy;
+static GLint handle_proxy_lo;
+static GLint handle_proxy_hi;
+static GLint handle_wavefront;
+static GLint handle_wavefront_origin;
+
+static GLint handle_baked_min;
+static GLint handle_baked_size;
+static GLint handle_baked_band;
+static GLint handle_baked_levels;
+static GLint handle_occupancy_min;
+static GLint handle_occupancy_size;
+static GLint handle_occupancy_res;
+
+static GLuint reprojectShader;
+static GLint handle_reproject_prev_rot;
+static GLint handle_reproject_prev_pos;
+static GLint handle_reproject_prev_eyedist;
+static GLint handle_reproject_prev_ratio;
+
+// Everything that stays the same during a frame goes to one uniform
+// buffer, bound to point 0 and declared in shader_frame.glsl. The
+// layout is std140: A vec3 takes four floats unless a float follows.
+struct FrameBlock
+{
+	float rot[16];
+	float pos[3];
+	float eyedist;
+	float planeRect[4];
+	float ratio;
+	float stepsize;
+	float accuracy;
+	float pad;
+	float userParams[2][4];
+	float lightPosition[2][4];
+	float lightDiffuse[2][4];
+	float lightSpecular[2][4];
+	float lightOn[4];
+};
+static GLuint frameBuffer = 0;
+
+// The part of the viewing plane that the viewport shows (left, bottom,
+// right, top) and half the width of the whole plane. Posters show one
+// tile of it at a time.
+static float planeRect[4] = { -1, -1, 1, 1 };
+static float planeRatio = 1;
+
+// Geometry: A static quad covering the viewport, and a buffer for
+// everything that changes from draw to draw. Attribute 0 is "vertex"
+// in all shaders, 1 is "color", see buildProgram().
+static GLuint quadArray = 0;
+static GLuint quadBuffer = 0;
+static GLuint streamArray = 0;
+static GLuint streamBuffer = 0;
+static GLuint overlayShader = 0;
 
 static bool mouseLook = false;
 static bool mouseInverted = true;
@@ -79,220 +157,2694 @@ static float lights_step = 0.1;
 
 static float user_params[][4] =
 	{
-		{ 0.0, 0.0, 0.0, 0.0 },
-		{ 5.0, 5.0, 5.0, 5.0 }
-	};
-static float user_params_steps[] = { 0.1, 1.0 };
+		{ 0.0, 0.0, 0.0, 0.0 },
+		{ 5.0, 5.0, 5.0, 5.0 }
+	};
+static float user_params_steps[] = { 0.1, 1.0 };
+
+// 0 = change user settings with F1-F10, 1 = change light settings.
+static int settings_target = 0;
+
+// Camera path playback. pathFrame is the index of the frame that will
+// be shown by the next call to display(), -1 if not playing.
+static CameraPath cameraPath;
+static std::vector<CameraKey> pathFrames;
+static int pathFrame = -1;
+static int pathFrameCount = 250;
+static bool pathDump = false;
+
+// Parameter sweeps: Render all variants into a contact sheet (or into
+// single files, too, if sweepFull is set) and exit.
+static Sweep sweep;
+static int sweepThumbW = 160;
+static int sweepThumbH = 100;
+static bool sweepFull = false;
+static const char *sweepPrefix = "sweep";
+
+// Poster mode: Very large stills, rendered tile by tile.
+static int posterW = 0;
+static int posterH = 0;
+static int posterTile = 512;
+static const char *posterPath = "poster.ppm";
+
+// Mesh export: evalAt() is sampled on the GPU plane by plane, the
+// planes are meshed on the CPU. Only a few planes are kept at a time.
+static const char *meshPath = NULL;
+static int meshRes = 256;
+static bool meshFast = false;
+
+// Screenshots ([p]) and continuous capture ([P]).
+static Capture capture;
+static ImageSaver *imageSaver = NULL;
+static const char *capturePrefix = "capture";
+static const char *captureFormat = "png";
+static bool captureContinuous = false;
+static bool capturePolling = false;
+
+// Video recording ([V]), to a file or to stdout ("-").
+static VideoStream *videoStream = NULL;
+static const char *videoPath = NULL;
+static int videoFps = 30;
+static bool videoRecording = false;
+
+// Export of every frame to a shared memory ring.
+static SharedFrameWriter sharedFrames;
+static const char *sharedName = NULL;
+static int sharedSlots = 3;
+static int sharedMaxW = 3840;
+static int sharedMaxH = 2160;
+
+// The first pass can store normal and hit distance of each pixel along
+// with the color. There are two of these targets, so the last complete
+// frame is still around while the next one is rendered.
+static Framebuffer primaryTargets[2];
+static int primaryCur = 0;
+static int shaderPass = 0;
+
+// Adaptive antialiasing: Only pixels at discontinuities of the first
+// pass get more rays. The number of refined pixels is counted with an
+// occlusion query.
+static int aaSamples = 0;
+static int aaBudget = 8;
+static float aaDepth = 0.05;
+static float aaNormal = 0.9;
+static GLuint aaQuery = 0;
+static long aaRefinedFrame = 0;
+static long aaRefined = 0;
+
+// Temporal reprojection: The hits of the last frame are splatted into
+// the new view. Rays start a little before the reprojected hit instead
+// of at the eye.
+struct CameraState
+{
+	float rot[16];
+	float pos[3];
+	float eyedist;
+	float ratio;
+};
+static bool reproject = false;
+static float reprojectMargin = 0.05;
+static bool reprojectValid = false;
+static CameraState reprojectCamera;
+static Framebuffer reprojectTarget;
+static GLuint reprojectPoints = 0;
+static GLuint reprojectArray = 0;
+
+// Baked volumes: Some marchers read a 3D texture that is computed from
+// the object on the GPU, one slice at a time. That only has to be done
+// again if the user settings change.
+struct BakedVolume
+{
+	const char *name;
+	GLenum format;
+	GLint filter;
+	int res;
+	float band;
+	bool cache;
+
+	// Coarser levels above the samples, see buildBakedLevels().
+	int levels;
+
+	GLuint program;
+	uint64_t source;
+	GLint handle_min;
+	GLint handle_size;
+	GLint handle_res;
+	GLint handle_slice;
+	GLint handle_band;
+
+	GLuint texture;
+	float params[2][4];
+	bool valid;
+
+	BakedVolume(const char *n, GLenum f, GLint fi, int r, float b, bool c,
+			int l)
+		: name(n), format(f), filter(fi), res(r), band(b), cache(c),
+		levels(l), program(0), source(0), texture(0), valid(false)
+	{
+	}
+};
+
+static float bakeBox = 2;
+
+// For ray/baked.glsl: evalAt() itself, clamped to a band around the
+// surface. Half floats are precise close to zero where it matters. Four
+// coarser levels let the marcher skip empty space in larger steps.
+static BakedVolume bakedField("samples", GL_R16F, GL_LINEAR, 128, 0.25,
+		true, 4);
+
+// For ray/marching_occupancy.glsl: Cells that are certainly empty.
+static BakedVolume occupancy("cells", GL_R8, GL_NEAREST, 32, 0.05, false,
+		0);
+
+// Baked fields can be kept on disk, see BrickCache.hpp.
+static const char *bakeCacheDir = NULL;
+
+// Triangle meshes for objects/d_mesh.glsl: The BVH is uploaded as three
+// textures, the boxes of the nodes, their children and the triangles.
+// They are bound to units 5, 14 and 6.
+static const char *modelPath = NULL;
+static float modelFit = 0;
+static GLuint bvhTextures[3] = { 0, 0, 0 };
+
+// Instanced primitives for objects/d_instances.glsl and blobs for
+// objects/m_blobs.glsl. The file is polled while the program runs. New
+// lines are read in chunks, and the grid is built again after each one.
+// sceneVersion counts the changes. The textures stay bound to units 7
+// to 9.
+static const char *instancesPath = NULL;
+static int instancesChunk = 100000;
+static InstanceReader instanceReader;
+static std::vector<Instance> instances;
+static InstanceGrid instanceGrid;
+static GLuint instanceTextures[3] = { 0, 0, 0 };
+static int sceneVersion = 0;
+
+// More lights from --lights, uploaded once and bound to unit 10. When
+// the first pass has its own target, a culling pass sorts them into
+// lists per screen tile (units 11 and 12), and a second pass adds the
+// lights of each pixel's tile to its color. Everything else (posters,
+// sweeps, the refinement) loops over all lights. --light-tile 0 does
+// that always.
+static const char *lightsPath = NULL;
+static int lightTile = LIGHT_TILE;
+static LightList lightList;
+static GLuint lightTexture = 0;
+static Framebuffer lightDepth;
+static Framebuffer lightTiles;
+static GLuint lightTileShader = 0;
+static GLuint lightShader = 0;
+static bool lightsDeferred = false;
+
+// Shadow rays toward the lights, see objects/lib/shadows.glsl. Each ray
+// evaluates the object at most shadowBudget times, 0 turns shadows off.
+// Marching rays take steps of at least shadowStep times the step size.
+// The headlight sits at the eye and hides its shadows behind whatever
+// casts them, so it has none by default. [y] prints what shadows cost.
+static int shadowBudget = 32;
+static float shadowStep = 2;
+static float shadowSoft = 8;
+static bool shadowLights[2] = { false, true };
+static bool shadowReport = false;
+
+// Proxy geometry: Instead of one quad covering the screen, the faces of
+// a box around the object are drawn, so only pixels whose rays hit the
+// box run the shader. Rays are cut to the box as well. The box is the
+// one of the mesh or the instances, [-bakeBox, bakeBox]^3 for all other
+// objects. Off by default, formulas don't have to stay inside of it.
+static bool proxy = false;
+static bool proxyFixed = false;
+static float proxyLo[3];
+static float proxyHi[3];
+
+// Wavefront marching: The rays of the first pass march in a compute
+// shader instead, see Wavefront.hpp. The fragment shader only shades the
+// hits then. wavefrontReport is --wavefront-cost.
+static Wavefront wavefront;
+static bool wavefrontReport = false;
+
+// CPU marching: The first pass for objects/m_mandelbulb.glsl with
+// ray/marching.glsl runs on the CPU instead, see CpuMarcher.hpp. Rays
+// are compacted every cpuSteps iterations of evalAt(), 0 is off. Its
+// hits go to the fragment shader like those of the kernel above.
+static int cpuSteps = 0;
+static bool cpuStats = false;
+static bool cpuVerify = false;
+static CpuMarcher cpuMarcher;
+static std::vector<float> cpuGeometry;
+static GLuint cpuHits = 0;
+static int cpuW = 0;
+static int cpuH = 0;
+
+// Time slicing: Frames are rendered in bands, as many of them per call
+// of display() as are expected to take sliceBudget milliseconds on the
+// GPU. Cheap frames are done in one call, expensive ones take several.
+// The last complete frame stays on screen meanwhile. The GPU time comes
+// from timer queries, read a redraw or two later so that nothing waits
+// for them. It's kept per unit of sliceRowCost(), so that the expected
+// time follows changes of the settings right away, before their first
+// frame is measured.
+static int sliceBudget = 40;
+static Framebuffer sliceTargets[2];
+static int sliceWork = 0;
+static bool sliceHaveFrame = false;
+static int sliceRow = -1;
+static double sliceUnitTime = 0;
+static std::vector<float> sliceSignature;
+static GLuint sliceQueries[2] = { 0, 0 };
+static int sliceQueryRows[2] = { 0, 0 };
+static double sliceQueryCost[2] = { 0, 0 };
+static int sliceQueryNext = 0;
+
+// Batch mode without a window. Frames go to a Framebuffer, which takes
+// the place of the window's default framebuffer.
+static bool offscreen = false;
+static OffscreenContext offscreenContext;
+static Framebuffer offscreenTarget;
+
+char *readFile(const char *path)
+{
+	char *databuf = NULL;
+	int length = 0;
+
+	std::ifstream instream;
+	instream.open(path, std::ios::binary);
+	if (!instream.is_open())
+		return NULL;
+
+	// Get length of file.
+	instream.seekg(0, std::ios::end);
+	length = instream.tellg();
+	instream.seekg(0, std::ios::beg);
+
+	// Allocate memory.
+	databuf = new char[length + 1];
+
+	// Read data as a block.
+	instream.read(databuf, length);
+	instream.close();
+
+	// Add NULL terminator.
+	databuf[length] = 0;
+
+	return databuf;
+}
+
+void showLog(GLuint shader, const char *which)
+{
+	std::cout << which << std::endl;
+	int len = 0;
+	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &len);
+	// More than the NULL terminator?
+	if (len > 1)
+	{
+		char *log = new char[len];
+		int dummy = 0;
+		glGetShaderInfoLog(shader, len, &dummy, log);
+		std::cout << log << std::endl;
+		delete[] log;
+	}
+	else
+	{
+		std::cout << "Okay, error log empty." << std::endl;
+	}
+	std::cout << std::endl;
+}
+
+GLuint buildProgram(const char *vsPath, const char *fsPath)
+{
+	const char *header = readFile("shader_frame.glsl");
+	const char *vs_source = readFile(vsPath);
+	const char *fs_source = readFile(fsPath);
+	GLuint program = 0;
+	GLuint shader_handle = 0;
+
+	if (header == NULL || vs_source == NULL || fs_source == NULL)
+	{
+		fprintf(stderr, "Could not load shaders.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	program = glCreateProgram();
+
+	// Both stages start with the version and the frame's uniform block.
+	const char *vs[3] = { "#version 150\n", header, vs_source };
+	const char *fs[3] = { "#version 150\n", header, fs_source };
+
+	shader_handle = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(shader_handle, 3, vs, NULL);
+	glCompileShader(shader_handle);
+	showLog(shader_handle, "Vertex shader:");
+	glAttachShader(program, shader_handle);
+
+	shader_handle = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(shader_handle, 3, fs, NULL);
+	glCompileShader(shader_handle);
+	showLog(shader_handle, "Fragment shader:");
+	glAttachShader(program, shader_handle);
+
+	// Unused names don't hurt.
+	glBindAttribLocation(program, 0, "vertex");
+	glBindAttribLocation(program, 1, "color");
+	glBindFragDataLocation(program, 0, "out_color");
+	glBindFragDataLocation(program, 1, "out_geometry");
+	glLinkProgram(program);
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked)
+	{
+		char log[4096];
+		glGetProgramInfoLog(program, sizeof log, NULL, log);
+		std::cerr << "Could not link `" << vsPath << "' and `" << fsPath
+			<< "':" << std::endl << log << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	GLuint block = glGetUniformBlockIndex(program, "Frame");
+	if (block != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, block, 0);
+
+	delete[] header;
+	delete[] vs_source;
+	delete[] fs_source;
+	return program;
+}
+
+// Compute shaders need OpenGL 4.3. The context is a 3.2 core profile at
+// least, most drivers give the newest one they have.
+GLuint buildCompute(const char *csPath)
+{
+	GLint major = 0;
+	GLint minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if (major * 10 + minor < 43)
+	{
+		std::cerr << "`" << csPath << "' needs OpenGL 4.3, this is "
+			<< major << "." << minor << "." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	const char *header = readFile("shader_frame.glsl");
+	const char *cs_source = readFile(csPath);
+	if (header == NULL || cs_source == NULL)
+	{
+		fprintf(stderr, "Could not load shaders.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	const char *cs[3] = { "#version 430\n", header, cs_source };
+	GLuint shader_handle = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(shader_handle, 3, cs, NULL);
+	glCompileShader(shader_handle);
+	showLog(shader_handle, "Compute shader:");
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, shader_handle);
+	glLinkProgram(program);
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked)
+	{
+		char log[4096];
+		glGetProgramInfoLog(program, sizeof log, NULL, log);
+		std::cerr << "Could not link `" << csPath << "':" << std::endl
+			<< log << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	GLuint block = glGetUniformBlockIndex(program, "Frame");
+	if (block != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, block, 0);
+
+	delete[] header;
+	delete[] cs_source;
+	return program;
+}
+
+// What every draw needs in a core profile: The frame block at binding
+// point 0, a quad and a buffer for vertices that change all the time.
+void createBuffers(void)
+{
+	glGenBuffers(1, &frameBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof (FrameBlock), NULL,
+			GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 0, frameBuffer);
+
+	// Two triangles as a strip.
+	const float corners[8] = { -1, -1, 1, -1, -1, 1, 1, 1 };
+	glGenVertexArrays(1, &quadArray);
+	glBindVertexArray(quadArray);
+	glGenBuffers(1, &quadBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, quadBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof corners, corners, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+
+	glGenVertexArrays(1, &streamArray);
+	glBindVertexArray(streamArray);
+	glGenBuffers(1, &streamBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Camera, quality, user settings and the two lights for all programs,
+// once per frame (or per tile of a poster, or per variant of a sweep).
+// The old contents are orphaned, so this never waits for draws that
+// still read them.
+void updateFrame(void)
+{
+	FrameBlock f;
+	memset(&f, 0, sizeof f);
+
+	// Row major, see shader_frame.glsl.
+	Mat4 T = win.orientationMatrix();
+	for (int i = 0; i < 16; i++)
+		f.rot[i] = T[i];
+	for (int i = 0; i < 3; i++)
+		f.pos[i] = win.pos()[i];
+	f.eyedist = win.eyedist();
+	memcpy(f.planeRect, planeRect, sizeof f.planeRect);
+	f.ratio = planeRatio;
+
+	f.stepsize = raymarching_stepsize;
+	f.accuracy = raymarching_accuracy;
+	memcpy(f.userParams, user_params, sizeof f.userParams);
+
+	memcpy(f.lightPosition, lights, sizeof f.lightPosition);
+	memcpy(f.lightDiffuse, lights_diffuse, sizeof f.lightDiffuse);
+	memcpy(f.lightSpecular, lights_specular, sizeof f.lightSpecular);
+	for (int i = 0; i < 2; i++)
+		f.lightOn[i] = lights_enabled[i];
+
+	glBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof f, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof f, &f);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void drawQuad(void)
+{
+	// Draw one quad so that we get one fragment covering the whole
+	// viewport.
+	glBindVertexArray(quadArray);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glBindVertexArray(0);
+}
+
+// Draws vertices that change every time. Each one has "size" floats:
+// 2 for positions only, 6 for a position and a color.
+void drawStream(GLenum mode, const float *data, int count, int size)
+{
+	glBindVertexArray(streamArray);
+	glBindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+	glBufferData(GL_ARRAY_BUFFER, count * size * sizeof (float), NULL,
+			GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, count * size * sizeof (float),
+			data);
+
+	GLsizei stride = size * sizeof (float);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, (size == 2 ? 2 : 3), GL_FLOAT, GL_FALSE,
+			stride, NULL);
+	if (size == 6)
+	{
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
+				(const void *)(3 * sizeof (float)));
+	}
+	else
+		glDisableVertexAttribArray(1);
+
+	glDrawArrays(mode, 0, count);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Baking programs of blobs need the instances as well, so this is done
+// for every program that uses them.
+void setInstanceUniforms(GLuint program)
+{
+	if (program == 0 || glGetUniformLocation(program, "instance_data") == -1)
+		return;
+
+	const int *res = instanceGrid.res();
+	const float *lo = instanceGrid.lo();
+	const float *cell = instanceGrid.cellSize();
+
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "instance_data"), 7);
+	glUniform1i(glGetUniformLocation(program, "instance_cells"), 8);
+	glUniform1i(glGetUniformLocation(program, "instance_refs"), 9);
+	glUniform3f(glGetUniformLocation(program, "grid_lo"), lo[0], lo[1],
+			lo[2]);
+	glUniform3f(glGetUniformLocation(program, "grid_cell"), cell[0],
+			cell[1], cell[2]);
+	glUniform3f(glGetUniformLocation(program, "grid_res"), res[0], res[1],
+			res[2]);
+	glUseProgram(0);
+}
+
+// Whether CPP kept the declaration of "name" in the assembled fragment
+// shader, see the end of its includes in shader_fragment.glsl.
+bool fragmentDeclares(const char *name)
+{
+	char *source = readFile("shader_fragment_final.glsl");
+	bool found = (source != NULL && strstr(source, name) != NULL);
+	delete[] source;
+	return found;
+}
+
+void buildBakeShader(BakedVolume &v, const char *fsPath)
+{
+	v.program = buildProgram("shader_vertex.glsl", fsPath);
+
+	// The object code is part of the cache key.
+	char *source = readFile(fsPath);
+	v.source = BrickCache::hash(source, strlen(source));
+	delete[] source;
+
+	v.handle_min = glGetUniformLocation(v.program, "bake_min");
+	v.handle_size = glGetUniformLocation(v.program, "bake_size");
+	v.handle_res = glGetUniformLocation(v.program, "bake_res");
+	v.handle_slice = glGetUniformLocation(v.program, "bake_slice");
+	v.handle_band = glGetUniformLocation(v.program, "bake_band");
+
+	setInstanceUniforms(v.program);
+}
+
+void loadBakeShader(BakedVolume &v, const char *sampler, int unit,
+		const char *fsPath)
+{
+	v.program = 0;
+	if (glGetUniformLocation(shader, sampler) == -1)
+		return;
+
+	glUseProgram(shader);
+	glUniform1i(glGetUniformLocation(shader, sampler), unit);
+	glUseProgram(0);
+
+	buildBakeShader(v, fsPath);
+}
+
+// RGBA texture for arbitrary data, "texels" texels in rows of a fixed
+// width. The shader computes coordinates from the width, see
+// objects/lib/texels.glsl.
+GLuint createDataTexture(const void *data, int texels, GLenum internal,
+		GLenum format, GLenum type)
+{
+	GLint maxSize;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	int w = std::min(4096, (int)maxSize);
+	int h = (texels + w - 1) / w;
+	if (h > maxSize)
+		return 0;
+
+	GLuint tex;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, internal, w, h, 0, format, type, NULL);
+
+	// Full rows at once, then what's left. Both types are 4 bytes.
+	int rows = texels / w;
+	if (rows > 0)
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, rows, format, type,
+				data);
+	if (texels % w != 0)
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, rows, texels % w, 1, format,
+				type, (const char *)data + 16 * rows * w);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return tex;
+}
+
+GLuint createDataTexture(const float *data, int texels)
+{
+	return createDataTexture(data, texels, GL_RGBA32F, GL_RGBA, GL_FLOAT);
+}
+
+// Indices and counts. They stay integers all the way to the shader.
+GLuint createDataTexture(const GLuint *data, int texels)
+{
+	return createDataTexture(data, texels, GL_RGBA32UI, GL_RGBA_INTEGER,
+			GL_UNSIGNED_INT);
+}
+
+void loadModel(void)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	if (modelPath == NULL)
+	{
+		std::cerr << "This object needs a mesh, see --model." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	TriangleMesh mesh;
+	if (!mesh.load(modelPath))
+		exit(EXIT_FAILURE);
+	if (mesh.triangles() == 0)
+	{
+		std::cerr << "There are no triangles in `" << modelPath << "'."
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+	if (modelFit > 0)
+		mesh.fit(modelFit);
+
+	Clock::time_point start = Clock::now();
+	Bvh bvh;
+	bvh.build(mesh);
+	std::cout << "Built BVH of " << bvh.triangles() << " triangles in "
+		<< std::chrono::duration<double>(Clock::now() - start).count()
+		* 1000 << " ms: " << bvh.nodes() << " nodes, depth "
+		<< bvh.depth() << "." << std::endl;
+
+	// The root's children hold all triangles. A small margin like the
+	// one of InstanceGrid, flat meshes have to stay inside.
+	const BvhChild *root = bvh.nodeData()[0].child;
+	float largest = 0;
+	for (int a = 0; a < 3; a++)
+	{
+		proxyLo[a] = std::min(root[0].lo[a], root[1].lo[a]);
+		proxyHi[a] = std::max(root[0].hi[a], root[1].hi[a]);
+		largest = std::max(largest, proxyHi[a] - proxyLo[a]);
+	}
+	for (int a = 0; a < 3; a++)
+	{
+		proxyLo[a] -= (largest > 0 ? 1e-4 * largest : 1e-4);
+		proxyHi[a] += (largest > 0 ? 1e-4 * largest : 1e-4);
+	}
+	proxyFixed = true;
+
+	std::vector<float> nodes(16 * bvh.nodes(), 0);
+	std::vector<GLuint> children(4 * bvh.nodes());
+	for (int i = 0; i < bvh.nodes(); i++)
+	{
+		for (int c = 0; c < 2; c++)
+		{
+			const BvhChild &child = bvh.nodeData()[i].child[c];
+			float *out = &nodes[16 * i + 8 * c];
+			for (int a = 0; a < 3; a++)
+			{
+				out[a] = child.lo[a];
+				out[4 + a] = child.hi[a];
+			}
+			children[4 * i + 2 * c] = child.ref;
+			children[4 * i + 2 * c + 1] = child.count;
+		}
+	}
+
+	std::vector<float> triangles(12 * bvh.triangles());
+	for (int i = 0; i < 3 * bvh.triangles(); i++)
+		for (int a = 0; a < 3; a++)
+			triangles[4 * i + a] = bvh.triangleData()[3 * i + a];
+
+	bvhTextures[0] = createDataTexture(nodes.data(), 4 * bvh.nodes());
+	bvhTextures[1] = createDataTexture(triangles.data(),
+			3 * bvh.triangles());
+	bvhTextures[2] = createDataTexture(children.data(), bvh.nodes());
+	if (bvhTextures[0] == 0 || bvhTextures[1] == 0 || bvhTextures[2] == 0)
+	{
+		std::cerr << "The mesh is too large for a texture." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// The tiled lights trace shadow rays, too.
+	GLuint programs[2] = { shader, lightShader };
+	for (int i = 0; i < 2; i++)
+	{
+		GLuint p = programs[i];
+		if (p == 0)
+			continue;
+
+		glUseProgram(p);
+		glUniform1i(glGetUniformLocation(p, "bvh_nodes"), 5);
+		glUniform1i(glGetUniformLocation(p, "bvh_triangles"), 6);
+		glUniform1i(glGetUniformLocation(p, "bvh_children"), 14);
+	}
+	glUseProgram(0);
+}
+
+void uploadInstances(void)
+{
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	instanceGrid.build(instances);
+
+	glDeleteTextures(3, instanceTextures);
+	for (int i = 0; i < 3; i++)
+		instanceTextures[i] = 0;
+
+	if (!instances.empty())
+	{
+		std::vector<GLuint> cells(4 * instanceGrid.cells(), 0);
+		for (int c = 0; c < instanceGrid.cells(); c++)
+		{
+			cells[4 * c] = instanceGrid.cellData()[2 * c];
+			cells[4 * c + 1] = instanceGrid.cellData()[2 * c + 1];
+		}
+
+		std::vector<GLuint> refs((instanceGrid.refs() + 3) / 4 * 4, 0);
+		for (int k = 0; k < instanceGrid.refs(); k++)
+			refs[k] = instanceGrid.refData()[k];
+
+		instanceTextures[0] = createDataTexture(
+				(const float *)instances.data(), 2 * instances.size());
+		instanceTextures[1] = createDataTexture(cells.data(),
+				instanceGrid.cells());
+		instanceTextures[2] = createDataTexture(refs.data(),
+				refs.size() / 4);
+		if (instanceTextures[0] == 0 || instanceTextures[1] == 0
+				|| instanceTextures[2] == 0)
+		{
+			std::cerr << "Too many instances for a texture." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		for (int i = 0; i < 3; i++)
+		{
+			glActiveTexture(GL_TEXTURE7 + i);
+			glBindTexture(GL_TEXTURE_2D, instanceTextures[i]);
+		}
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	setInstanceUniforms(shader);
+	setInstanceUniforms(bakedField.program);
+	setInstanceUniforms(occupancy.program);
+	setInstanceUniforms(lightShader);
+	setInstanceUniforms(wavefront.program());
+
+	// Old hits are no good as start distances anymore, and blobs have to
+	// be baked again.
+	sceneVersion++;
+	reprojectValid = false;
+	bakedField.valid = false;
+	occupancy.valid = false;
+
+	const int *res = instanceGrid.res();
+	for (int a = 0; a < 3; a++)
+	{
+		proxyLo[a] = instanceGrid.lo()[a];
+		proxyHi[a] = proxyLo[a] + res[a] * instanceGrid.cellSize()[a];
+	}
+	proxyFixed = !instances.empty();
+
+	std::cout << "Instances: " << instances.size() << " in "
+		<< res[0] << "x" << res[1] << "x" << res[2] << " cells, "
+		<< instanceGrid.refs() << " references, "
+		<< std::chrono::duration<double>(Clock::now() - start).count()
+		* 1000 << " ms." << std::endl;
+}
+
+void pollInstances(int value)
+{
+	(void)value;
+	if (instanceReader.poll(instances, instancesChunk))
+	{
+		uploadInstances();
+		glutPostRedisplay();
+	}
+
+	glutTimerFunc(instanceReader.pending() ? 0 : 250, pollInstances, 0);
+}
+
+void loadInstances(void)
+{
+	if (instancesPath == NULL)
+	{
+		std::cerr << "This object needs instances, see --instances."
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// Batch modes get everything right away. In the window, the first
+	// chunk is shown while the rest streams in.
+	bool batch = (offscreen || !sweep.empty() || posterW > 0);
+
+	// The reader takes a missing file for an empty one that is still to
+	// be written. There's no waiting for it in batch modes.
+	if (batch)
+	{
+		std::ifstream test(instancesPath);
+		if (!test)
+		{
+			std::cerr << "Could not read instances from `" << instancesPath
+				<< "'." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	instanceReader.open(instancesPath);
+	do
+		instanceReader.poll(instances, instancesChunk);
+	while (batch && instanceReader.pending());
+	uploadInstances();
+
+	if (!batch)
+		glutTimerFunc(250, pollInstances, 0);
+}
+
+void loadLights(void)
+{
+	if (!lightList.load(lightsPath))
+		exit(EXIT_FAILURE);
+
+	if (lightList.size() > 0)
+	{
+		lightTexture = createDataTexture((const float *)lightList.data(),
+				3 * lightList.size());
+		if (lightTexture == 0)
+		{
+			std::cerr << "Too many lights for a texture." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		glActiveTexture(GL_TEXTURE10);
+		glBindTexture(GL_TEXTURE_2D, lightTexture);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	lightTileShader = buildProgram("shader_vertex.glsl",
+			"shader_light_tiles_final.glsl");
+	lightShader = buildProgram("shader_vertex.glsl",
+			"shader_lights_final.glsl");
+
+	GLuint programs[3] = { shader, lightTileShader, lightShader };
+	for (int i = 0; i < 3; i++)
+	{
+		GLuint p = programs[i];
+		glUseProgram(p);
+		glUniform1i(glGetUniformLocation(p, "light_data"), 10);
+		glUniform1i(glGetUniformLocation(p, "light_count"),
+				lightList.size());
+		glUniform1i(glGetUniformLocation(p, "primary_geometry"), 1);
+		glUniform1i(glGetUniformLocation(p, "tile_depth"), 11);
+		glUniform1i(glGetUniformLocation(p, "light_tiles"), 12);
+	}
+	glUseProgram(0);
+
+	std::cout << "Lights: " << lightList.size() << " from `" << lightsPath
+		<< "'." << std::endl;
+}
+
+void loadShaders(void)
+{
+	shader = buildProgram("shader_vertex.glsl", "shader_fragment_final.glsl");
+
+	handle_pass = glGetUniformLocation(shader, "pass");
+	handle_viewport_size = glGetUniformLocation(shader, "viewport_size");
+	handle_aa_samples = glGetUniformLocation(shader, "aa_samples");
+	handle_aa_depth = glGetUniformLocation(shader, "aa_depth");
+	handle_aa_normal = glGetUniformLocation(shader, "aa_normal");
+	handle_light_count = glGetUniformLocation(shader, "light_count");
+
+	handle_reproject = glGetUniformLocation(shader, "reproject");
+	handle_reproject_margin = glGetUniformLocation(shader,
+			"reproject_margin");
+	handle_reproject_offset = glGetUniformLocation(shader,
+			"reproject_offset");
+	handle_proxy = glGetUniformLocation(shader, "proxy");
+	handle_proxy_lo = glGetUniformLocation(shader, "proxy_lo");
+	handle_proxy_hi = glGetUniformLocation(shader, "proxy_hi");
+	handle_wavefront = glGetUniformLocation(shader, "wavefront");
+	handle_wavefront_origin = glGetUniformLocation(shader,
+			"wavefront_origin");
+
+	// Results of the first pass for the refinement, see renderRefine(),
+	// and the start distances, see renderReprojection().
+	glUseProgram(shader);
+	glUniform1i(glGetUniformLocation(shader, "primary_color"), 0);
+	glUniform1i(glGetUniformLocation(shader, "primary_geometry"), 1);
+	glUniform1i(glGetUniformLocation(shader, "reprojected"), 2);
+	glUniform1i(glGetUniformLocation(shader, "wavefront_hits"), 13);
+	glUseProgram(0);
+
+	if (cpuSteps > 0 && !fragmentDeclares("can_cpu"))
+	{
+		std::cerr << "--cpu needs objects/m_mandelbulb.glsl and"
+			<< " ray/marching.glsl or ray/marching_occupancy.glsl."
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// Before the instances, which the kernel needs as well.
+	if (wavefront.steps() > 0)
+	{
+		if (!fragmentDeclares("can_wavefront"))
+		{
+			std::cerr << "--wavefront needs an object with evalAt() and"
+				<< " ray/marching.glsl or ray/marching_occupancy.glsl."
+				<< std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		GLuint p = buildCompute("shader_wavefront_final.glsl");
+		glUseProgram(p);
+		glUniform1i(glGetUniformLocation(p, "reprojected"), 2);
+		glUseProgram(0);
+		wavefront.setProgram(p);
+	}
+
+	// Only some marchers need baked volumes.
+	handle_baked_min = glGetUniformLocation(shader, "baked_min");
+	handle_baked_size = glGetUniformLocation(shader, "baked_size");
+	handle_baked_band = glGetUniformLocation(shader, "baked_band");
+	handle_baked_levels = glGetUniformLocation(shader, "baked_levels");
+	loadBakeShader(bakedField, "baked_field", 3, "shader_bake_final.glsl");
+
+	handle_occupancy_min = glGetUniformLocation(shader, "occupancy_min");
+	handle_occupancy_size = glGetUniformLocation(shader, "occupancy_size");
+	handle_occupancy_res = glGetUniformLocation(shader, "occupancy_res");
+	loadBakeShader(occupancy, "occupancy_grid", 4,
+			"shader_occupancy_final.glsl");
+
+	if (lightsPath != NULL)
+		loadLights();
+	if (glGetUniformLocation(shader, "bvh_nodes") != -1)
+		loadModel();
+	if (glGetUniformLocation(shader, "instance_data") != -1)
+		loadInstances();
+
+	reprojectShader = buildProgram("shader_reproject_vertex.glsl",
+			"shader_reproject_fragment.glsl");
+	handle_reproject_prev_rot = glGetUniformLocation(reprojectShader,
+			"prev_rot");
+	handle_reproject_prev_pos = glGetUniformLocation(reprojectShader,
+			"prev_pos");
+	handle_reproject_prev_eyedist = glGetUniformLocation(reprojectShader,
+			"prev_eyedist");
+	handle_reproject_prev_ratio = glGetUniformLocation(reprojectShader,
+			"prev_ratio");
+	glUseProgram(reprojectShader);
+	glUniform1i(glGetUniformLocation(reprojectShader, "previous_geometry"),
+			0);
+	glUseProgram(0);
+}
+
+uint64_t bakeCacheKey(BakedVolume &v)
+{
+	// Everything the samples depend on.
+	uint64_t key = v.source;
+	key = BrickCache::hash(user_params, sizeof user_params, key);
+	key = BrickCache::hash(&v.res, sizeof v.res, key);
+	key = BrickCache::hash(&v.band, sizeof v.band, key);
+	key = BrickCache::hash(&bakeBox, sizeof bakeBox, key);
+	key = BrickCache::hash(instances.data(),
+			instances.size() * sizeof(Instance), key);
+	return key;
+}
+
+std::string bakeCachePath(uint64_t key)
+{
+	char name[32];
+	snprintf(name, sizeof name, "/%016llx.bricks", (unsigned long long)key);
+	return std::string(bakeCacheDir) + name;
+}
+
+bool loadBakedVolume(BakedVolume &v, uint64_t key)
+{
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	std::string path = bakeCachePath(key);
+	BrickCache cache;
+	if (!cache.open(path.c_str(), key, v.res))
+		return false;
+
+	// Bricks at the far end are cut off by GL.
+	const int S = BRICK_CACHE_SIZE;
+	std::vector<uint16_t> constant(S * S * S);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, S);
+	glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, S);
+	glBindTexture(GL_TEXTURE_3D, v.texture);
+
+	for (int bz = 0; bz < cache.bricks(); bz++)
+		for (int by = 0; by < cache.bricks(); by++)
+			for (int bx = 0; bx < cache.bricks(); bx++)
+			{
+				uint16_t value;
+				const uint16_t *samples = cache.brick(bx, by, bz, value);
+				if (samples == NULL)
+				{
+					std::fill(constant.begin(), constant.end(), value);
+					samples = constant.data();
+				}
+
+				glTexSubImage3D(GL_TEXTURE_3D, 0, bx * S, by * S, bz * S,
+						std::min(S, v.res - bx * S),
+						std::min(S, v.res - by * S),
+						std::min(S, v.res - bz * S),
+						GL_RED, GL_HALF_FLOAT, samples);
+			}
+
+	glBindTexture(GL_TEXTURE_3D, 0);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	std::cout << "Loaded " << v.res << "^3 " << v.name << " from `" << path
+		<< "' in " << std::chrono::duration<double>(Clock::now() - start)
+		.count() * 1000 << " ms, " << cache.stored() << " of "
+		<< cache.bricks() * cache.bricks() * cache.bricks()
+		<< " bricks stored." << std::endl;
+	return true;
+}
+
+void saveBakedVolume(BakedVolume &v, uint64_t key)
+{
+	std::string path = bakeCachePath(key);
+	std::vector<uint16_t> field((size_t)v.res * v.res * v.res);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glBindTexture(GL_TEXTURE_3D, v.texture);
+	glGetTexImage(GL_TEXTURE_3D, 0, GL_RED, GL_HALF_FLOAT, field.data());
+	glBindTexture(GL_TEXTURE_3D, 0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	if (BrickCache::write(path.c_str(), key, v.res, field.data()))
+		std::cout << "Saved " << v.name << " to `" << path << "'."
+			<< std::endl;
+}
+
+// The levels above the samples are not averages. A texel is only
+// saturated (at +band or -band) if all texels of the level below that
+// it covers are saturated with the same sign, otherwise it's zero. So
+// wherever an interpolated lookup of a level is saturated, all of the
+// samples around it are as well, see ray/baked.glsl.
+void buildBakedLevels(BakedVolume &v)
+{
+	if (v.levels == 0)
+		return;
+
+	std::vector<float> below((size_t)v.res * v.res * v.res);
+	glBindTexture(GL_TEXTURE_3D, v.texture);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTexImage(GL_TEXTURE_3D, 0, GL_RED, GL_FLOAT, below.data());
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	int n0 = v.res;
+	for (int l = 1; l <= v.levels; l++)
+	{
+		int n1 = v.res >> l;
+		std::vector<float> above((size_t)n1 * n1 * n1);
+
+		// Texels of the level below that overlap texel i.
+		std::vector<int> lo(n1), hi(n1);
+		for (int i = 0; i < n1; i++)
+		{
+			lo[i] = i * n0 / n1;
+			hi[i] = std::min(n0, ((i + 1) * n0 + n1 - 1) / n1);
+		}
+
+		parallelFor(n1, [&](int z)
+		{
+			for (int y = 0; y < n1; y++)
+				for (int x = 0; x < n1; x++)
+				{
+					float value = below[((size_t)lo[z] * n0 + lo[y]) * n0
+						+ lo[x]];
+					if (std::abs(value) < v.band)
+						value = 0;
+					for (int k = lo[z]; k < hi[z] && value != 0; k++)
+						for (int j = lo[y]; j < hi[y] && value != 0; j++)
+							for (int i = lo[x]; i < hi[x]; i++)
+								if (below[((size_t)k * n0 + j) * n0 + i]
+										!= value)
+								{
+									value = 0;
+									break;
+								}
+					above[((size_t)z * n1 + y) * n1 + x] = value;
+				}
+		});
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage3D(GL_TEXTURE_3D, l, 0, 0, 0, n1, n1, n1, GL_RED,
+				GL_FLOAT, above.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		below.swap(above);
+		n0 = n1;
+	}
+
+	glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+void bakeVolume(BakedVolume &v)
+{
+	if (v.valid && memcmp(v.params, user_params, sizeof v.params) == 0)
+		return;
+
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	if (v.texture == 0)
+	{
+		// No levels smaller than two texels a side.
+		while (v.levels > 0 && (v.res >> v.levels) < 2)
+			v.levels--;
+
+		glGenTextures(1, &v.texture);
+		glBindTexture(GL_TEXTURE_3D, v.texture);
+		for (int l = 0; l <= v.levels; l++)
+		{
+			int r = v.res >> l;
+			glTexImage3D(GL_TEXTURE_3D, l, v.format, r, r, r, 0, GL_RED,
+					GL_FLOAT, NULL);
+		}
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, v.levels);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER,
+				(v.levels == 0 ? v.filter : GL_LINEAR_MIPMAP_NEAREST));
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, v.filter);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_3D, 0);
+	}
+
+	// Somebody might have baked this before.
+	bool cache = (v.cache && bakeCacheDir != NULL);
+	uint64_t key = (cache ? bakeCacheKey(v) : 0);
+	if (cache && loadBakedVolume(v, key))
+	{
+		buildBakedLevels(v);
+		memcpy(v.params, user_params, sizeof v.params);
+		v.valid = true;
+		return;
+	}
+
+	// Whatever is being rendered right now continues afterwards.
+	GLint draw, read, viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &draw);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+	glDisable(GL_SCISSOR_TEST);
+
+	GLuint fbo;
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glViewport(0, 0, v.res, v.res);
+
+	// The user settings come with the frame.
+	glUseProgram(v.program);
+	glUniform3f(v.handle_min, -bakeBox, -bakeBox, -bakeBox);
+	glUniform3f(v.handle_size, 2 * bakeBox, 2 * bakeBox, 2 * bakeBox);
+	glUniform2f(v.handle_res, v.res, v.res);
+	glUniform1f(v.handle_band, v.band);
+
+	for (int z = 0; z < v.res; z++)
+	{
+		glFramebufferTexture3D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+				GL_TEXTURE_3D, v.texture, 0, z);
+		glUniform1f(v.handle_slice, (z + 0.5) / v.res);
+		drawQuad();
+	}
+
+	glDeleteFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, draw);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, read);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	if (scissor)
+		glEnable(GL_SCISSOR_TEST);
+
+	buildBakedLevels(v);
+	memcpy(v.params, user_params, sizeof v.params);
+	v.valid = true;
+
+	if (cache)
+		saveBakedVolume(v, key);
+
+	glFinish();
+	std::cout << "Baked " << v.res << "^3 " << v.name << " in "
+		<< std::chrono::duration<double>(Clock::now() - start).count()
+		* 1000 << " ms." << std::endl;
+}
+
+// Draws the faces of the proxy box that face the eye instead of a quad.
+// They are projected onto the viewing plane here and then into the
+// viewport, see shader_vertex.glsl. That fails when the box reaches
+// behind the eye, and then nothing is drawn and false returned. Pixels
+// outside of the box get what shadeRay() leaves on misses.
+bool drawProxy(void)
+{
+	Mat4 T = win.orientationMatrix();
+	double eyedist = win.eyedist();
+	double plane[8][2];
+	for (int c = 0; c < 8; c++)
+	{
+		double d[3];
+		for (int a = 0; a < 3; a++)
+			d[a] = ((c >> a) & 1 ? proxyHi[a] : proxyLo[a]) - win.pos()[a];
+
+		// Camera space, the eye looks along -z.
+		double local[3];
+		for (int j = 0; j < 3; j++)
+			local[j] = d[0] * T[j] + d[1] * T[4 + j] + d[2] * T[8 + j];
+		if (local[2] > -1e-4)
+			return false;
+
+		for (int j = 0; j < 2; j++)
+		{
+			double onPlane = local[j] * eyedist / -local[2];
+			plane[c][j] = 2 * (onPlane - planeRect[j])
+				/ (planeRect[2 + j] - planeRect[j]) - 1;
+		}
+	}
+
+	const GLfloat missColor[4] = { 0.05, 0.05, 0.05, 1 };
+	const GLfloat missGeometry[4] = { 0, 0, 0, -1 };
+	GLint second = GL_NONE;
+	glGetIntegerv(GL_DRAW_BUFFER1, &second);
+	glClearBufferfv(GL_COLOR, 0, missColor);
+	if (second != GL_NONE)
+		glClearBufferfv(GL_COLOR, 1, missGeometry);
+
+	// Back faces are skipped here already. The shader writes the depth
+	// of its hits.
+	float faces[3 * 6 * 2];
+	int count = 0;
+	for (int a = 0; a < 3; a++)
+	{
+		int b = (a + 1) % 3;
+		int e = (a + 2) % 3;
+		for (int side = 0; side < 2; side++)
+		{
+			if (side == 0 ? win.pos()[a] >= proxyLo[a]
+					: win.pos()[a] <= proxyHi[a])
+				continue;
+
+			// Two triangles.
+			int corners[6] = { 0, 1 << b, (1 << b) | (1 << e),
+				0, (1 << b) | (1 << e), 1 << e };
+			for (int k = 0; k < 6; k++)
+			{
+				int c = corners[k] | (side << a);
+				faces[2 * count] = plane[c][0];
+				faces[2 * count + 1] = plane[c][1];
+				count++;
+			}
+		}
+	}
+
+	// The front faces of a box don't overlap, so the test always passes.
+	// It's only on for the writes, see renderScene().
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_ALWAYS);
+	drawStream(GL_TRIANGLES, faces, count, 2);
+	glDepthFunc(GL_LESS);
+	glDisable(GL_DEPTH_TEST);
+	return true;
+}
+
+// For the current program.
+void setShadowUniforms(GLuint program)
+{
+	glUniform1f(glGetUniformLocation(program, "shadow_budget"),
+			shadowBudget);
+	glUniform1f(glGetUniformLocation(program, "shadow_step"),
+			shadowStep * raymarching_stepsize);
+	glUniform1f(glGetUniformLocation(program, "shadow_offset"),
+			2 * raymarching_accuracy);
+	glUniform1f(glGetUniformLocation(program, "shadow_soft"), shadowSoft);
+	glUniform2f(glGetUniformLocation(program, "shadow_lights"),
+			shadowLights[0], shadowLights[1]);
+}
+
+// The pixels of the first pass relative to the viewport (x, y, width,
+// height): All of them, or the rows in the scissor box when slicing.
+// False if that's none.
+bool firstPassRegion(const GLint *viewport, int *region)
+{
+	region[0] = 0;
+	region[1] = 0;
+	region[2] = viewport[2];
+	region[3] = viewport[3];
+	if (glIsEnabled(GL_SCISSOR_TEST))
+	{
+		GLint box[4];
+		glGetIntegerv(GL_SCISSOR_BOX, box);
+		region[0] = std::max(box[0] - viewport[0], 0);
+		region[1] = std::max(box[1] - viewport[1], 0);
+		region[2] = std::min(box[0] - viewport[0] + box[2], viewport[2])
+			- region[0];
+		region[3] = std::min(box[1] - viewport[1] + box[3], viewport[3])
+			- region[1];
+	}
+	return (region[2] > 0 && region[3] > 0);
+}
+
+// Marches the rays of the first pass for the pixels of the viewport, or
+// of the rows in the scissor box when slicing. Afterwards, the hits are
+// on texture unit 13.
+void renderWavefront(const GLint *viewport)
+{
+	wavefront.resize(viewport[2], viewport[3]);
+
+	int region[4];
+	if (!firstPassRegion(viewport, region))
+		return;
+
+	GLuint p = wavefront.program();
+	glUseProgram(p);
+	glUniform1i(glGetUniformLocation(p, "reproject"), (reproject
+				&& reprojectValid));
+	glUniform1f(glGetUniformLocation(p, "reproject_margin"),
+			reprojectMargin);
+	glUniform1f(glGetUniformLocation(p, "reproject_offset"),
+			2 * raymarching_stepsize);
+	glUniform1i(glGetUniformLocation(p, "proxy"), proxy);
+	glUniform3fv(glGetUniformLocation(p, "proxy_lo"), 1, proxyLo);
+	glUniform3fv(glGetUniformLocation(p, "proxy_hi"), 1, proxyHi);
+
+	wavefront.march(region, raymarching_stepsize);
+
+	glActiveTexture(GL_TEXTURE13);
+	glBindTexture(GL_TEXTURE_2D, wavefront.hits());
+	glActiveTexture(GL_TEXTURE0);
+}
+
+// The same on the CPU. Reprojection and the proxy box are left out, the
+// rays start at the eye. Lane utilization is printed with --cpu-stats,
+// --cpu-verify also marches each ray on its own and compares.
+void renderCpu(const GLint *viewport)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	int w = viewport[2];
+	int h = viewport[3];
+	if (w != cpuW || h != cpuH)
+	{
+		if (cpuHits == 0)
+			glGenTextures(1, &cpuHits);
+
+		glBindTexture(GL_TEXTURE_2D, cpuHits);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, w, h, 0, GL_RGBA,
+				GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		cpuGeometry.assign((size_t)w * h * 4, 0);
+		cpuW = w;
+		cpuH = h;
+	}
+
+	int region[4];
+	if (!firstPassRegion(viewport, region))
+		return;
+
+	MarcherView v;
+	Mat4 T = win.orientationMatrix();
+	for (int i = 0; i < 16; i++)
+		v.rot[i] = T[i];
+	for (int i = 0; i < 3; i++)
+		v.pos[i] = win.pos()[i];
+	v.eyedist = win.eyedist();
+	memcpy(v.planeRect, planeRect, sizeof v.planeRect);
+	v.w = w;
+	v.h = h;
+
+	cpuMarcher.setQuality(raymarching_stepsize, raymarching_accuracy);
+	cpuMarcher.setIterations(user_params[1][0]);
+	cpuMarcher.setCompaction(cpuSteps);
+
+	Clock::time_point start = Clock::now();
+	cpuMarcher.march(v, region, cpuGeometry.data());
+	double ms = std::chrono::duration<double>(Clock::now() - start)
+		.count() * 1000;
+
+	if (cpuStats || cpuVerify)
+		std::cout << "CPU: " << ms << " ms, "
+			<< (int)(100 * cpuMarcher.busy() + 0.5)
+			<< "% of the lanes busy inside of evalAt()." << std::endl;
+
+	if (cpuVerify)
+	{
+		std::vector<float> scalar(cpuGeometry.size());
+		cpuMarcher.marchScalar(v, region, scalar.data());
+
+		int differ = 0;
+		for (int y = region[1]; y < region[1] + region[3]; y++)
+			for (int x = region[0]; x < region[0] + region[2]; x++)
+			{
+				size_t at = 4 * ((size_t)y * w + x);
+				if (memcmp(&cpuGeometry[at], &scalar[at],
+							4 * sizeof (float)) != 0)
+					differ++;
+			}
+		std::cout << "CPU: " << differ << " of " << region[2] * region[3]
+			<< " pixels differ from the scalar marcher." << std::endl;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, cpuHits);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, w);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, region[0], region[1], region[2],
+			region[3], GL_RGBA, GL_FLOAT,
+			&cpuGeometry[4 * ((size_t)region[1] * w + region[0])]);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glActiveTexture(GL_TEXTURE13);
+	glBindTexture(GL_TEXTURE_2D, cpuHits);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void renderScene(void)
+{
+	if (bakedField.program != 0)
+	{
+		bakeVolume(bakedField);
+
+		glActiveTexture(GL_TEXTURE3);
+		glBindTexture(GL_TEXTURE_3D, bakedField.texture);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	if (occupancy.program != 0)
+	{
+		bakeVolume(occupancy);
+
+		glActiveTexture(GL_TEXTURE4);
+		glBindTexture(GL_TEXTURE_3D, occupancy.texture);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	if (bvhTextures[0] != 0)
+	{
+		glActiveTexture(GL_TEXTURE5);
+		glBindTexture(GL_TEXTURE_2D, bvhTextures[0]);
+		glActiveTexture(GL_TEXTURE6);
+		glBindTexture(GL_TEXTURE_2D, bvhTextures[1]);
+		glActiveTexture(GL_TEXTURE14);
+		glBindTexture(GL_TEXTURE_2D, bvhTextures[2]);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	if (!proxyFixed)
+	{
+		for (int a = 0; a < 3; a++)
+		{
+			proxyLo[a] = -bakeBox;
+			proxyHi[a] = bakeBox;
+		}
+	}
+
+	// The first pass only shades what the kernel or the CPU has found.
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	bool cpu = (cpuSteps > 0 && shaderPass == 0);
+	bool kernel = (wavefront.enabled() && shaderPass == 0);
+	if (cpu)
+		renderCpu(viewport);
+	else if (kernel)
+		renderWavefront(viewport);
+	kernel = (kernel || cpu);
+
+	glUseProgram(shader);
+	glUniform3f(handle_baked_min, -bakeBox, -bakeBox, -bakeBox);
+	glUniform3f(handle_baked_size, 2 * bakeBox, 2 * bakeBox, 2 * bakeBox);
+	glUniform1f(handle_baked_band, bakedField.band);
+	glUniform1i(handle_baked_levels, bakedField.levels);
+	glUniform3f(handle_occupancy_min, -bakeBox, -bakeBox, -bakeBox);
+	glUniform3f(handle_occupancy_size, 2 * bakeBox, 2 * bakeBox,
+			2 * bakeBox);
+	glUniform1f(handle_occupancy_res, occupancy.res);
+
+	// Camera, quality, user settings and lights are in the frame's
+	// uniform block, see updateFrame().
+	glUniform2f(handle_viewport_size, viewport[2], viewport[3]);
+	glUniform1i(handle_pass, shaderPass);
+	glUniform1i(handle_aa_samples, aaSamples);
+	glUniform1f(handle_aa_depth, aaDepth);
+	glUniform1f(handle_aa_normal, aaNormal);
+	glUniform1i(handle_reproject, (shaderPass == 0 && reproject
+				&& reprojectValid));
+	glUniform1f(handle_reproject_margin, reprojectMargin);
+	glUniform1f(handle_reproject_offset, 2 * raymarching_stepsize);
+	glUniform1i(handle_light_count, (lightsDeferred ? 0
+				: lightList.size()));
+	glUniform1i(handle_wavefront, kernel);
+	glUniform2i(handle_wavefront_origin, viewport[0], viewport[1]);
+	setShadowUniforms(shader);
+
+	glUniform1i(handle_proxy, proxy);
+	glUniform3fv(handle_proxy_lo, 1, proxyLo);
+	glUniform3fv(handle_proxy_hi, 1, proxyHi);
+
+	// The refinement discards most pixels anyway.
+	// Depth is only written with the test on. The refinement writes the
+	// same depth again, so it must not be rejected.
+	if (!proxy || shaderPass != 0 || !drawProxy())
+	{
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_ALWAYS);
+		drawQuad();
+		glDepthFunc(GL_LESS);
+		glDisable(GL_DEPTH_TEST);
+	}
+}
+
+void drawCoordinateSystem(void)
+{
+	if (overlayShader == 0)
+		overlayShader = buildProgram("shader_overlay_vertex.glsl",
+				"shader_overlay_fragment.glsl");
+
+	// In y direction, move to -0.75.
+	// In x direction, move to  0.75. From that point on, add the
+	// difference of width and height in world coordinates. This
+	// will keep the (drawn) coordinate system at a position with a
+	// fixed margin to the window borders.
+	double r = win.ratio();
+	double x = 0.75 + (win.w() - win.h()) / (double)win.h();
+	double y = -0.75;
+
+	// Each axis is a row of the orientation matrix in camera space,
+	// scaled to 0.2. Then the same orthographic projection as the
+	// viewing plane, which flips z.
+	Mat4 T = win.orientationMatrix();
+	float lines[3 * 2 * 6];
+	for (int a = 0; a < 3; a++)
+	{
+		float *from = &lines[12 * a];
+		float *to = from + 6;
+		from[0] = x / r;
+		from[1] = y;
+		from[2] = 0;
+		to[0] = (x + 0.2 * T[4 * a]) / r;
+		to[1] = y + 0.2 * T[4 * a + 1];
+		to[2] = -0.2 * T[4 * a + 2];
+		for (int c = 0; c < 3; c++)
+			from[3 + c] = to[3 + c] = (c == a);
+	}
+
+	// The depth of the hits is still there, so the object hides the
+	// axes. Only the background leaves them entirely visible.
+	glUseProgram(overlayShader);
+	glEnable(GL_DEPTH_TEST);
+	glLineWidth(3.0);
+	drawStream(GL_LINES, lines, 6, 6);
+	glLineWidth(1.0);
+	glDisable(GL_DEPTH_TEST);
+	glUseProgram(0);
+}
+
+void idleRedraw(void)
+{
+	glutPostRedisplay();
+}
+
+void updateIdle(void)
+{
+	if (offscreen)
+		return;
+
+	// Path playback and video recording need a steady stream of frames.
+	if (pathFrame >= 0 || videoRecording || sliceRow >= 0)
+		glutIdleFunc(idleRedraw);
+	else
+		glutIdleFunc(NULL);
+}
+
+FrameInfo frameInfo(void)
+{
+	static long frame = 0;
+
+	FrameInfo info;
+	info.frame = frame++;
+	info.pos[0] = win.pos().x();
+	info.pos[1] = win.pos().y();
+	info.pos[2] = win.pos().z();
+	Mat4 T = win.orientationMatrix();
+	for (int i = 0; i < 16; i++)
+		info.rot[i] = T[i];
+	info.fov = win.fov();
+	memcpy(info.user_params, user_params, sizeof info.user_params);
+	return info;
+}
+
+void pollCapture(int value)
+{
+	// Nothing might be drawn after a screenshot has been requested.
+	// Don't keep it waiting for the next frame, but don't wait for the
+	// GPU either.
+	(void)value;
+	capture.poll();
+	capturePolling = capture.pending();
+	if (capturePolling)
+		glutTimerFunc(50, pollCapture, 0);
+}
+
+void setCaptureContinuous(bool on)
+{
+	captureContinuous = on;
+	if (on)
+	{
+		capture.addSink(imageSaver);
+		std::cout << "Continuous capture started." << std::endl;
+	}
+	else
+	{
+		capture.removeSink(imageSaver);
+		std::cout << "Continuous capture stopped." << std::endl;
+	}
+}
+
+void setVideoRecording(bool on)
+{
+	if (on && videoStream == NULL)
+	{
+		std::string path = (videoPath != NULL ? videoPath
+				: std::string(capturePrefix) + ".y4m");
+		videoStream = new VideoStream(videoFps);
+		if (!videoStream->open(path))
+		{
+			delete videoStream;
+			videoStream = NULL;
+			return;
+		}
+	}
+
+	videoRecording = on;
+	if (on)
+	{
+		capture.addSink(videoStream);
+		std::cout << "Video recording started." << std::endl;
+	}
+	else if (videoStream != NULL)
+	{
+		// The stream stays open, recording can be resumed.
+		capture.removeSink(videoStream);
+		std::cout << "Video recording paused." << std::endl;
+	}
+
+	updateIdle();
+}
+
+void shutdownCapture(void)
+{
+	capture.flush();
+	if (imageSaver != NULL)
+		imageSaver->finish();
+	if (videoStream != NULL)
+		videoStream->finish();
+	sharedFrames.close();
+}
+
+bool usePrimary(void)
+{
+	return (aaSamples > 0 || reproject
+			|| (lightList.size() > 0 && lightTile > 0));
+}
+
+Framebuffer& primary(void)
+{
+	return primaryTargets[primaryCur];
+}
+
+void preparePrimary(void)
+{
+	int w = win.w();
+	int h = win.h();
+
+	if (primaryTargets[0].w() != w || primaryTargets[0].h() != h)
+	{
+		if (!primaryTargets[0].create(w, h, GL_RGBA8, GL_RGBA32F)
+				|| !primaryTargets[1].create(w, h, GL_RGBA8, GL_RGBA32F)
+				|| !reprojectTarget.create(w, h, GL_R32F))
+			exit(EXIT_FAILURE);
+		reprojectValid = false;
+
+		// One point per pixel, at the center of the pixel.
+		std::vector<float> points;
+		points.reserve(2 * w * h);
+		for (int y = 0; y < h; y++)
+		{
+			for (int x = 0; x < w; x++)
+			{
+				points.push_back((x + 0.5) / w);
+				points.push_back((y + 0.5) / h);
+			}
+		}
+
+		if (reprojectPoints == 0)
+		{
+			glGenBuffers(1, &reprojectPoints);
+			glGenVertexArrays(1, &reprojectArray);
+			glBindVertexArray(reprojectArray);
+			glBindBuffer(GL_ARRAY_BUFFER, reprojectPoints);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+			glBindVertexArray(0);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, reprojectPoints);
+		glBufferData(GL_ARRAY_BUFFER, points.size() * sizeof(float),
+				&points[0], GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	if (aaQuery == 0)
+		glGenQueries(1, &aaQuery);
+}
+
+CameraState cameraState(void)
+{
+	CameraState c;
+	Mat4 T = win.orientationMatrix();
+	for (int i = 0; i < 16; i++)
+		c.rot[i] = T[i];
+	for (int i = 0; i < 3; i++)
+		c.pos[i] = win.pos()[i];
+	c.eyedist = win.eyedist();
+	c.ratio = win.ratio();
+	return c;
+}
+
+void renderReprojection(void)
+{
+	// Zero means: No idea, start at the eye.
+	reprojectTarget.bind();
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	if (!reprojectValid)
+		return;
+
+	CameraState &prev = reprojectCamera;
+
+	// The current camera comes with the frame.
+	glUseProgram(reprojectShader);
+	glUniformMatrix4fv(handle_reproject_prev_rot, 1, true, prev.rot);
+	glUniform3fv(handle_reproject_prev_pos, 1, prev.pos);
+	glUniform1f(handle_reproject_prev_eyedist, prev.eyedist);
+	glUniform1f(handle_reproject_prev_ratio, prev.ratio);
+
+	glBindTexture(GL_TEXTURE_2D, primaryTargets[1 - primaryCur].texture(1));
+
+	// Each hit covers 3x3 pixels and the nearest one wins. So rays
+	// close to a silhouette start in front of the nearer surface.
+	// Pixels that no hit lands on are disoccluded and start at the eye.
+	glEnable(GL_DEPTH_TEST);
+	glPointSize(3);
+	glBindVertexArray(reprojectArray);
+	glDrawArrays(GL_POINTS, 0, win.w() * win.h());
+	glBindVertexArray(0);
+	glPointSize(1);
+	glDisable(GL_DEPTH_TEST);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void setLightUniforms(GLuint program, int words)
+{
+	glUseProgram(program);
+	glUniform2f(glGetUniformLocation(program, "viewport_size"), win.w(),
+			win.h());
+	glUniform1f(glGetUniformLocation(program, "tile_size"), lightTile);
+	glUniform1f(glGetUniformLocation(program, "words"), words);
+	glUniform2f(glGetUniformLocation(program, "light_tiles_size"),
+			lightTiles.w(), lightTiles.h());
+	setShadowUniforms(program);
+}
+
+void renderLights(void)
+{
+	int words = (lightList.size() + LIGHT_WORD - 1) / LIGHT_WORD;
+	int cols = (win.w() + lightTile - 1) / lightTile;
+	int rows = (win.h() + lightTile - 1) / lightTile;
+	if (lightTiles.w() != cols * words || lightTiles.h() != rows)
+		if (!lightDepth.create(cols, rows, GL_RGBA32F)
+				|| !lightTiles.create(cols * words, rows, GL_RGBA32F))
+			exit(EXIT_FAILURE);
+
+	// Only the tiles of the current band, see renderSlices(). Tiles
+	// that reach into other bands see old hits there, which can only
+	// add lights.
+	GLint box[4] = { 0, 0, win.w(), win.h() };
+	if (glIsEnabled(GL_SCISSOR_TEST))
+		glGetIntegerv(GL_SCISSOR_BOX, box);
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, primary().texture(1));
+	glActiveTexture(GL_TEXTURE0);
+
+	// Range of hits per tile first, then the lists.
+	int first = box[1] / lightTile;
+	int count = (box[1] + box[3] + lightTile - 1) / lightTile - first;
+	lightDepth.bind();
+	glScissor(0, first, cols, count);
+	setLightUniforms(lightTileShader, words);
+	glUniform1i(glGetUniformLocation(lightTileShader, "stage"), 0);
+	drawQuad();
+
+	lightTiles.bind();
+	glScissor(0, first, cols * words, count);
+	glActiveTexture(GL_TEXTURE11);
+	glBindTexture(GL_TEXTURE_2D, lightDepth.texture());
+	glActiveTexture(GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(lightTileShader, "stage"), 1);
+	drawQuad();
+
+	// Which groups of lights are used at all, next to the range of hits.
+	lightDepth.bind();
+	glScissor(0, first, cols, count);
+	glColorMask(GL_FALSE, GL_FALSE, GL_TRUE, GL_TRUE);
+	glActiveTexture(GL_TEXTURE11);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE12);
+	glBindTexture(GL_TEXTURE_2D, lightTiles.texture());
+	glActiveTexture(GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(lightTileShader, "stage"), 2);
+	drawQuad();
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+	// Add to the color of the first pass, the geometry stays.
+	primary().bind();
+	glScissor(box[0], box[1], box[2], box[3]);
+	glDrawBuffer(GL_COLOR_ATTACHMENT0);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+
+	glActiveTexture(GL_TEXTURE11);
+	glBindTexture(GL_TEXTURE_2D, lightDepth.texture());
+	glActiveTexture(GL_TEXTURE0);
+
+	setLightUniforms(lightShader, words);
+	drawQuad();
+	glUseProgram(0);
+
+	glDisable(GL_BLEND);
+	GLenum buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, buffers);
+
+	glActiveTexture(GL_TEXTURE12);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE11);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void renderPrimary(void)
+{
+	primary().bind();
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, reprojectTarget.texture());
+	glActiveTexture(GL_TEXTURE0);
+
+	lightsDeferred = (lightList.size() > 0 && lightTile > 0);
+	renderScene();
+	if (lightsDeferred)
+		renderLights();
+	lightsDeferred = false;
+
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void finishPrimary(GLuint target)
+{
+	// Without antialiasing, the first pass is the result. The depth of
+	// its hits comes along, for the refinement and the axes.
+	primary().blitTo(target);
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+	glViewport(0, 0, win.w(), win.h());
+}
+
+void renderRefine(GLuint target)
+{
+	// Start with the result of the first pass, then overwrite the
+	// pixels at edges. Both honor the scissor box.
+	finishPrimary(target);
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, primary().texture(1));
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, primary().texture(0));
+
+	shaderPass = 1;
+	glBeginQuery(GL_SAMPLES_PASSED, aaQuery);
+	renderScene();
+	glEndQuery(GL_SAMPLES_PASSED);
+	shaderPass = 0;
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+
+	// This is the last draw call of the frame (or of the band), so
+	// waiting for the count doesn't hold anything up.
+	GLuint refined = 0;
+	glGetQueryObjectuiv(aaQuery, GL_QUERY_RESULT, &refined);
+	aaRefinedFrame += refined;
+}
+
+void primaryComplete(void)
+{
+	// This frame's hits are what the next one is reprojected from.
+	if (usePrimary())
+	{
+		reprojectCamera = cameraState();
+		reprojectValid = reproject;
+		primaryCur = 1 - primaryCur;
+	}
+	else
+		reprojectValid = false;
+}
+
+void tellAA(void)
+{
+	if (aaSamples <= 0)
+	{
+		std::cout << "Adaptive antialiasing is off." << std::endl;
+		return;
+	}
+
+	long total = (long)win.w() * win.h();
+	std::cout << "Adaptive antialiasing: " << aaSamples
+		<< " extra rays for " << aaRefined << " of " << total
+		<< " pixels (" << (100.0 * aaRefined / total) << "%), "
+		<< "like " << (1 + aaSamples * aaRefined / (double)total)
+		<< "x supersampling." << std::endl;
+}
+
+std::vector<float> frameSignature(void)
+{
+	// Everything that has an influence on the image.
+	std::vector<float> sig;
+	Mat4 T = win.orientationMatrix();
+	for (int i = 0; i < 16; i++)
+		sig.push_back(T[i]);
+	for (int i = 0; i < 3; i++)
+		sig.push_back(win.pos()[i]);
+	sig.push_back(win.eyedist());
+	sig.push_back(win.w());
+	sig.push_back(win.h());
+	sig.push_back(raymarching_stepsize);
+	sig.push_back(raymarching_accuracy);
+	sig.push_back(aaSamples);
+	sig.push_back(reproject);
+	sig.push_back(sceneVersion);
+	for (int i = 0; i < 2; i++)
+	{
+		sig.insert(sig.end(), user_params[i], user_params[i] + 4);
+		sig.insert(sig.end(), lights[i], lights[i] + 4);
+		sig.insert(sig.end(), lights_diffuse[i], lights_diffuse[i] + 4);
+		sig.insert(sig.end(), lights_specular[i], lights_specular[i] + 4);
+		sig.push_back(lights_enabled[i]);
+	}
+	return sig;
+}
+
+// Relative cost of one row with the current settings: Its pixels times
+// the calls of evalAt() a marching ray makes at most (see
+// ray/marching.glsl).
+double sliceRowCost(void)
+{
+	double steps = 10.0 / raymarching_stepsize
+		+ log2(std::max(1.0, (double)raymarching_stepsize
+					/ raymarching_accuracy));
+	return win.w() * steps;
+}
+
+// Seconds per row with the current settings, 0 if nothing has been
+// measured yet.
+double sliceRowTime(void)
+{
+	return sliceUnitTime * sliceRowCost();
+}
+
+// Reads the time of query q, if there's one, and only waits for it if
+// told to.
+void collectSliceQuery(int q, bool wait)
+{
+	if (sliceQueryRows[q] == 0)
+		return;
+
+	GLuint available = GL_TRUE;
+	if (!wait)
+		glGetQueryObjectuiv(sliceQueries[q], GL_QUERY_RESULT_AVAILABLE,
+				&available);
+	if (!available)
+		return;
+
+	GLuint64 ns = 0;
+	glGetQueryObjectui64v(sliceQueries[q], GL_QUERY_RESULT, &ns);
+	sliceUnitTime = ns * 1e-9 / sliceQueryRows[q] / sliceQueryCost[q];
+	sliceQueryRows[q] = 0;
+}
+
+// Times the work until endSliceQuery(), which tells how many rows it
+// was.
+void beginSliceQuery(void)
+{
+	if (sliceQueries[0] == 0)
+		glGenQueries(2, sliceQueries);
+
+	// This one is two redraws old, so it's hardly ever a wait.
+	int q = sliceQueryNext;
+	collectSliceQuery(q, true);
+	sliceQueryCost[q] = sliceRowCost();
+	glBeginQuery(GL_TIME_ELAPSED, sliceQueries[q]);
+}
+
+void endSliceQuery(int rows)
+{
+	glEndQuery(GL_TIME_ELAPSED);
+	sliceQueryRows[sliceQueryNext] = rows;
+	sliceQueryNext = 1 - sliceQueryNext;
+}
+
+bool renderSlices(void)
+{
+	int w = win.w();
+	int h = win.h();
+	if (sliceTargets[0].w() != w || sliceTargets[0].h() != h)
+	{
+		if (!sliceTargets[0].create(w, h) || !sliceTargets[1].create(w, h))
+			exit(EXIT_FAILURE);
+		sliceHaveFrame = false;
+		sliceRow = -1;
+	}
+
+	// Any change aborts the frame in progress.
+	std::vector<float> sig = frameSignature();
+	if (sliceRow < 0 || sig != sliceSignature)
+	{
+		sliceSignature = sig;
+		sliceRow = 0;
+		aaRefinedFrame = 0;
+	}
+
+	// Results of earlier redraws, if they're there.
+	collectSliceQuery(sliceQueryNext, false);
+	collectSliceQuery(1 - sliceQueryNext, false);
+
+	// With antialiasing, the first pass is done for all rows before the
+	// refinement can start.
+	Framebuffer &work = sliceTargets[sliceWork];
+	bool aa = (aaSamples > 0);
+	int total = (aa ? 2 * h : h);
+
+	beginSliceQuery();
+	if (usePrimary())
+		preparePrimary();
+	if (reproject && sliceRow == 0)
+		renderReprojection();
+	glEnable(GL_SCISSOR_TEST);
+
+	// Bands from top to bottom. Their height is chosen so that they fill
+	// the budget, based on how long rows took lately with the current
+	// settings. Before anything has been measured, one small band per
+	// redraw. The estimate can still be off for a redraw or two, e.g.
+	// while moving closer to the object.
+	double budget = sliceBudget / 1000.0;
+	double rowTime = sliceRowTime();
+	double planned = 0;
+	int done = 0;
+	do
+	{
+		int row = sliceRow % h;
+		int rows = h - row;
+		if (rowTime <= 0)
+			rows = std::min(rows, 8);
+		else if ((budget - planned) / rowTime < rows)
+			rows = std::max(1, (int)((budget - planned) / rowTime));
+
+		glScissor(0, h - row - rows, w, rows);
+		if (sliceRow >= h)
+			renderRefine(work.id());
+		else if (usePrimary())
+		{
+			renderPrimary();
+			if (!aa)
+				finishPrimary(work.id());
+		}
+		else
+		{
+			work.bind();
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			renderScene();
+		}
+
+		sliceRow += rows;
+		done += rows;
+		planned += rows * rowTime;
+	}
+	while (sliceRow < total && rowTime > 0 && planned < budget);
+
+	glDisable(GL_SCISSOR_TEST);
+	Framebuffer::unbind();
+	endSliceQuery(done);
+
+	bool complete = (sliceRow >= total);
+	if (complete)
+	{
+		primaryComplete();
+		sliceWork = 1 - sliceWork;
+		sliceHaveFrame = true;
+		sliceRow = -1;
+	}
+	updateIdle();
+
+	if (sliceHaveFrame)
+		sliceTargets[1 - sliceWork].blitTo(0);
+	else
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	return complete;
+}
+
+// Renders the whole view without and with shadows, into whatever is
+// bound. The frame itself is rendered afterwards. Lights from --lights
+// are looped over, even if they're tiled otherwise. The first draw may
+// compile the shader or bake volumes, so it is not counted.
+void reportShadows(void)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	int budget = shadowBudget;
+	double ms[3];
+	for (int i = 0; i < 3; i++)
+	{
+		shadowBudget = (i == 1 ? 0 : budget);
+		glFinish();
+		Clock::time_point start = Clock::now();
+		renderScene();
+		glFinish();
+		ms[i] = std::chrono::duration<double>(Clock::now() - start)
+			.count() * 1000;
+	}
+	shadowBudget = budget;
+
+	std::cout << "Shadows: " << ms[2] - ms[1] << " ms on top of " << ms[1]
+		<< " ms without (" << (int)(100 * (ms[2] - ms[1]) / ms[1] + 0.5)
+		<< "%), budget " << shadowBudget << "." << std::endl;
+}
+
+void display(void)
+{
+	if (pathFrame >= 0)
+	{
+		CameraKey &k = pathFrames[pathFrame];
+		win.setView(k.pos, k.ori, k.fov);
+	}
+
+	updateFrame();
+
+	if (shadowReport)
+	{
+		reportShadows();
+		shadowReport = false;
+	}
+
+	if (wavefrontReport)
+	{
+		wavefront.report(renderScene);
+		wavefrontReport = false;
+	}
+
+	bool complete = true;
+	if (offscreen || sliceBudget <= 0)
+	{
+		if (usePrimary())
+		{
+			GLint target;
+			glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+			preparePrimary();
+			if (reproject)
+				renderReprojection();
+			renderPrimary();
+			if (aaSamples > 0)
+				renderRefine(target);
+			else
+				finishPrimary(target);
+		}
+		else
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			renderScene();
+		}
+		primaryComplete();
+	}
+	else
+		complete = renderSlices();
+
+	if (complete)
+	{
+		aaRefined = aaRefinedFrame;
+		aaRefinedFrame = 0;
+		if (offscreen && aaSamples > 0)
+			tellAA();
+	}
+
+	// Capture the scene without the overlay.
+	if (complete)
+		capture.frameEnd(win.w(), win.h(), frameInfo());
+
+	if (!offscreen)
+	{
+		if (capture.pending() && !capturePolling)
+		{
+			capturePolling = true;
+			glutTimerFunc(50, pollCapture, 0);
+		}
 
-// 0 = change user settings with F1-F10, 1 = change light settings.
-static int settings_target = 0;
+		if (drawCS)
+			drawCoordinateSystem();
 
-char *readFile(const char *path)
+		glutSwapBuffers();
+	}
+
+	if (complete && pathFrame >= 0)
+	{
+		pathFrame++;
+		if (pathFrame >= (int)pathFrames.size())
+		{
+			pathFrame = -1;
+			updateIdle();
+			std::cout << "Camera path finished." << std::endl;
+		}
+	}
+}
+
+void startPath(void)
 {
-	char *databuf = NULL;
-	int length = 0;
+	if (pathFrames.empty())
+	{
+		std::cout << "No camera path loaded." << std::endl;
+		return;
+	}
 
-	std::ifstream instream;
-	instream.open(path, std::ios::binary);
-	if (!instream.is_open())
-		return NULL;
+	pathFrame = 0;
+	updateIdle();
+	std::cout << "Playing camera path, " << pathFrames.size()
+		<< " frames." << std::endl;
+}
 
-	// Get length of file.
-	instream.seekg(0, std::ios::end);
-	length = instream.tellg();
-	instream.seekg(0, std::ios::beg);
+void setProjection(double r)
+{
+	planeRect[0] = -r;
+	planeRect[1] = -1;
+	planeRect[2] = r;
+	planeRect[3] = 1;
+	planeRatio = r;
+}
 
-	// Allocate memory.
-	databuf = new char[length + 1];
+void reshape(int w, int h)
+{
+	glClearColor(0, 0, 0, 1);
+	glViewport(0, 0, w, h);
 
-	// Read data as a block.
-	instream.read(databuf, length);
-	instream.close();
+	win.setSize(w, h);
+	setProjection(win.ratio());
+}
 
-	// Add NULL terminator.
-	databuf[length] = 0;
+void bindDefaultTarget(void)
+{
+	if (offscreen)
+		offscreenTarget.bind();
+	else
+		Framebuffer::unbind();
+}
 
-	return databuf;
+void readPixels(Image& img, int x, int y)
+{
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(x, y, img.w(), img.h(), GL_RGB, GL_UNSIGNED_BYTE,
+			img.data());
+	img.flipVertically();
 }
 
-void showLog(GLuint shader, const char *which)
+void runSweep(void)
 {
-	std::cout << which << std::endl;
-	int len = 0;
-	glGetObjectParameterivARB(shader, GL_OBJECT_INFO_LOG_LENGTH_ARB,
-			&len);
-	// More than the NULL terminator?
-	if (len > 1)
+	int n = sweep.variants();
+	int cols = sweep.columns();
+	int rows = sweep.rows();
+	int cw = (sweepFull ? win.w() : sweepThumbW);
+	int ch = (sweepFull ? win.h() : sweepThumbH);
+
+	std::cout << "Sweep: " << n << " variants, " << cols << "x" << rows
+		<< " sheet." << std::endl;
+
+	float saved[2][4];
+	memcpy(saved, user_params, sizeof saved);
+
+	// All variants share the one program that has already been
+	// compiled. Only the frame block changes between them.
+	Image sheet(cols * sweepThumbW, rows * sweepThumbH);
+	Framebuffer fb;
+	if (sweepFull)
 	{
-		char *log = new char[len];
-		int dummy = 0;
-		glGetInfoLogARB(shader, len, &dummy, log);
-		std::cout << log << std::endl;
-		delete[] log;
+		if (!fb.create(cw, ch))
+			exit(EXIT_FAILURE);
+
+		// Frames are written by a helper thread while the GPU works on
+		// the next one.
+		std::thread writer;
+		Image frame(cw, ch);
+		Image pending;
+
+		for (int i = 0; i < n; i++)
+		{
+			sweep.apply(i, user_params);
+
+			fb.bind();
+			setProjection(cw / (double)ch);
+			updateFrame();
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			renderScene();
+			readPixels(frame, 0, 0);
+
+			Image thumb = frame.scaled(sweepThumbW, sweepThumbH);
+			sheet.blit(thumb, (i % cols) * sweepThumbW,
+					(i / cols) * sweepThumbH);
+
+			if (writer.joinable())
+				writer.join();
+			pending = frame;
+			writer = std::thread([i, &pending]()
+			{
+				char name[1024];
+				snprintf(name, sizeof name, "%s_%04d.ppm", sweepPrefix, i);
+				pending.save(name);
+			});
+		}
+
+		if (writer.joinable())
+			writer.join();
 	}
 	else
 	{
-		std::cout << "Okay, error log empty." << std::endl;
+		// Thumbnails are rendered side by side into one big target and
+		// read back at once. No synchronization between variants.
+		if (!fb.create(cols * cw, rows * ch))
+			exit(EXIT_FAILURE);
+
+		fb.bind();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		setProjection(cw / (double)ch);
+
+		for (int i = 0; i < n; i++)
+		{
+			sweep.apply(i, user_params);
+			updateFrame();
+
+			// Row 0 is at the top of the sheet.
+			glViewport((i % cols) * cw, (rows - 1 - i / cols) * ch, cw, ch);
+			renderScene();
+		}
+
+		readPixels(sheet, 0, 0);
 	}
-	std::cout << std::endl;
+
+	bindDefaultTarget();
+	memcpy(user_params, saved, sizeof saved);
+	reshape(win.w(), win.h());
+
+	std::string sheetName = std::string(sweepPrefix) + ".ppm";
+	std::string indexName = std::string(sweepPrefix) + ".txt";
+	sheet.save(sheetName.c_str());
+
+	std::ofstream index(indexName.c_str());
+	index << "# " << sheetName << ": " << cols << " columns, " << rows
+		<< " rows, cells of " << sweepThumbW << "x" << sweepThumbH
+		<< std::endl;
+	index << "# index row column user_params0 user_params1" << std::endl;
+	for (int i = 0; i < n; i++)
+	{
+		float p[2][4];
+		memcpy(p, saved, sizeof p);
+		sweep.apply(i, p);
+
+		index << i << " " << i / cols << " " << i % cols;
+		for (int v = 0; v < 2; v++)
+			for (int c = 0; c < 4; c++)
+				index << " " << p[v][c];
+		index << "  # " << sweep.describe(i) << std::endl;
+	}
+
+	std::cout << "Wrote " << sheetName << " and " << indexName << "."
+		<< std::endl;
 }
 
-void loadShaders(void)
+void runPoster(void)
 {
-	const char *vs_source = readFile("shader_vertex.glsl");
-	const char *fs_source = readFile("shader_fragment_final.glsl");
-	shader = 0;
-	GLuint shader_handle = 0;
+	int tile = posterTile;
+	int cols = (posterW + tile - 1) / tile;
+	int rows = (posterH + tile - 1) / tile;
+	double r = posterW / (double)posterH;
 
-	if (vs_source == NULL || fs_source == NULL)
-	{
-		fprintf(stderr, "Could not load shaders.\n");
+	MappedPPM out;
+	if (!out.create(posterPath, posterW, posterH))
+		exit(EXIT_FAILURE);
+
+	Framebuffer fb;
+	if (!fb.create(tile, tile))
 		exit(EXIT_FAILURE);
+	fb.bind();
+
+	std::cout << "Poster: " << posterW << "x" << posterH << ", " << cols
+		<< "x" << rows << " tiles of " << tile << "x" << tile << "."
+		<< std::endl;
+
+	Image part;
+	for (int ty = 0; ty < rows; ty++)
+	{
+		int y = ty * tile;
+		int th = (y + tile <= posterH ? tile : posterH - y);
+
+		for (int tx = 0; tx < cols; tx++)
+		{
+			int x = tx * tile;
+			int tw = (x + tile <= posterW ? tile : posterW - x);
+
+			// The quad still spans the whole viewing plane. Only the
+			// part that belongs to this tile ends up in the viewport,
+			// so each fragment gets the very same ray as in one huge
+			// image.
+			glViewport(0, 0, tw, th);
+			planeRect[0] = -r + 2 * r * x / posterW;
+			planeRect[1] = 1 - 2.0 * (y + th) / posterH;
+			planeRect[2] = -r + 2 * r * (x + tw) / posterW;
+			planeRect[3] = 1 - 2.0 * y / posterH;
+			planeRatio = r;
+			updateFrame();
+
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			renderScene();
+
+			// One tile at a time: A single draw call never takes long
+			// enough to trigger the driver's watchdog.
+			part.resize(tw, th);
+			readPixels(part, 0, 0);
+			out.blit(part, x, y);
+		}
+
+		out.release(y, y + th);
+		std::cout << "Poster: Row " << (ty + 1) << " of " << rows
+			<< " done." << std::endl;
 	}
 
-	shader = glCreateProgram();
+	out.close();
+	bindDefaultTarget();
+	reshape(win.w(), win.h());
 
-	shader_handle = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(shader_handle, 1, &vs_source, NULL);
-	glCompileShader(shader_handle);
-	showLog(shader_handle, "Vertex shader:");
-	glAttachShader(shader, shader_handle);
+	std::cout << "Wrote `" << posterPath << "'." << std::endl;
+}
 
-	shader_handle = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(shader_handle, 1, &fs_source, NULL);
-	glCompileShader(shader_handle);
-	showLog(shader_handle, "Fragment shader:");
-	glAttachShader(shader, shader_handle);
+void meshBlocks(SurfaceNets &nets, std::vector<unsigned char> &blocks,
+		std::vector<int> &blockOf)
+{
+	// The occupancy grid of ray/marching_occupancy.glsl tells which
+	// blocks of samples can be left out. Blocks next to occupied ones
+	// are needed as well: Their samples are corners of crossed cells.
+	if (occupancy.program == 0)
+		buildBakeShader(occupancy, "shader_occupancy_final.glsl");
+	bakeVolume(occupancy);
+
+	int b = occupancy.res;
+	std::vector<unsigned char> occupied(b * b * b);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glBindTexture(GL_TEXTURE_3D, occupancy.texture);
+	glGetTexImage(GL_TEXTURE_3D, 0, GL_RED, GL_UNSIGNED_BYTE,
+			occupied.data());
+	glBindTexture(GL_TEXTURE_3D, 0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	int used = 0;
+	blocks.assign(b * b * b, 0);
+	for (int z = 0; z < b; z++)
+		for (int y = 0; y < b; y++)
+			for (int x = 0; x < b; x++)
+			{
+				bool near = false;
+				for (int dz = std::max(z - 1, 0); dz <= std::min(z + 1, b - 1);
+						dz++)
+					for (int dy = std::max(y - 1, 0);
+							dy <= std::min(y + 1, b - 1); dy++)
+						for (int dx = std::max(x - 1, 0);
+								dx <= std::min(x + 1, b - 1); dx++)
+							near = near || occupied[(dz * b + dy) * b + dx];
+
+				blocks[(z * b + y) * b + x] = near;
+				used += near;
+			}
 
-	glLinkProgram(shader);
+	// Samples are at texel centers, just like in the occupancy grid.
+	blockOf.resize(meshRes);
+	for (int i = 0; i < meshRes; i++)
+		blockOf[i] = std::min((int)((i + 0.5) / meshRes * b), b - 1);
 
-	handle_rot = glGetUniformLocation(shader, "rot");
-	handle_pos = glGetUniformLocation(shader, "pos");
-	handle_eyedist = glGetUniformLocation(shader, "eyedist");
-	handle_stepsize = glGetUniformLocation(shader, "stepsize");
-	handle_accuracy = glGetUniformLocation(shader, "accuracy");
-	handle_user_params0 = glGetUniformLocation(shader, "user_params0");
-	handle_user_params1 = glGetUniformLocation(shader, "user_params1");
+	nets.setBlocks(blocks, b, blockOf);
+	std::cout << "Mesh: " << used << " of " << b * b * b
+		<< " blocks are close to the surface." << std::endl;
 }
 
-void display(void)
+void runMesh(void)
 {
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
 
-	glUseProgram(shader);
+	int n = meshRes;
+	float h = 2 * bakeBox / n;
+	float first[3] = { -bakeBox + h / 2, -bakeBox + h / 2, -bakeBox + h / 2 };
 
-	// Enable light sources.
-	glEnable(GL_LIGHTING);
-	if (lights_enabled[0])
-	{
-		// Abuse GL_SPOT_CUTOFF as a switch to toggle the light.
-		glEnable(GL_LIGHT0);
-		glLightf(GL_LIGHT0, GL_SPOT_CUTOFF, 1.0f);
-		glLightfv(GL_LIGHT0, GL_POSITION, lights[0]);
-		glLightfv(GL_LIGHT0, GL_DIFFUSE,  lights_diffuse[0]);
-		glLightfv(GL_LIGHT0, GL_SPECULAR, lights_specular[0]);
-	}
-	else
-		glLightf(GL_LIGHT0, GL_SPOT_CUTOFF, 0.0f);
+	MeshWriter out;
+	if (!out.open(meshPath))
+		exit(EXIT_FAILURE);
+	SurfaceNets nets(n, first, h, out);
 
-	if (lights_enabled[1])
-	{
-		glEnable(GL_LIGHT1);
-		glLightf(GL_LIGHT1, GL_SPOT_CUTOFF, 1.0f);
-		glLightfv(GL_LIGHT1, GL_POSITION, lights[1]);
-		glLightfv(GL_LIGHT1, GL_DIFFUSE,  lights_diffuse[1]);
-		glLightfv(GL_LIGHT1, GL_SPECULAR, lights_specular[1]);
-	}
-	else
-		glLightf(GL_LIGHT1, GL_SPOT_CUTOFF, 0.0f);
+	// The user settings for baking, nothing else is drawn.
+	updateFrame();
 
-	// Copy the orientation matrix to a float array. That's needed so we
-	// can pass it to the shaders.
-	float oriMatrix[16];
-	Mat4 T = win.orientationMatrix();
-	for (int i = 0; i < 16; i++)
-		oriMatrix[i] = T[i];
-
-	// Same for position of the camera.
-	float fpos[3];
-	fpos[0] = win.pos().x();
-	fpos[1] = win.pos().y();
-	fpos[2] = win.pos().z();
-
-	glUniformMatrix4fv(handle_rot, 1, true, oriMatrix);
-	glUniform3fv(handle_pos, 1, fpos);
-	glUniform1f(handle_eyedist, win.eyedist());
-	glUniform1f(handle_stepsize, raymarching_stepsize);
-	glUniform1f(handle_accuracy, raymarching_accuracy);
-	glUniform4fv(handle_user_params0, 1, user_params[0]);
-	glUniform4fv(handle_user_params1, 1, user_params[1]);
+	std::vector<unsigned char> blocks;
+	std::vector<int> blockOf;
+	if (meshFast)
+		meshBlocks(nets, blocks, blockOf);
 
-	// Draw one quad so that we get one fragment covering the whole
-	// screen.
-	double r = win.ratio();
-	glBegin(GL_QUADS);
-	glVertex3f(-r, -1,  0);
-	glVertex3f( r, -1,  0);
-	glVertex3f( r,  1,  0);
-	glVertex3f(-r,  1,  0);
-	glEnd();
+	if (bakedField.program == 0)
+		buildBakeShader(bakedField, "shader_bake_final.glsl");
 
-	// Draw coordinate system?
-	if (drawCS)
+	// Plain values, no clamping.
+	Framebuffer fb;
+	if (!fb.create(n, n, GL_R32F))
+		exit(EXIT_FAILURE);
+	fb.bind();
+	glViewport(0, 0, n, n);
+	glDisable(GL_SCISSOR_TEST);
+
+	BakedVolume &v = bakedField;
+	glUseProgram(v.program);
+	glUniform3f(v.handle_min, -bakeBox, -bakeBox, -bakeBox);
+	glUniform3f(v.handle_size, 2 * bakeBox, 2 * bakeBox, 2 * bakeBox);
+	glUniform2f(v.handle_res, n, n);
+	glUniform1f(v.handle_band, 1e30);
+
+	// Samples that are not drawn are outside.
+	glClearColor(1, 1, 1, 1);
+
+	// Enough layers to keep all threads busy.
+	int batch = std::max(4, 2 * parallelThreads());
+	std::vector<std::vector<float> > planes(batch + 1,
+			std::vector<float>((size_t)n * n));
+	std::vector<const float *> pointers(batch + 1);
+	for (int i = 0; i <= batch; i++)
+		pointers[i] = planes[i].data();
+
+	std::cout << "Mesh: " << n << "^3 samples in [" << -bakeBox << ", "
+		<< bakeBox << "]^3." << std::endl;
+
+	std::vector<float> runs;
+	int have = 0;
+	for (int z0 = 0; z0 < n - 1; z0 += batch)
 	{
-		glUseProgram(0);
-		glDisable(GL_LIGHTING);
-		glEnable(GL_DEPTH_TEST);
-		glPushMatrix();
+		int count = std::min(batch, n - 1 - z0);
 
-		glLineWidth(3.0);
+		// The last plane of the previous batch is the first one now.
+		for (int i = have; i <= count; i++)
+		{
+			int z = z0 + i;
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glUniform1f(v.handle_slice, (z + 0.5) / n);
 
-		// In y direction, move to -0.75.
-		// In x direction, move to  0.75. From that point on, add the
-		// difference of width and height in world coordinates. This
-		// will keep the (drawn) coordinate system at a position with a
-		// fixed margin to the window borders.
-		glTranslated(0.75 + (win.w() - win.h()) / (double)win.h(),
-				-0.75, 0);
-		glScaled(0.2, 0.2, 0.2);
-		glMultMatrixf(oriMatrix);
+			if (!meshFast)
+				drawQuad();
+			else
+			{
+				// Runs of blocks along x, two triangles each.
+				runs.clear();
+				int b = occupancy.res;
+				int bz = blockOf[z];
+				for (int y = 0; y < n; y++)
+					for (int x = 0; x < n; x++)
+					{
+						if (!blocks[(bz * b + blockOf[y]) * b + blockOf[x]])
+							continue;
+
+						int x1 = x;
+						while (x1 < n && blocks[(bz * b + blockOf[y]) * b
+								+ blockOf[x1]])
+							x1++;
+
+						float left = 2.0f * x / n - 1;
+						float right = 2.0f * x1 / n - 1;
+						float bottom = 2.0f * y / n - 1;
+						float top = 2.0f * (y + 1) / n - 1;
+						float quad[] = { left, bottom, right, bottom, right, top,
+							left, bottom, right, top, left, top };
+						runs.insert(runs.end(), quad, quad + 12);
+						x = x1;
+					}
+
+				if (!runs.empty())
+					drawStream(GL_TRIANGLES, runs.data(), runs.size() / 2, 2);
+			}
 
-		glBegin(GL_LINES);
+			glReadPixels(0, 0, n, n, GL_RED, GL_FLOAT, planes[i].data());
+		}
 
-		glColor3f(1.0, 0.0, 0.0);
-		glVertex3f(0, 0, 0);
-		glVertex3f(1, 0, 0);
+		nets.mesh(z0, count, pointers.data());
 
-		glColor3f(0.0, 1.0, 0.0);
-		glVertex3f(0, 0, 0);
-		glVertex3f(0, 1, 0);
+		std::swap(planes[0], planes[count]);
+		pointers[0] = planes[0].data();
+		pointers[count] = planes[count].data();
+		have = 1;
 
-		glColor3f(0.0, 0.0, 1.0);
-		glVertex3f(0, 0, 0);
-		glVertex3f(0, 0, 1);
+		std::cout << "Mesh: Plane " << (z0 + count + 1) << " of " << n
+			<< " done." << std::endl;
+	}
 
-		glEnd();
+	glUseProgram(0);
+	glClearColor(0, 0, 0, 1);
+	fb.destroy();
+	bindDefaultTarget();
+	reshape(win.w(), win.h());
 
-		glPopMatrix();
-		glDisable(GL_DEPTH_TEST);
-	}
+	if (!out.close())
+		exit(EXIT_FAILURE);
 
-	glutSwapBuffers();
+	std::cout << "Wrote `" << meshPath << "', " << out.vertices()
+		<< " vertices and " << out.faces() << " quads in "
+		<< std::chrono::duration<double>(Clock::now() - start).count()
+		<< " s." << std::endl;
 }
 
-void reshape(int w, int h)
+void runOffscreen(void)
 {
-	glClearColor(0, 0, 0, 1);
-	glViewport(0, 0, w, h);
-
-	win.setSize(w, h);
-
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	glOrtho(-win.ratio(), win.ratio(), -1, 1, -1, 1);
+	// Play the path if there is one. Otherwise, render a single frame
+	// and save it like a screenshot.
+	if (pathFrames.empty())
+	{
+		capture.requestOnce(imageSaver);
+		display();
+	}
+	else
+	{
+		startPath();
+		while (pathFrame >= 0)
+			display();
+	}
 
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
+	glFinish();
+	capture.flush();
 }
 
 void tellUserParams(void)
@@ -465,10 +3017,60 @@ void keyboard(unsigned char key, int x, int y)
 			lights_enabled[1] = !lights_enabled[1];
 			break;
 
+		case '3':
+			shadowLights[0] = !shadowLights[0];
+			break;
+
+		case '4':
+			shadowLights[1] = !shadowLights[1];
+			break;
+
+		case 'y':
+			shadowReport = true;
+			break;
+
 		case 'c':
 			drawCS = !drawCS;
 			break;
 
+		case 'o':
+			startPath();
+			break;
+
+		case 'p':
+			capture.requestOnce(imageSaver);
+			break;
+
+		case 'P':
+			setCaptureContinuous(!captureContinuous);
+			break;
+
+		case 'V':
+			setVideoRecording(!videoRecording);
+			break;
+
+		case 'x':
+			aaSamples = (aaSamples > 0 ? 0 : aaBudget);
+			tellAA();
+			break;
+
+		case 'X':
+			tellAA();
+			changed = false;
+			break;
+
+		case 'j':
+			reproject = !reproject;
+			std::cout << "Temporal reprojection "
+				<< (reproject ? "enabled." : "disabled.") << std::endl;
+			break;
+
+		case 'b':
+			proxy = !proxy;
+			std::cout << "Proxy geometry "
+				<< (proxy ? "enabled." : "disabled.") << std::endl;
+			break;
+
 		case 'm':
 			mouseLook = !mouseLook;
 			if (mouseLook)
@@ -741,32 +3343,451 @@ void loadDefaultUserSettings(void)
 	delete[] data;
 }
 
+void usage(const char *argv0)
+{
+	std::cerr << "Usage: " << argv0 << " [options]" << std::endl
+		<< std::endl
+		<< "  --path FILE     Load camera keyframes (as printed by [Space])"
+		<< std::endl
+		<< "  --frames N      Number of frames along the path (default "
+		<< pathFrameCount << ")" << std::endl
+		<< "  --dump-path     Print all frames of the path and exit"
+		<< std::endl
+		<< "  --sweep SPEC    Sweep a user parameter, e.g. u0.x=-1:1:5 or"
+		<< std::endl
+		<< "                  u1.s=4,6,8 (repeat for more dimensions)"
+		<< std::endl
+		<< "  --thumb WxH     Cell size on the contact sheet" << std::endl
+		<< "  --sweep-full    Also write every variant at window size"
+		<< std::endl
+		<< "  --sweep-out P   Prefix of the output files (default sweep)"
+		<< std::endl
+		<< "  --capture       Start with continuous capture enabled"
+		<< std::endl
+		<< "  --capture-format png|ppm|exr" << std::endl
+		<< "  --capture-prefix P  Prefix of captured files (default "
+		<< "capture)" << std::endl
+		<< "  --video FILE    Record a Y4M video from the start, `-' is stdout"
+		<< std::endl
+		<< "  --video-fps N   Frame rate written to the stream (default "
+		<< videoFps << ")" << std::endl
+		<< "  --shm NAME      Export frames to POSIX shared memory"
+		<< std::endl
+		<< "  --shm-slots N   Frames in the ring (default " << sharedSlots
+		<< ")" << std::endl
+		<< "  --shm-max WxH   Largest frame size (default " << sharedMaxW
+		<< "x" << sharedMaxH << ")" << std::endl
+		<< "  --poster WxH    Render one large still tile by tile and exit"
+		<< std::endl
+		<< "  --tile N        Tile size for --poster (default " << posterTile
+		<< ")" << std::endl
+		<< "  --poster-out F  Output file (default poster.ppm)" << std::endl
+		<< "  --mesh FILE     Write a mesh of the object (.ply or .obj) and exit"
+		<< std::endl
+		<< "  --mesh-res N    Samples per axis for --mesh (default " << meshRes
+		<< ")" << std::endl
+		<< "  --mesh-fast     Leave out empty blocks, see --occupancy"
+		<< std::endl
+		<< "  --model FILE    Triangles (.ply or .obj) for objects/d_mesh.glsl"
+		<< std::endl
+		<< "  --model-fit S   Center the model and scale it to size S"
+		<< std::endl
+		<< "  --instances FILE  Spheres, boxes and capsules for"
+		<< " objects/d_instances.glsl" << std::endl
+		<< "                    and objects/m_blobs.glsl" << std::endl
+		<< "  --instances-chunk N  Lines to read at once (default "
+		<< instancesChunk << ")" << std::endl
+		<< "  --lights FILE   More point, spot and directional lights"
+		<< std::endl
+		<< "  --light-tile N  Cull lights in tiles of NxN pixels, 0 = off"
+		<< " (default " << lightTile << ")" << std::endl
+		<< "  --shadows N     Evaluations per shadow ray, 0 = off (default "
+		<< shadowBudget << ")" << std::endl
+		<< "  --shadow-step F  Smallest step of shadow rays, times the step"
+		<< " size (" << shadowStep << ")" << std::endl
+		<< "  --shadow-soft K  Sharpness of soft shadows (default "
+		<< shadowSoft << ")" << std::endl
+		<< "  --shadow-cost   Print what shadows cost in the first frame ([y])"
+		<< std::endl
+		<< "  --aa N          Adaptive antialiasing with N extra rays per edge"
+		<< std::endl
+		<< "                  pixel ([x] toggles, default " << aaBudget << ")"
+		<< std::endl
+		<< "  --aa-depth F    Relative depth step that counts as an edge ("
+		<< aaDepth << ")" << std::endl
+		<< "  --aa-normal F   Smallest cosine between normals that does not"
+		<< std::endl
+		<< "                  count as an edge (" << aaNormal << ")"
+		<< std::endl
+		<< "  --reproject     Start rays near the hits of the last frame ([j])"
+		<< std::endl
+		<< "  --reproject-margin F  Start this fraction of the distance in"
+		<< std::endl
+		<< "                  front of the reprojected hit (default "
+		<< reprojectMargin << ")" << std::endl
+		<< "  --proxy         Only trace rays that hit the box around the"
+		<< " object ([b])" << std::endl
+		<< "  --wavefront N   March like ray/marching.glsl in a compute"
+		<< " shader, N steps" << std::endl
+		<< "                  per dispatch, 0 = off (default "
+		<< wavefront.steps() << ")" << std::endl
+		<< "  --wavefront-cost  Compare it to fragments in the first frame"
+		<< std::endl
+		<< "  --cpu N         March objects/m_mandelbulb.glsl on the CPU,"
+		<< " compacting rays" << std::endl
+		<< "                  every N iterations, 0 = off (default "
+		<< cpuSteps << ")" << std::endl
+		<< "  --cpu-stats     Print how busy its lanes are in each frame"
+		<< std::endl
+		<< "  --cpu-verify    Compare it to a scalar marcher in each frame"
+		<< std::endl
+		<< "  --bake N        Resolution of the field for ray/baked.glsl (default "
+		<< bakedField.res << ")" << std::endl
+		<< "  --bake-box R    The object is inside [-R, R]^3 (default "
+		<< bakeBox << ")" << std::endl
+		<< "  --bake-band F   Use evalAt() where the field is below F (default "
+		<< bakedField.band << ")" << std::endl
+		<< "  --bake-cache DIR  Keep baked fields in this directory" << std::endl
+		<< "  --occupancy N   Cells per axis for ray/marching_occupancy.glsl"
+		<< " (default " << occupancy.res << ")" << std::endl
+		<< "  --occupancy-band F  Cells are empty where evalAt() is at least F"
+		<< " (default " << occupancy.band << ")" << std::endl
+		<< "  --slice MS      Time per redraw for expensive frames, 0 to"
+		<< std::endl
+		<< "                  always draw whole frames (default "
+		<< sliceBudget << ")" << std::endl
+		<< "  --offscreen     Render without a window, then exit" << std::endl
+		<< "  --size WxH      Size of the window or offscreen image"
+		<< std::endl;
+	exit(EXIT_FAILURE);
+}
+
+void parseArguments(int argc, char **argv)
+{
+	const char *pathFile = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = (i + 1 < argc);
+
+		if (strcmp(argv[i], "--path") == 0 && hasValue)
+			pathFile = argv[++i];
+		else if (strcmp(argv[i], "--frames") == 0 && hasValue)
+			pathFrameCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--dump-path") == 0)
+			pathDump = true;
+		else if (strcmp(argv[i], "--sweep") == 0 && hasValue)
+		{
+			if (!sweep.addDimension(argv[++i]))
+			{
+				std::cerr << "Invalid sweep: `" << argv[i] << "'."
+					<< std::endl;
+				usage(argv[0]);
+			}
+		}
+		else if (strcmp(argv[i], "--thumb") == 0 && hasValue)
+		{
+			if (sscanf(argv[++i], "%dx%d", &sweepThumbW, &sweepThumbH) != 2)
+				usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--sweep-full") == 0)
+			sweepFull = true;
+		else if (strcmp(argv[i], "--sweep-out") == 0 && hasValue)
+			sweepPrefix = argv[++i];
+		else if (strcmp(argv[i], "--capture") == 0)
+			captureContinuous = true;
+		else if (strcmp(argv[i], "--capture-format") == 0 && hasValue)
+		{
+			captureFormat = argv[++i];
+			if (strcmp(captureFormat, "png") != 0
+					&& strcmp(captureFormat, "ppm") != 0
+					&& strcmp(captureFormat, "exr") != 0)
+				usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--capture-prefix") == 0 && hasValue)
+			capturePrefix = argv[++i];
+		else if (strcmp(argv[i], "--video") == 0 && hasValue)
+		{
+			videoPath = argv[++i];
+
+			// stdout belongs to the video. Right away, so that the
+			// messages of the GL setup go to stderr as well.
+			if (strcmp(videoPath, "-") == 0)
+				std::cout.rdbuf(std::cerr.rdbuf());
+		}
+		else if (strcmp(argv[i], "--video-fps") == 0 && hasValue)
+			videoFps = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--shm") == 0 && hasValue)
+			sharedName = argv[++i];
+		else if (strcmp(argv[i], "--shm-slots") == 0 && hasValue)
+		{
+			sharedSlots = atoi(argv[++i]);
+			if (sharedSlots < 1)
+				usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--shm-max") == 0 && hasValue)
+		{
+			if (sscanf(argv[++i], "%dx%d", &sharedMaxW, &sharedMaxH) != 2
+					|| sharedMaxW < 1 || sharedMaxH < 1)
+				usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--poster") == 0 && hasValue)
+		{
+			if (sscanf(argv[++i], "%dx%d", &posterW, &posterH) != 2
+					|| posterW < 1 || posterH < 1)
+				usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--tile") == 0 && hasValue)
+		{
+			posterTile = atoi(argv[++i]);
+			if (posterTile < 1)
+				usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--poster-out") == 0 && hasValue)
+			posterPath = argv[++i];
+		else if (strcmp(argv[i], "--mesh") == 0 && hasValue)
+			meshPath = argv[++i];
+		else if (strcmp(argv[i], "--mesh-res") == 0 && hasValue)
+		{
+			meshRes = atoi(argv[++i]);
+			if (meshRes < 2)
+				usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--mesh-fast") == 0)
+			meshFast = true;
+		else if (strcmp(argv[i], "--model") == 0 && hasValue)
+			modelPath = argv[++i];
+		else if (strcmp(argv[i], "--model-fit") == 0 && hasValue)
+			modelFit = atof(argv[++i]);
+		else if (strcmp(argv[i], "--instances") == 0 && hasValue)
+			instancesPath = argv[++i];
+		else if (strcmp(argv[i], "--instances-chunk") == 0 && hasValue)
+		{
+			instancesChunk = atoi(argv[++i]);
+			if (instancesChunk < 1)
+				usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--lights") == 0 && hasValue)
+			lightsPath = argv[++i];
+		else if (strcmp(argv[i], "--light-tile") == 0 && hasValue)
+		{
+			lightTile = atoi(argv[++i]);
+			if (lightTile < 0)
+				usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--shadows") == 0 && hasValue)
+		{
+			shadowBudget = atoi(argv[++i]);
+			if (shadowBudget < 0)
+				usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--shadow-step") == 0 && hasValue)
+			shadowStep = atof(argv[++i]);
+		else if (strcmp(argv[i], "--shadow-soft") == 0 && hasValue)
+			shadowSoft = atof(argv[++i]);
+		else if (strcmp(argv[i], "--shadow-cost") == 0)
+			shadowReport = true;
+		else if (strcmp(argv[i], "--aa") == 0 && hasValue)
+		{
+			aaSamples = atoi(argv[++i]);
+			if (aaSamples > 0)
+				aaBudget = aaSamples;
+		}
+		else if (strcmp(argv[i], "--aa-depth") == 0 && hasValue)
+			aaDepth = atof(argv[++i]);
+		else if (strcmp(argv[i], "--aa-normal") == 0 && hasValue)
+			aaNormal = atof(argv[++i]);
+		else if (strcmp(argv[i], "--reproject") == 0)
+			reproject = true;
+		else if (strcmp(argv[i], "--reproject-margin") == 0 && hasValue)
+			reprojectMargin = atof(argv[++i]);
+		else if (strcmp(argv[i], "--proxy") == 0)
+			proxy = true;
+		else if (strcmp(argv[i], "--wavefront") == 0 && hasValue)
+		{
+			wavefront.setSteps(atoi(argv[++i]));
+			if (wavefront.steps() < 0)
+				usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--wavefront-cost") == 0)
+			wavefrontReport = true;
+		else if (strcmp(argv[i], "--cpu") == 0 && hasValue)
+		{
+			cpuSteps = atoi(argv[++i]);
+			if (cpuSteps < 0)
+				usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--cpu-stats") == 0)
+			cpuStats = true;
+		else if (strcmp(argv[i], "--cpu-verify") == 0)
+			cpuVerify = true;
+		else if (strcmp(argv[i], "--bake") == 0 && hasValue)
+		{
+			bakedField.res = atoi(argv[++i]);
+			if (bakedField.res < 2)
+				usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--bake-box") == 0 && hasValue)
+			bakeBox = atof(argv[++i]);
+		else if (strcmp(argv[i], "--bake-band") == 0 && hasValue)
+			bakedField.band = atof(argv[++i]);
+		else if (strcmp(argv[i], "--bake-cache") == 0 && hasValue)
+			bakeCacheDir = argv[++i];
+		else if (strcmp(argv[i], "--occupancy") == 0 && hasValue)
+		{
+			occupancy.res = atoi(argv[++i]);
+			if (occupancy.res < 1)
+				usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--occupancy-band") == 0 && hasValue)
+			occupancy.band = atof(argv[++i]);
+		else if (strcmp(argv[i], "--slice") == 0 && hasValue)
+			sliceBudget = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--offscreen") == 0)
+			offscreen = true;
+		else if (strcmp(argv[i], "--size") == 0 && hasValue)
+		{
+			int w, h;
+			if (sscanf(argv[++i], "%dx%d", &w, &h) != 2 || w < 1 || h < 1)
+				usage(argv[0]);
+			win.setSize(w, h);
+		}
+		else if (strncmp(argv[i], "--", 2) == 0)
+			usage(argv[0]);
+
+		// Everything else is left to glutInit().
+	}
+
+	if (pathFile != NULL)
+	{
+		if (!cameraPath.load(pathFile))
+		{
+			std::cerr << "Could not read camera path from `"
+				<< pathFile << "'." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		pathFrames = cameraPath.frames(pathFrameCount);
+		std::cout << "Camera path: " << cameraPath.keys() << " keys, "
+			<< "length " << cameraPath.length() << ", "
+			<< pathFrames.size() << " frames." << std::endl;
+
+		if (pathDump)
+		{
+			for (size_t i = 0; i < pathFrames.size(); i++)
+			{
+				win.setView(pathFrames[i].pos, pathFrames[i].ori,
+						pathFrames[i].fov);
+				std::cout << "# Frame " << i << std::endl;
+				win.dumpInfos();
+			}
+			exit(EXIT_SUCCESS);
+		}
+	}
+}
+
 int main(int argc, char **argv)
 {
 	win.setSize(640, 400);
 
-	glutInit(&argc, argv);
-	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH);
-	glutInitWindowSize(win.w(), win.h());
-	glutCreateWindow("GPU-Tracer");
+	parseArguments(argc, argv);
+
+	if (offscreen)
+	{
+		// GLUT is not touched at all, so no display is needed.
+		if (!offscreenContext.create()
+				|| !offscreenTarget.create(win.w(), win.h()))
+			exit(EXIT_FAILURE);
+
+		std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+		offscreenTarget.bind();
+		reshape(win.w(), win.h());
+	}
+	else
+	{
+		glutInit(&argc, argv);
+
+		// Core profile only, see createBuffers().
+		glutInitContextVersion(3, 2);
+		glutInitContextProfile(GLUT_CORE_PROFILE);
+		glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH);
+		glutInitWindowSize(win.w(), win.h());
+		glutCreateWindow("GPU-Tracer");
+
+		// Time slicing needs timer queries, which came with 3.3.
+		GLint major = 0;
+		GLint minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		if (sliceBudget > 0 && 10 * major + minor < 33)
+		{
+			std::cerr << "No timer queries, frames are always drawn whole."
+				<< std::endl;
+			sliceBudget = 0;
+		}
 
-	glutReshapeFunc(reshape);
-	glutDisplayFunc(display);
-	glutKeyboardFunc(keyboard);
-	glutSpecialFunc(keyboardSpecial);
-	glutMouseFunc(mouse);
-	glutMotionFunc(motion);
-	glutPassiveMotionFunc(motion);
+		glutReshapeFunc(reshape);
+		glutDisplayFunc(display);
+		glutKeyboardFunc(keyboard);
+		glutSpecialFunc(keyboardSpecial);
+		glutMouseFunc(mouse);
+		glutMotionFunc(motion);
+		glutPassiveMotionFunc(motion);
+	}
 
+	createBuffers();
 	loadShaders();
 	loadDefaultUserSettings();
 
+	capture.init();
+	imageSaver = new ImageSaver(capturePrefix, captureFormat);
+	imageSaver->setBlocking(offscreen);
+	atexit(shutdownCapture);
+	if (captureContinuous)
+		setCaptureContinuous(true);
+	if (videoPath != NULL)
+		setVideoRecording(true);
+	if (sharedName != NULL)
+	{
+		if (!sharedFrames.open(sharedName, sharedSlots, sharedMaxW,
+					sharedMaxH))
+			exit(EXIT_FAILURE);
+		capture.addSink(&sharedFrames);
+	}
+
 	// We don't start at (0, 0, 0). Most objects are centered at that
 	// position so we push the cam a little bit. This also sets the
 	// initial moving step.
 	win.setInitialConfig(Vec3(0, 0, 2.5), 0.02, 60.0);
 	win.reset();
 
+	if (!sweep.empty())
+	{
+		runSweep();
+		exit(EXIT_SUCCESS);
+	}
+
+	if (posterW > 0)
+	{
+		runPoster();
+		exit(EXIT_SUCCESS);
+	}
+
+	if (meshPath != NULL)
+	{
+		runMesh();
+		exit(EXIT_SUCCESS);
+	}
+
+	if (offscreen)
+	{
+		runOffscreen();
+		exit(EXIT_SUCCESS);
+	}
+
+	if (!pathFrames.empty())
+		startPath();
+
 	glutMainLoop();
 	exit(EXIT_SUCCESS);
 }
@@ -0,0 +1,417 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cstdio>
+#include <cstring>
+#include <strings.h>
+#include <iostream>
+#include <fcntl.h>
+#include <png.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "Image.hpp"
+
+
+Image::Image()
+{
+	_w = 0;
+	_h = 0;
+}
+
+Image::Image(int w, int h)
+{
+	resize(w, h);
+}
+
+void Image::resize(int w, int h)
+{
+	_w = w;
+	_h = h;
+	_data.assign((size_t)w * h * 3, 0);
+}
+
+int Image::w()
+{
+	return _w;
+}
+
+int Image::h()
+{
+	return _h;
+}
+
+unsigned char *Image::data()
+{
+	return &_data[0];
+}
+
+unsigned char *Image::row(int y)
+{
+	return &_data[(size_t)y * _w * 3];
+}
+
+void Image::flipVertically()
+{
+	std::vector<unsigned char> tmp(_w * 3);
+	for (int y = 0; y < _h / 2; y++)
+	{
+		unsigned char *a = row(y);
+		unsigned char *b = row(_h - 1 - y);
+		memcpy(&tmp[0], a, _w * 3);
+		memcpy(a, b, _w * 3);
+		memcpy(b, &tmp[0], _w * 3);
+	}
+}
+
+void Image::fromRGBA(const unsigned char *rgba, int w, int h)
+{
+	if (w != _w || h != _h)
+		resize(w, h);
+
+	for (int y = 0; y < h; y++)
+	{
+		const unsigned char *src = rgba + (size_t)(h - 1 - y) * w * 4;
+		unsigned char *dst = row(y);
+		for (int x = 0; x < w; x++)
+		{
+			dst[x * 3 + 0] = src[x * 4 + 0];
+			dst[x * 3 + 1] = src[x * 4 + 1];
+			dst[x * 3 + 2] = src[x * 4 + 2];
+		}
+	}
+}
+
+void Image::blit(Image& src, int x, int y)
+{
+	for (int sy = 0; sy < src.h(); sy++)
+	{
+		int ty = y + sy;
+		if (ty < 0 || ty >= _h)
+			continue;
+
+		int from = (x < 0 ? -x : 0);
+		int to = (x + src.w() > _w ? _w - x : src.w());
+		if (to <= from)
+			continue;
+
+		memcpy(row(ty) + (x + from) * 3, src.row(sy) + from * 3,
+				(to - from) * 3);
+	}
+}
+
+Image Image::scaled(int w, int h)
+{
+	Image out(w, h);
+	for (int y = 0; y < h; y++)
+	{
+		int y0 = y * _h / h;
+		int y1 = (y + 1) * _h / h;
+		if (y1 <= y0)
+			y1 = y0 + 1;
+
+		for (int x = 0; x < w; x++)
+		{
+			int x0 = x * _w / w;
+			int x1 = (x + 1) * _w / w;
+			if (x1 <= x0)
+				x1 = x0 + 1;
+
+			for (int c = 0; c < 3; c++)
+			{
+				int sum = 0;
+				for (int sy = y0; sy < y1; sy++)
+					for (int sx = x0; sx < x1; sx++)
+						sum += row(sy)[sx * 3 + c];
+				out.row(y)[x * 3 + c] = sum / ((y1 - y0) * (x1 - x0));
+			}
+		}
+	}
+	return out;
+}
+
+bool Image::save(const char *path)
+{
+	const char *ext = strrchr(path, '.');
+	if (ext != NULL && strcasecmp(ext, ".png") == 0)
+		return savePNG(path);
+	if (ext != NULL && strcasecmp(ext, ".exr") == 0)
+		return saveEXR(path);
+	return savePPM(path);
+}
+
+bool Image::savePPM(const char *path)
+{
+	FILE *fp = fopen(path, "wb");
+	if (fp == NULL)
+	{
+		std::cerr << "Could not write `" << path << "'." << std::endl;
+		return false;
+	}
+
+	fprintf(fp, "P6\n%d %d\n255\n", _w, _h);
+	size_t len = _data.size();
+	bool ok = (fwrite(&_data[0], 1, len, fp) == len);
+	fclose(fp);
+
+	return ok;
+}
+
+bool Image::savePNG(const char *path)
+{
+	FILE *fp = fopen(path, "wb");
+	if (fp == NULL)
+	{
+		std::cerr << "Could not write `" << path << "'." << std::endl;
+		return false;
+	}
+
+	png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+			NULL, NULL, NULL);
+	png_infop info = png_create_info_struct(png);
+	if (png == NULL || info == NULL || setjmp(png_jmpbuf(png)))
+	{
+		png_destroy_write_struct(&png, &info);
+		fclose(fp);
+		return false;
+	}
+
+	png_init_io(png, fp);
+
+	// Screenshots are written while rendering goes on. Fast compression
+	// keeps the writer from falling behind.
+	png_set_compression_level(png, 1);
+	png_set_IHDR(png, info, _w, _h, 8, PNG_COLOR_TYPE_RGB,
+			PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+			PNG_FILTER_TYPE_DEFAULT);
+	png_write_info(png, info);
+
+	for (int y = 0; y < _h; y++)
+		png_write_row(png, row(y));
+
+	png_write_end(png, NULL);
+	png_destroy_write_struct(&png, &info);
+	fclose(fp);
+
+	return true;
+}
+
+static unsigned short floatToHalf(float f)
+{
+	// Enough for values in [0, 1]: No infinities, no NaNs, denormals
+	// are flushed to zero.
+	unsigned int bits;
+	memcpy(&bits, &f, 4);
+
+	unsigned int sign = (bits >> 16) & 0x8000;
+	int exponent = ((bits >> 23) & 0xff) - 127 + 15;
+	unsigned int mantissa = bits & 0x7fffff;
+
+	if (exponent <= 0)
+		return sign;
+	if (exponent >= 31)
+		return sign | 0x7bff;
+
+	// Round to nearest.
+	mantissa += 0x1000;
+	if (mantissa & 0x800000)
+	{
+		mantissa = 0;
+		exponent++;
+	}
+
+	return sign | (exponent << 10) | (mantissa >> 13);
+}
+
+static void putAttribute(std::vector<unsigned char>& buf, const char *name,
+		const char *type, const void *data, int size)
+{
+	buf.insert(buf.end(), name, name + strlen(name) + 1);
+	buf.insert(buf.end(), type, type + strlen(type) + 1);
+	buf.insert(buf.end(), (unsigned char *)&size,
+			(unsigned char *)&size + 4);
+	buf.insert(buf.end(), (unsigned char *)data,
+			(unsigned char *)data + size);
+}
+
+bool Image::saveEXR(const char *path)
+{
+	// Uncompressed scanline OpenEXR with half float RGB channels. See
+	// "The OpenEXR File Layout" at http://www.openexr.com/ . All
+	// integers are little endian, just like this machine.
+	std::vector<unsigned char> header;
+	unsigned char magic[] = { 0x76, 0x2f, 0x31, 0x01, 2, 0, 0, 0 };
+	header.insert(header.end(), magic, magic + 8);
+
+	// Channels must be sorted by name.
+	std::vector<unsigned char> chlist;
+	const char *names[] = { "B", "G", "R" };
+	for (int c = 0; c < 3; c++)
+	{
+		int fields[4] = { 1, 0, 1, 1 };  // HALF, pLinear + reserved, 1, 1
+		chlist.push_back(names[c][0]);
+		chlist.push_back(0);
+		chlist.insert(chlist.end(), (unsigned char *)fields,
+				(unsigned char *)fields + 16);
+	}
+	chlist.push_back(0);
+	putAttribute(header, "channels", "chlist", &chlist[0], chlist.size());
+
+	unsigned char compression = 0;
+	putAttribute(header, "compression", "compression", &compression, 1);
+
+	int window[4] = { 0, 0, _w - 1, _h - 1 };
+	putAttribute(header, "dataWindow", "box2i", window, 16);
+	putAttribute(header, "displayWindow", "box2i", window, 16);
+
+	unsigned char lineOrder = 0;
+	putAttribute(header, "lineOrder", "lineOrder", &lineOrder, 1);
+
+	float aspect = 1;
+	putAttribute(header, "pixelAspectRatio", "float", &aspect, 4);
+
+	float center[2] = { 0, 0 };
+	putAttribute(header, "screenWindowCenter", "v2f", center, 8);
+
+	float width = 1;
+	putAttribute(header, "screenWindowWidth", "float", &width, 4);
+
+	header.push_back(0);
+
+	FILE *fp = fopen(path, "wb");
+	if (fp == NULL)
+	{
+		std::cerr << "Could not write `" << path << "'." << std::endl;
+		return false;
+	}
+
+	// Offset table: One block per scanline.
+	int lineSize = _w * 3 * 2;
+	unsigned long long offset = header.size() + (unsigned long long)_h * 8;
+	std::vector<unsigned long long> offsets(_h);
+	for (int y = 0; y < _h; y++)
+		offsets[y] = offset + (unsigned long long)y * (8 + lineSize);
+
+	bool ok = (fwrite(&header[0], 1, header.size(), fp) == header.size());
+	ok = ok && (fwrite(&offsets[0], 8, _h, fp) == (size_t)_h);
+
+	std::vector<unsigned short> line(_w * 3);
+	for (int y = 0; y < _h && ok; y++)
+	{
+		// Planar: All blue values, then green, then red.
+		unsigned char *src = row(y);
+		for (int c = 0; c < 3; c++)
+			for (int x = 0; x < _w; x++)
+				line[c * _w + x] = floatToHalf(src[x * 3 + 2 - c] / 255.0f);
+
+		int prefix[2] = { y, lineSize };
+		ok = (fwrite(prefix, 4, 2, fp) == 2);
+		ok = ok && (fwrite(&line[0], 2, _w * 3, fp) == (size_t)_w * 3);
+	}
+
+	fclose(fp);
+	return ok;
+}
+
+MappedPPM::MappedPPM()
+{
+	_w = 0;
+	_h = 0;
+	_map = NULL;
+	_size = 0;
+	_offset = 0;
+}
+
+MappedPPM::~MappedPPM()
+{
+	close();
+}
+
+bool MappedPPM::create(const char *path, int w, int h)
+{
+	close();
+
+	char header[64];
+	int len = snprintf(header, sizeof header, "P6\n%d %d\n255\n", w, h);
+
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1)
+	{
+		perror("open");
+		return false;
+	}
+
+	_offset = len;
+	_size = _offset + (size_t)w * h * 3;
+	if (ftruncate(fd, _size) == -1)
+	{
+		perror("ftruncate");
+		::close(fd);
+		return false;
+	}
+
+	void *mem = mmap(NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mem == MAP_FAILED)
+	{
+		perror("mmap");
+		return false;
+	}
+
+	_map = (unsigned char *)mem;
+	_w = w;
+	_h = h;
+	memcpy(_map, header, len);
+	return true;
+}
+
+void MappedPPM::close()
+{
+	if (_map == NULL)
+		return;
+
+	munmap(_map, _size);
+	_map = NULL;
+}
+
+void MappedPPM::blit(Image& src, int x, int y)
+{
+	int w = src.w();
+	if (x + w > _w)
+		w = _w - x;
+
+	for (int sy = 0; sy < src.h() && y + sy < _h; sy++)
+		memcpy(_map + _offset + ((size_t)(y + sy) * _w + x) * 3,
+				src.row(sy), w * 3);
+}
+
+void MappedPPM::release(int y0, int y1)
+{
+	// msync() and madvise() want page aligned addresses.
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t from = _offset + (size_t)y0 * _w * 3;
+	size_t to = _offset + (size_t)y1 * _w * 3;
+	from -= from % page;
+	if (to > _size)
+		to = _size;
+
+	msync(_map + from, to - from, MS_ASYNC);
+	madvise(_map + from, to - from, MADV_DONTNEED);
+}
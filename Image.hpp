@@ -0,0 +1,91 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef IMAGE_HPP
+#define IMAGE_HPP
+
+#include <cstddef>
+#include <vector>
+
+// 8 bit RGB image, rows stored top to bottom like in the files.
+class Image
+{
+	private:
+		int _w;
+		int _h;
+		std::vector<unsigned char> _data;
+
+	public:
+		Image();
+		Image(int w, int h);
+
+		void resize(int w, int h);
+		int w();
+		int h();
+		unsigned char *data();
+		unsigned char *row(int y);
+
+		// OpenGL delivers rows bottom to top.
+		void flipVertically();
+
+		// Take over RGBA pixels as delivered by glReadPixels().
+		void fromRGBA(const unsigned char *rgba, int w, int h);
+
+		// Copy another image into this one at the given position.
+		void blit(Image& src, int x, int y);
+
+		// Box filtered copy in another size.
+		Image scaled(int w, int h);
+
+		// The format is chosen by the file extension.
+		bool save(const char *path);
+		bool savePPM(const char *path);
+		bool savePNG(const char *path);
+		bool saveEXR(const char *path);
+};
+
+// A binary PPM file that is mapped into memory and filled piece by
+// piece. The image can be much larger than the available memory, only
+// the parts that are being written are resident.
+class MappedPPM
+{
+	private:
+		int _w;
+		int _h;
+		unsigned char *_map;
+		size_t _size;
+		size_t _offset;
+
+	public:
+		MappedPPM();
+		~MappedPPM();
+
+		bool create(const char *path, int w, int h);
+		void close();
+
+		// Copy an image into the file at the given position.
+		void blit(Image& src, int x, int y);
+
+		// Rows [y0, y1) are complete: Write them out and drop them from
+		// memory.
+		void release(int y0, int y1);
+};
+
+#endif // IMAGE_HPP
@@ -0,0 +1,328 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+
+#include "Instances.hpp"
+#include "Parallel.hpp"
+
+// Cells per axis at most.
+#define INSTANCE_GRID_MAX 256
+
+
+InstanceReader::InstanceReader()
+{
+	_offset = 0;
+	_inode = 0;
+	_line = 0;
+	_more = false;
+}
+
+void InstanceReader::open(const char *path)
+{
+	_path = path;
+	_offset = 0;
+	_inode = 0;
+	_line = 0;
+	_more = false;
+}
+
+bool InstanceReader::poll(std::vector<Instance>& out, int max)
+{
+	// A file that isn't there (yet) is just empty.
+	struct stat st;
+	if (stat(_path.c_str(), &st) != 0)
+		return false;
+
+	bool changed = false;
+	if ((unsigned long)st.st_ino != _inode || st.st_size < _offset)
+	{
+		_inode = st.st_ino;
+		_offset = 0;
+		_line = 0;
+		if (!out.empty())
+		{
+			out.clear();
+			changed = true;
+		}
+	}
+
+	_more = false;
+	if (_offset >= st.st_size)
+		return changed;
+
+	FILE *in = fopen(_path.c_str(), "r");
+	if (in == NULL)
+	{
+		perror(_path.c_str());
+		return changed;
+	}
+	fseek(in, _offset, SEEK_SET);
+
+	char *line = NULL;
+	size_t cap = 0;
+	ssize_t len;
+	int n = 0;
+	while ((len = getline(&line, &cap, in)) > 0)
+	{
+		// The rest of this line hasn't been written yet.
+		if (line[len - 1] != '\n')
+			break;
+
+		if (n++ == max)
+		{
+			_more = true;
+			break;
+		}
+
+		_offset += len;
+		_line++;
+
+		char kind[16];
+		float v[7];
+		int got = sscanf(line, "%15s %f %f %f %f %f %f %f", kind, &v[0],
+				&v[1], &v[2], &v[3], &v[4], &v[5], &v[6]);
+		if (got < 1 || kind[0] == '#')
+			continue;
+
+		Instance inst;
+		memset(&inst, 0, sizeof inst);
+		if (strcmp(kind, "sphere") == 0 && got == 5)
+		{
+			memcpy(inst.p, v, 4 * sizeof(float));
+			inst.q[3] = INSTANCE_SPHERE;
+		}
+		else if (strcmp(kind, "box") == 0 && got == 7)
+		{
+			memcpy(inst.p, v, 3 * sizeof(float));
+			memcpy(inst.q, v + 3, 3 * sizeof(float));
+			inst.q[3] = INSTANCE_BOX;
+		}
+		else if (strcmp(kind, "capsule") == 0 && got == 8)
+		{
+			memcpy(inst.p, v, 3 * sizeof(float));
+			memcpy(inst.q, v + 3, 3 * sizeof(float));
+			inst.p[3] = v[6];
+			inst.q[3] = INSTANCE_CAPSULE;
+		}
+		else
+		{
+			fprintf(stderr, "%s:%d: Unknown instance.\n", _path.c_str(),
+					_line);
+			continue;
+		}
+
+		out.push_back(inst);
+		changed = true;
+	}
+
+	free(line);
+	fclose(in);
+	return changed;
+}
+
+bool InstanceReader::pending()
+{
+	return _more;
+}
+
+
+InstanceGrid::InstanceGrid()
+{
+	for (int a = 0; a < 3; a++)
+	{
+		_res[a] = 0;
+		_lo[a] = 0;
+		_cell[a] = 1;
+	}
+}
+
+static void instanceBox(const Instance& inst, float *lo, float *hi)
+{
+	int type = (int)inst.q[3];
+	for (int a = 0; a < 3; a++)
+	{
+		if (type == INSTANCE_SPHERE)
+		{
+			lo[a] = inst.p[a] - inst.p[3];
+			hi[a] = inst.p[a] + inst.p[3];
+		}
+		else if (type == INSTANCE_BOX)
+		{
+			lo[a] = inst.p[a] - inst.q[a];
+			hi[a] = inst.p[a] + inst.q[a];
+		}
+		else
+		{
+			lo[a] = std::min(inst.p[a], inst.q[a]) - inst.p[3];
+			hi[a] = std::max(inst.p[a], inst.q[a]) + inst.p[3];
+		}
+	}
+}
+
+void InstanceGrid::build(const std::vector<Instance>& instances)
+{
+	int n = instances.size();
+	_cells.clear();
+	_refs.clear();
+	for (int a = 0; a < 3; a++)
+		_res[a] = 0;
+	if (n == 0)
+		return;
+
+	std::vector<float> boxes(6 * n);
+	parallelFor(n, [&](int i)
+	{
+		instanceBox(instances[i], &boxes[6 * i], &boxes[6 * i + 3]);
+	}, 4096);
+
+	float lo[3], hi[3];
+	for (int a = 0; a < 3; a++)
+	{
+		lo[a] = 1e30;
+		hi[a] = -1e30;
+	}
+	for (int i = 0; i < n; i++)
+	{
+		for (int a = 0; a < 3; a++)
+		{
+			lo[a] = std::min(lo[a], boxes[6 * i + a]);
+			hi[a] = std::max(hi[a], boxes[6 * i + 3 + a]);
+		}
+	}
+
+	// A small margin, so that flat scenes still have some volume.
+	float largest = std::max(hi[0] - lo[0],
+			std::max(hi[1] - lo[1], hi[2] - lo[2]));
+	float margin = (largest > 0 ? 1e-4 * largest : 1e-4);
+	float ext[3];
+	for (int a = 0; a < 3; a++)
+	{
+		lo[a] -= margin;
+		hi[a] += margin;
+		ext[a] = hi[a] - lo[a];
+	}
+	largest += 2 * margin;
+
+	// Cubic cells, about two per instance.
+	float s = cbrt(ext[0] * ext[1] * ext[2] / (2.0 * n));
+	s = std::max(s, largest / INSTANCE_GRID_MAX);
+	for (int a = 0; a < 3; a++)
+	{
+		_res[a] = std::min(INSTANCE_GRID_MAX,
+				std::max(1, (int)ceil(ext[a] / s)));
+		_cell[a] = ext[a] / _res[a];
+		_lo[a] = lo[a];
+	}
+
+	// Cells covered by each instance.
+	std::vector<int> range(6 * n);
+	std::vector<int> offset(n + 1);
+	parallelFor(n, [&](int i)
+	{
+		int count = 1;
+		for (int a = 0; a < 3; a++)
+		{
+			for (int k = 0; k < 2; k++)
+			{
+				int c = (int)((boxes[6 * i + 3 * k + a] - _lo[a]) / _cell[a]);
+				range[6 * i + 3 * k + a] = std::max(0,
+						std::min(_res[a] - 1, c));
+			}
+			count *= range[6 * i + 3 + a] - range[6 * i + a] + 1;
+		}
+		offset[i + 1] = count;
+	}, 4096);
+
+	offset[0] = 0;
+	for (int i = 0; i < n; i++)
+		offset[i + 1] += offset[i];
+
+	std::vector<int> cellOf(offset[n]);
+	parallelFor(n, [&](int i)
+	{
+		const int *r = &range[6 * i];
+		int k = offset[i];
+		for (int z = r[2]; z <= r[5]; z++)
+			for (int y = r[1]; y <= r[4]; y++)
+				for (int x = r[0]; x <= r[3]; x++)
+					cellOf[k++] = x + _res[0] * (y + _res[1] * z);
+	}, 4096);
+
+	// Counting sort by cell. Instances stay in order within a cell.
+	int numCells = _res[0] * _res[1] * _res[2];
+	std::vector<int> start(numCells + 1, 0);
+	for (size_t k = 0; k < cellOf.size(); k++)
+		start[cellOf[k] + 1]++;
+	for (int c = 0; c < numCells; c++)
+		start[c + 1] += start[c];
+
+	_cells.resize(2 * numCells);
+	for (int c = 0; c < numCells; c++)
+	{
+		_cells[2 * c] = start[c];
+		_cells[2 * c + 1] = start[c + 1] - start[c];
+	}
+
+	_refs.resize(cellOf.size());
+	for (int i = 0; i < n; i++)
+		for (int k = offset[i]; k < offset[i + 1]; k++)
+			_refs[start[cellOf[k]]++] = i;
+}
+
+const int *InstanceGrid::res() const
+{
+	return _res;
+}
+
+const float *InstanceGrid::lo() const
+{
+	return _lo;
+}
+
+const float *InstanceGrid::cellSize() const
+{
+	return _cell;
+}
+
+int InstanceGrid::cells() const
+{
+	return _cells.size() / 2;
+}
+
+const int *InstanceGrid::cellData() const
+{
+	return _cells.data();
+}
+
+int InstanceGrid::refs() const
+{
+	return _refs.size();
+}
+
+const int *InstanceGrid::refData() const
+{
+	return _refs.data();
+}
@@ -0,0 +1,106 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef INSTANCES_HPP
+#define INSTANCES_HPP
+
+#include <string>
+#include <vector>
+
+#define INSTANCE_SPHERE 0
+#define INSTANCE_BOX 1
+#define INSTANCE_CAPSULE 2
+
+// One primitive, laid out as it is uploaded (two RGBA texels):
+//
+//     sphere:   (center, radius), (0, 0, 0, INSTANCE_SPHERE)
+//     box:      (center, 0),      (half size, INSTANCE_BOX)
+//     capsule:  (end a, radius),  (end b, INSTANCE_CAPSULE)
+//
+// Boxes are axis aligned.
+struct Instance
+{
+	float p[4];
+	float q[4];
+};
+
+// Reads instances from a text file, one per line:
+//
+//     sphere x y z r
+//     box x y z hx hy hz
+//     capsule ax ay az bx by bz r
+//
+// Empty lines and lines starting with '#' are skipped. Only complete
+// lines are consumed, so the file can be read while it's still being
+// written. If it is replaced or truncated, reading starts over.
+class InstanceReader
+{
+	private:
+		std::string _path;
+		long _offset;
+		unsigned long _inode;
+		int _line;
+		bool _more;
+
+	public:
+		InstanceReader();
+
+		void open(const char *path);
+
+		// Read at most "max" new lines into "out". If the file has been
+		// replaced, "out" is cleared first. Returns true if "out" has
+		// changed.
+		bool poll(std::vector<Instance>& out, int max);
+
+		// Whether the last poll() stopped at "max" lines.
+		bool pending();
+};
+
+// Uniform grid over the bounding boxes of the instances. Each cell
+// lists the instances that overlap it. There are about two cells per
+// instance, so a ray only ever looks at the few instances close to it.
+class InstanceGrid
+{
+	private:
+		int _res[3];
+		float _lo[3];
+		float _cell[3];
+
+		// First reference and number of references of each cell, x
+		// fastest.
+		std::vector<int> _cells;
+		std::vector<int> _refs;
+
+	public:
+		InstanceGrid();
+
+		void build(const std::vector<Instance>& instances);
+
+		const int *res() const;
+		const float *lo() const;
+		const float *cellSize() const;
+
+		int cells() const;
+		const int *cellData() const;
+		int refs() const;
+		const int *refData() const;
+};
+
+#endif // INSTANCES_HPP
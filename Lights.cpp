@@ -0,0 +1,115 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Lights.hpp"
+
+static void normalize(float *v)
+{
+	float len = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	if (len > 0)
+		for (int i = 0; i < 3; i++)
+			v[i] /= len;
+}
+
+bool LightList::load(const char *path)
+{
+	_lights.clear();
+
+	FILE *in = fopen(path, "r");
+	if (in == NULL)
+	{
+		perror(path);
+		return false;
+	}
+
+	char *line = NULL;
+	size_t cap = 0;
+	int number = 0;
+	bool ok = true;
+	while (getline(&line, &cap, in) > 0)
+	{
+		number++;
+
+		char kind[16];
+		float v[11];
+		int got = sscanf(line, "%15s %f %f %f %f %f %f %f %f %f %f %f",
+				kind, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6],
+				&v[7], &v[8], &v[9], &v[10]);
+		if (got < 1 || kind[0] == '#')
+			continue;
+
+		Light l;
+		memset(&l, 0, sizeof l);
+		if (strcmp(kind, "point") == 0 && got == 8 && v[6] > 0)
+		{
+			memcpy(l.p, v, 3 * sizeof(float));
+			memcpy(l.c, v + 3, 3 * sizeof(float));
+			l.p[3] = v[6];
+			l.c[3] = LIGHT_POINT;
+		}
+		else if (strcmp(kind, "spot") == 0 && got == 12 && v[9] > 0)
+		{
+			memcpy(l.p, v, 3 * sizeof(float));
+			memcpy(l.d, v + 3, 3 * sizeof(float));
+			memcpy(l.c, v + 6, 3 * sizeof(float));
+			normalize(l.d);
+			l.p[3] = v[9];
+			l.c[3] = LIGHT_SPOT;
+			l.d[3] = cos(v[10] * M_PI / 180);
+		}
+		else if (strcmp(kind, "directional") == 0 && got == 7)
+		{
+			memcpy(l.p, v, 3 * sizeof(float));
+			memcpy(l.c, v + 3, 3 * sizeof(float));
+			normalize(l.p);
+			l.c[3] = LIGHT_DIRECTIONAL;
+		}
+		else
+		{
+			fprintf(stderr, "%s:%d: Unknown light.\n", path, number);
+			ok = false;
+			continue;
+		}
+
+		if (strstr(line, " noshadow") != NULL)
+			l.c[3] += LIGHT_NO_SHADOW;
+
+		_lights.push_back(l);
+	}
+
+	free(line);
+	fclose(in);
+	return ok;
+}
+
+int LightList::size() const
+{
+	return _lights.size();
+}
+
+const Light *LightList::data() const
+{
+	return _lights.data();
+}
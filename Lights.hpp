@@ -0,0 +1,74 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef LIGHTS_HPP
+#define LIGHTS_HPP
+
+#include <vector>
+
+#define LIGHT_POINT 0
+#define LIGHT_SPOT 1
+#define LIGHT_DIRECTIONAL 2
+
+// Added to the type of lights that cast no shadows.
+#define LIGHT_NO_SHADOW 4
+
+// The tiled pass sorts lights into lists per tile of LIGHT_TILE^2
+// pixels (the default of --light-tile). A list is a bit mask, one RGBA
+// texel holds LIGHT_WORD lights.
+#define LIGHT_TILE 16
+#define LIGHT_WORD 64
+
+// One light, laid out as it is uploaded (three RGBA texels):
+//
+//     (position, radius), (color, type), (direction, cos of the angle)
+//
+// Point and spot lights fade out to nothing at their radius. The last
+// texel is only used by spot lights. Directional lights keep the
+// direction they shine in as "position", their radius is 0.
+struct Light
+{
+	float p[4];
+	float c[4];
+	float d[4];
+};
+
+// Reads lights from a text file, one per line:
+//
+//     point x y z r g b radius
+//     spot x y z dx dy dz r g b radius angle
+//     directional dx dy dz r g b
+//
+// Angles are in degrees, from the axis to the edge of the cone. Lines
+// ending in "noshadow" describe lights without shadows. Empty lines and
+// lines starting with '#' are skipped.
+class LightList
+{
+	private:
+		std::vector<Light> _lights;
+
+	public:
+		bool load(const char *path);
+
+		int size() const;
+		const Light *data() const;
+};
+
+#endif // LIGHTS_HPP
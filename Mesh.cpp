@@ -0,0 +1,739 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+#include <strings.h>
+
+#include "Mesh.hpp"
+#include "Parallel.hpp"
+
+
+MeshWriter::MeshWriter()
+{
+	_ply = false;
+	_vertices = NULL;
+	_faces = NULL;
+	_numVertices = 0;
+	_numFaces = 0;
+}
+
+MeshWriter::~MeshWriter()
+{
+	if (_vertices != NULL)
+		fclose(_vertices);
+	if (_faces != NULL)
+		fclose(_faces);
+}
+
+bool MeshWriter::open(const char *path)
+{
+	const char *ext = strrchr(path, '.');
+	_ply = (ext != NULL && strcasecmp(ext, ".ply") == 0);
+	_path = path;
+	_numVertices = 0;
+	_numFaces = 0;
+
+	// PLY wants the counts in the header, so everything is collected
+	// first. The files are deleted automatically.
+	_vertices = tmpfile();
+	_faces = tmpfile();
+	if (_vertices == NULL || _faces == NULL)
+	{
+		perror("tmpfile");
+		return false;
+	}
+
+	return true;
+}
+
+int MeshWriter::vertex(const float *p)
+{
+	fwrite(p, sizeof(float), 3, _vertices);
+	return _numVertices++;
+}
+
+void MeshWriter::quad(const int *v)
+{
+	fwrite(v, sizeof(int), 4, _faces);
+	_numFaces++;
+}
+
+bool MeshWriter::copy(FILE *from, FILE *to, bool faces)
+{
+	const int chunk = 4096;
+	const int per = (faces ? 4 : 3);
+	std::vector<float> p(chunk * 3);
+	std::vector<int> v(chunk * 4);
+	unsigned char four = 4;
+
+	rewind(from);
+
+	size_t got;
+	while ((got = (faces ? fread(v.data(), sizeof(int) * per, chunk, from)
+					: fread(p.data(), sizeof(float) * per, chunk, from))) > 0)
+	{
+		for (size_t i = 0; i < got; i++)
+		{
+			if (_ply && faces)
+			{
+				fwrite(&four, 1, 1, to);
+				fwrite(&v[i * 4], sizeof(int), 4, to);
+			}
+			else if (faces)
+			{
+				// OBJ counts from 1.
+				fprintf(to, "f %d %d %d %d\n", v[i * 4] + 1, v[i * 4 + 1] + 1,
+						v[i * 4 + 2] + 1, v[i * 4 + 3] + 1);
+			}
+			else if (!_ply)
+			{
+				fprintf(to, "v %g %g %g\n", p[i * 3], p[i * 3 + 1],
+						p[i * 3 + 2]);
+			}
+		}
+
+		if (_ply && !faces)
+			fwrite(p.data(), sizeof(float) * per, got, to);
+	}
+
+	return !ferror(from) && !ferror(to);
+}
+
+bool MeshWriter::close()
+{
+	FILE *out = fopen(_path.c_str(), "wb");
+	if (out == NULL)
+	{
+		perror(_path.c_str());
+		return false;
+	}
+
+	if (_ply)
+	{
+		uint16_t order = 1;
+		bool little = (*(unsigned char *)&order == 1);
+
+		fprintf(out, "ply\n"
+				"format %s 1.0\n"
+				"comment GPUTracer\n"
+				"element vertex %d\n"
+				"property float x\n"
+				"property float y\n"
+				"property float z\n"
+				"element face %d\n"
+				"property list uchar int vertex_indices\n"
+				"end_header\n",
+				(little ? "binary_little_endian" : "binary_big_endian"),
+				_numVertices, _numFaces);
+	}
+
+	bool ok = copy(_vertices, out, false) && copy(_faces, out, true);
+	if (fclose(out) != 0)
+		ok = false;
+
+	fclose(_vertices);
+	fclose(_faces);
+	_vertices = NULL;
+	_faces = NULL;
+
+	if (!ok)
+		perror(_path.c_str());
+	return ok;
+}
+
+int MeshWriter::vertices()
+{
+	return _numVertices;
+}
+
+int MeshWriter::faces()
+{
+	return _numFaces;
+}
+
+
+bool TriangleMesh::load(const char *path)
+{
+	FILE *in = fopen(path, "rb");
+	if (in == NULL)
+	{
+		perror(path);
+		return false;
+	}
+
+	_vertices.clear();
+	_indices.clear();
+
+	const char *ext = strrchr(path, '.');
+	bool ok;
+	if (ext != NULL && strcasecmp(ext, ".ply") == 0)
+		ok = loadPly(in);
+	else
+		ok = loadObj(in);
+	fclose(in);
+
+	if (!ok)
+	{
+		fprintf(stderr, "Could not read mesh from `%s'.\n", path);
+		return false;
+	}
+
+	int n = vertices();
+	for (size_t i = 0; i < _indices.size(); i++)
+	{
+		if (_indices[i] < 0 || _indices[i] >= n)
+		{
+			fprintf(stderr, "`%s' refers to vertex %d, but there are only"
+					" %d.\n", path, _indices[i], n);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void TriangleMesh::addPolygon(const int *v, int n)
+{
+	for (int i = 2; i < n; i++)
+	{
+		_indices.push_back(v[0]);
+		_indices.push_back(v[i - 1]);
+		_indices.push_back(v[i]);
+	}
+}
+
+bool TriangleMesh::loadObj(FILE *in)
+{
+	char line[4096];
+	std::vector<int> poly;
+
+	while (fgets(line, sizeof line, in) != NULL)
+	{
+		if (line[0] == 'v' && isspace(line[1]))
+		{
+			float p[3];
+			if (sscanf(line + 2, "%f %f %f", &p[0], &p[1], &p[2]) != 3)
+				return false;
+			_vertices.insert(_vertices.end(), p, p + 3);
+		}
+		else if (line[0] == 'f' && isspace(line[1]))
+		{
+			// "f 1 2 3", "f 1/1 2/2 3/3", "f 1//1 2//2 3//3" or the like.
+			// Negative indices count back from the last vertex.
+			poly.clear();
+			char *s = line + 1;
+			char *end;
+			while (true)
+			{
+				long i = strtol(s, &end, 10);
+				if (end == s)
+					break;
+				poly.push_back(i < 0 ? vertices() + i : i - 1);
+
+				s = end;
+				while (*s != '\0' && !isspace(*s))
+					s++;
+			}
+			addPolygon(poly.data(), poly.size());
+		}
+	}
+
+	return !ferror(in);
+}
+
+enum PlyFormat { PLY_ASCII, PLY_NATIVE, PLY_SWAPPED };
+
+struct PlyProperty
+{
+	std::string name;
+	int size;
+	bool integer;
+	bool sign;
+
+	// Lists: Size of the count in front, 0 for plain properties.
+	int countSize;
+};
+
+struct PlyElement
+{
+	std::string name;
+	long count;
+	std::vector<PlyProperty> props;
+};
+
+static bool plyType(const std::string& name, int& size, bool& integer,
+		bool& sign)
+{
+	static const char *names[][2] =
+		{
+			{ "char", "int8" }, { "uchar", "uint8" },
+			{ "short", "int16" }, { "ushort", "uint16" },
+			{ "int", "int32" }, { "uint", "uint32" },
+			{ "float", "float32" }, { "double", "float64" }
+		};
+	static const int sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+	for (int i = 0; i < 8; i++)
+	{
+		if (name == names[i][0] || name == names[i][1])
+		{
+			size = sizes[i];
+			integer = (i < 6);
+			sign = (i % 2 == 0 || i >= 6);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool plyValue(FILE *in, PlyFormat format, int size, bool integer,
+		bool sign, double& value)
+{
+	if (format == PLY_ASCII)
+		return fscanf(in, "%lf", &value) == 1;
+
+	unsigned char b[8];
+	if (fread(b, size, 1, in) != 1)
+		return false;
+	if (format == PLY_SWAPPED)
+	{
+		for (int i = 0; i < size / 2; i++)
+		{
+			unsigned char c = b[i];
+			b[i] = b[size - 1 - i];
+			b[size - 1 - i] = c;
+		}
+	}
+
+	if (!integer)
+	{
+		if (size == 4)
+		{
+			float f;
+			memcpy(&f, b, 4);
+			value = f;
+		}
+		else
+		{
+			memcpy(&value, b, 8);
+		}
+		return true;
+	}
+
+	// Bytes are in native order now.
+	if (size == 1)
+	{
+		value = (sign ? (double)(int8_t)b[0] : (double)b[0]);
+	}
+	else if (size == 2)
+	{
+		uint16_t x;
+		memcpy(&x, b, 2);
+		value = (sign ? (double)(int16_t)x : (double)x);
+	}
+	else
+	{
+		uint32_t x;
+		memcpy(&x, b, 4);
+		value = (sign ? (double)(int32_t)x : (double)x);
+	}
+	return true;
+}
+
+bool TriangleMesh::loadPly(FILE *in)
+{
+	char line[1024];
+	if (fgets(line, sizeof line, in) == NULL || strncmp(line, "ply", 3) != 0)
+		return false;
+
+	uint16_t order = 1;
+	bool little = (*(unsigned char *)&order == 1);
+
+	PlyFormat format = PLY_ASCII;
+	std::vector<PlyElement> elements;
+
+	while (true)
+	{
+		if (fgets(line, sizeof line, in) == NULL)
+			return false;
+
+		std::istringstream words(line);
+		std::string word;
+		words >> word;
+
+		if (word == "end_header")
+		{
+			break;
+		}
+		else if (word == "format")
+		{
+			words >> word;
+			if (word == "ascii")
+				format = PLY_ASCII;
+			else if (word == "binary_little_endian")
+				format = (little ? PLY_NATIVE : PLY_SWAPPED);
+			else if (word == "binary_big_endian")
+				format = (little ? PLY_SWAPPED : PLY_NATIVE);
+			else
+				return false;
+		}
+		else if (word == "element")
+		{
+			PlyElement e;
+			if (!(words >> e.name >> e.count))
+				return false;
+			elements.push_back(e);
+		}
+		else if (word == "property" && !elements.empty())
+		{
+			PlyProperty p;
+			bool dummy;
+			p.countSize = 0;
+			words >> word;
+			if (word == "list")
+			{
+				words >> word;
+				if (!plyType(word, p.countSize, dummy, dummy))
+					return false;
+				words >> word;
+			}
+			if (!plyType(word, p.size, p.integer, p.sign))
+				return false;
+			words >> p.name;
+			elements.back().props.push_back(p);
+		}
+	}
+
+	std::vector<double> values;
+	std::vector<int> poly;
+	for (size_t e = 0; e < elements.size(); e++)
+	{
+		const PlyElement& el = elements[e];
+		bool isVertex = (el.name == "vertex");
+		bool isFace = (el.name == "face");
+
+		// Which properties are needed.
+		int xyz[3] = { -1, -1, -1 };
+		int indices = -1;
+		for (size_t i = 0; i < el.props.size(); i++)
+		{
+			const std::string& name = el.props[i].name;
+			if (isVertex && name.size() == 1 && name[0] >= 'x'
+					&& name[0] <= 'z' && el.props[i].countSize == 0)
+				xyz[name[0] - 'x'] = i;
+			if (isFace && el.props[i].countSize != 0
+					&& (name == "vertex_indices" || name == "vertex_index"))
+				indices = i;
+		}
+		if (isVertex && (xyz[0] < 0 || xyz[1] < 0 || xyz[2] < 0))
+			return false;
+
+		values.resize(el.props.size());
+		for (long k = 0; k < el.count; k++)
+		{
+			for (size_t i = 0; i < el.props.size(); i++)
+			{
+				const PlyProperty& p = el.props[i];
+				if (p.countSize == 0)
+				{
+					if (!plyValue(in, format, p.size, p.integer, p.sign,
+								values[i]))
+						return false;
+					continue;
+				}
+
+				double count;
+				if (!plyValue(in, format, p.countSize, true, false, count))
+					return false;
+
+				poly.resize((size_t)count);
+				for (size_t j = 0; j < poly.size(); j++)
+				{
+					double v;
+					if (!plyValue(in, format, p.size, p.integer, p.sign, v))
+						return false;
+					poly[j] = (int)v;
+				}
+
+				if ((int)i == indices)
+					addPolygon(poly.data(), poly.size());
+			}
+
+			if (isVertex)
+				for (int i = 0; i < 3; i++)
+					_vertices.push_back(values[xyz[i]]);
+		}
+	}
+
+	return true;
+}
+
+void TriangleMesh::fit(float size)
+{
+	float lo[3], hi[3];
+	for (int i = 0; i < 3; i++)
+	{
+		lo[i] = 1e30;
+		hi[i] = -1e30;
+	}
+	for (size_t k = 0; k < _vertices.size(); k++)
+	{
+		lo[k % 3] = std::min(lo[k % 3], _vertices[k]);
+		hi[k % 3] = std::max(hi[k % 3], _vertices[k]);
+	}
+
+	float largest = std::max(hi[0] - lo[0],
+			std::max(hi[1] - lo[1], hi[2] - lo[2]));
+	if (largest <= 0)
+		return;
+
+	float scale = size / largest;
+	for (size_t k = 0; k < _vertices.size(); k++)
+		_vertices[k] = (_vertices[k] - 0.5 * (lo[k % 3] + hi[k % 3])) * scale;
+}
+
+int TriangleMesh::vertices() const
+{
+	return _vertices.size() / 3;
+}
+
+int TriangleMesh::triangles() const
+{
+	return _indices.size() / 3;
+}
+
+const float *TriangleMesh::vertexData() const
+{
+	return _vertices.data();
+}
+
+const int *TriangleMesh::indexData() const
+{
+	return _indices.data();
+}
+
+
+// What one thread found in its layers of cells.
+struct NetSlab
+{
+	// x, y, z of each vertex.
+	std::vector<float> vertices;
+
+	// Four per quad: Indices into "vertices", or -2 - c for cell c
+	// of the layer below the slab, which belongs to another slab.
+	std::vector<int> quads;
+
+	// Index of the vertex of each cell of the topmost layer, or -1.
+	std::vector<int> top;
+};
+
+SurfaceNets::SurfaceNets(int n, const float *min, float h, MeshWriter& out)
+{
+	_n = n;
+	for (int i = 0; i < 3; i++)
+		_min[i] = min[i];
+	_h = h;
+	_out = &out;
+	_last.assign(n * n, -1);
+	_numBlocks = 0;
+}
+
+void SurfaceNets::setBlocks(const std::vector<unsigned char>& blocks,
+		int numBlocks, const std::vector<int>& blockOf)
+{
+	_blocks = blocks;
+	_numBlocks = numBlocks;
+	_blockOf = blockOf;
+}
+
+void SurfaceNets::meshSlab(int z0, int c0, int c1,
+		const float *const *planes, NetSlab& slab)
+{
+	// Corners of a cell: Bit 0 is x, bit 1 is y, bit 2 is z.
+	static const int edges[12][2] = {
+		{ 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 },
+		{ 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 },
+		{ 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }
+	};
+
+	int n = _n;
+	std::vector<int> below(n * n, -1);
+	std::vector<int> cur(n * n, -1);
+
+	// Outward facing quads: If the inside is at the lower end of the
+	// edge, the corners are counterclockwise when looking down the
+	// edge. Cells that have been skipped can't be connected.
+	auto emit = [&](int a, int b, int c, int d, bool inside)
+	{
+		if (a == -1 || b == -1 || c == -1 || d == -1)
+			return;
+
+		int q[4] = { a, b, c, d };
+		if (!inside)
+			std::reverse(q, q + 4);
+		slab.quads.insert(slab.quads.end(), q, q + 4);
+	};
+
+	for (int z = c0; z < c1; z++)
+	{
+		const float *lo = planes[z - z0];
+		const float *hi = planes[z - z0 + 1];
+
+		// One vertex for each cell that is crossed by the surface.
+		std::fill(cur.begin(), cur.end(), -1);
+		for (int y = 0; y < n - 1; y++)
+			for (int x = 0; x < n - 1; x++)
+			{
+				if (_numBlocks > 0 && !_blocks[(_blockOf[z] * _numBlocks
+							+ _blockOf[y]) * _numBlocks + _blockOf[x]])
+					continue;
+
+				float c[8];
+				int inside = 0;
+				for (int i = 0; i < 8; i++)
+				{
+					const float *plane = (i & 4 ? hi : lo);
+					c[i] = plane[(y + ((i >> 1) & 1)) * n + x + (i & 1)];
+					if (c[i] < 0)
+						inside++;
+				}
+
+				if (inside == 0 || inside == 8)
+					continue;
+
+				float sum[3] = { 0, 0, 0 };
+				int crossed = 0;
+				for (int e = 0; e < 12; e++)
+				{
+					int a = edges[e][0];
+					int b = edges[e][1];
+					if ((c[a] < 0) == (c[b] < 0))
+						continue;
+
+					float t = c[a] / (c[a] - c[b]);
+					for (int k = 0; k < 3; k++)
+					{
+						float pa = (a >> k) & 1;
+						float pb = (b >> k) & 1;
+						sum[k] += pa + t * (pb - pa);
+					}
+					crossed++;
+				}
+
+				int cell[3] = { x, y, z };
+				cur[y * n + x] = slab.vertices.size() / 3;
+				for (int k = 0; k < 3; k++)
+					slab.vertices.push_back(_min[k]
+							+ (cell[k] + sum[k] / crossed) * _h);
+			}
+
+		// Edges along z, between the two planes.
+		for (int y = 1; y < n - 1; y++)
+			for (int x = 1; x < n - 1; x++)
+			{
+				float a = lo[y * n + x];
+				float b = hi[y * n + x];
+				if ((a < 0) != (b < 0))
+					emit(cur[(y - 1) * n + x - 1], cur[(y - 1) * n + x],
+							cur[y * n + x], cur[y * n + x - 1], a < 0);
+			}
+
+		if (z == 0)
+		{
+			std::swap(below, cur);
+			continue;
+		}
+
+		// Edges along x and y in the lower plane. They're surrounded by
+		// cells of this layer and the one below.
+		if (z == c0)
+			for (int i = 0; i < n * n; i++)
+				below[i] = -2 - i;
+
+		for (int y = 0; y < n - 1; y++)
+			for (int x = 0; x < n - 1; x++)
+			{
+				float a = lo[y * n + x];
+
+				float b = lo[y * n + x + 1];
+				if (y > 0 && (a < 0) != (b < 0))
+					emit(below[(y - 1) * n + x], below[y * n + x],
+							cur[y * n + x], cur[(y - 1) * n + x], a < 0);
+
+				b = lo[(y + 1) * n + x];
+				if (x > 0 && (a < 0) != (b < 0))
+					emit(below[y * n + x - 1], cur[y * n + x - 1],
+							cur[y * n + x], below[y * n + x], a < 0);
+			}
+
+		std::swap(below, cur);
+	}
+
+	slab.top.swap(below);
+}
+
+void SurfaceNets::mesh(int z0, int count, const float *const *planes)
+{
+	int slabs = std::min(count, parallelThreads());
+	int depth = (count + slabs - 1) / slabs;
+	slabs = (count + depth - 1) / depth;
+
+	std::vector<NetSlab> slab(slabs);
+	parallelFor(slabs, [&](int i)
+	{
+		int c0 = z0 + i * depth;
+		int c1 = std::min(c0 + depth, z0 + count);
+		meshSlab(z0, c0, c1, planes, slab[i]);
+	});
+
+	// Vertices get their final indices in order, so every slab can
+	// connect to the one below.
+	for (int i = 0; i < slabs; i++)
+	{
+		NetSlab& s = slab[i];
+		int base = _out->vertices();
+		for (size_t k = 0; k < s.vertices.size(); k += 3)
+			_out->vertex(&s.vertices[k]);
+
+		for (size_t k = 0; k < s.quads.size(); k += 4)
+		{
+			int q[4];
+			bool ok = true;
+			for (int j = 0; j < 4; j++)
+			{
+				int r = s.quads[k + j];
+				q[j] = (r >= 0 ? base + r : _last[-2 - r]);
+				ok = ok && q[j] != -1;
+			}
+
+			if (ok)
+				_out->quad(q);
+		}
+
+		for (size_t k = 0; k < s.top.size(); k++)
+			_last[k] = (s.top[k] >= 0 ? base + s.top[k] : -1);
+	}
+}
@@ -0,0 +1,136 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef MESH_HPP
+#define MESH_HPP
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Writes a polygon mesh to a binary PLY or an OBJ file, depending on
+// the extension. Vertices and faces go to temporary files first, so
+// memory use does not depend on the size of the mesh.
+class MeshWriter
+{
+	private:
+		std::string _path;
+		bool _ply;
+		FILE *_vertices;
+		FILE *_faces;
+		int _numVertices;
+		int _numFaces;
+
+		bool copy(FILE *from, FILE *to, bool faces);
+
+	public:
+		MeshWriter();
+		~MeshWriter();
+
+		bool open(const char *path);
+
+		// Returns the index of the new vertex.
+		int vertex(const float *p);
+
+		// Four vertices, counterclockwise when seen from outside.
+		void quad(const int *v);
+
+		bool close();
+
+		int vertices();
+		int faces();
+};
+
+// Triangles read from an OBJ or PLY file (ASCII or binary). Polygons
+// are split into fans. Only positions are read.
+class TriangleMesh
+{
+	private:
+		std::vector<float> _vertices;
+		std::vector<int> _indices;
+
+		bool loadObj(FILE *in);
+		bool loadPly(FILE *in);
+		void addPolygon(const int *v, int n);
+
+	public:
+		bool load(const char *path);
+
+		// Move and scale uniformly so that the bounding box is centered
+		// at the origin and its largest side is "size" long.
+		void fit(float size);
+
+		int vertices() const;
+		int triangles() const;
+
+		// x, y, z of each vertex and three indices per triangle.
+		const float *vertexData() const;
+		const int *indexData() const;
+};
+
+struct NetSlab;
+
+// Naive surface nets, the simplest variant of dual contouring: Every
+// cell of the sample grid that the surface passes through gets one
+// vertex, the average of the points where the surface crosses the
+// cell's edges. Each crossed edge of the grid results in a quad that
+// connects the four cells around it.
+//
+// The grid has n^3 samples, the first one at "min", spaced "h" apart.
+// Samples are handed in plane by plane (z), x running fastest. Negative
+// values are inside.
+class SurfaceNets
+{
+	private:
+		int _n;
+		float _min[3];
+		float _h;
+		MeshWriter *_out;
+
+		// Global indices of the vertices of the cells right below the
+		// next plane, -1 where there is none.
+		std::vector<int> _last;
+
+		// Optional: Cells whose lower corner is in a block that is
+		// flagged zero are skipped.
+		std::vector<unsigned char> _blocks;
+		std::vector<int> _blockOf;
+		int _numBlocks;
+
+		void meshSlab(int z0, int c0, int c1, const float *const *planes,
+				NetSlab& slab);
+
+	public:
+		SurfaceNets(int n, const float *min, float h, MeshWriter& out);
+
+		// "blockOf" maps the index of a sample along an axis to the
+		// index of its block. Skipped cells must not be crossed by the
+		// surface, so blocks next to the surface have to be set, too.
+		void setBlocks(const std::vector<unsigned char>& blocks,
+				int numBlocks, const std::vector<int>& blockOf);
+
+		// Mesh "count" layers of cells, starting at z0. "planes" holds
+		// the samples of the count + 1 planes from z0 to z0 + count.
+		// Calls have to follow each other, starting at 0, and end at
+		// plane n - 1. Slabs of layers are processed in parallel.
+		void mesh(int z0, int count, const float *const *planes);
+};
+
+#endif // MESH_HPP
@@ -0,0 +1,166 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <iostream>
+#include <string>
+
+#include "Offscreen.hpp"
+
+// The same core profile as in a window, see main().
+static const EGLint contextAttribs[] = {
+	EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+	EGL_CONTEXT_MINOR_VERSION_KHR, 2,
+	EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR,
+		EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+	EGL_NONE
+};
+
+OffscreenContext::OffscreenContext()
+{
+	_display = EGL_NO_DISPLAY;
+	_context = EGL_NO_CONTEXT;
+	_surface = EGL_NO_SURFACE;
+}
+
+OffscreenContext::~OffscreenContext()
+{
+	destroy();
+}
+
+bool OffscreenContext::createSurfaceless()
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)
+		eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay == NULL)
+		return false;
+
+	_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+			EGL_DEFAULT_DISPLAY, NULL);
+	if (_display == EGL_NO_DISPLAY || !eglInitialize(_display, NULL, NULL))
+	{
+		_display = EGL_NO_DISPLAY;
+		return false;
+	}
+
+	const char *ext = eglQueryString(_display, EGL_EXTENSIONS);
+	if (ext == NULL || std::string(ext).find("EGL_KHR_surfaceless_context")
+			== std::string::npos || !eglBindAPI(EGL_OPENGL_API))
+	{
+		eglTerminate(_display);
+		_display = EGL_NO_DISPLAY;
+		return false;
+	}
+
+	// No config, no surface: Everything goes to FBOs anyway.
+	_context = eglCreateContext(_display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT,
+			contextAttribs);
+	if (_context == EGL_NO_CONTEXT
+			|| !eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+				_context))
+	{
+		destroy();
+		return false;
+	}
+
+	return true;
+}
+
+bool OffscreenContext::createPbuffer()
+{
+	_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (_display == EGL_NO_DISPLAY || !eglInitialize(_display, NULL, NULL))
+	{
+		_display = EGL_NO_DISPLAY;
+		return false;
+	}
+
+	const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_NONE
+	};
+	const EGLint surfaceAttribs[] = {
+		EGL_WIDTH, 1,
+		EGL_HEIGHT, 1,
+		EGL_NONE
+	};
+
+	EGLConfig config;
+	EGLint count = 0;
+	if (!eglChooseConfig(_display, configAttribs, &config, 1, &count)
+			|| count < 1 || !eglBindAPI(EGL_OPENGL_API))
+	{
+		destroy();
+		return false;
+	}
+
+	_surface = eglCreatePbufferSurface(_display, config, surfaceAttribs);
+	_context = eglCreateContext(_display, config, EGL_NO_CONTEXT,
+			contextAttribs);
+	if (_surface == EGL_NO_SURFACE || _context == EGL_NO_CONTEXT
+			|| !eglMakeCurrent(_display, _surface, _surface, _context))
+	{
+		destroy();
+		return false;
+	}
+
+	return true;
+}
+
+bool OffscreenContext::create()
+{
+	destroy();
+
+	if (createSurfaceless())
+	{
+		std::cout << "Offscreen: Surfaceless EGL context." << std::endl;
+		return true;
+	}
+
+	if (createPbuffer())
+	{
+		std::cout << "Offscreen: EGL pbuffer context." << std::endl;
+		return true;
+	}
+
+	std::cerr << "Could not create an offscreen GL context." << std::endl;
+	return false;
+}
+
+void OffscreenContext::destroy()
+{
+	if (_display == EGL_NO_DISPLAY)
+		return;
+
+	eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (_context != EGL_NO_CONTEXT)
+		eglDestroyContext(_display, _context);
+	if (_surface != EGL_NO_SURFACE)
+		eglDestroySurface(_display, _surface);
+	eglTerminate(_display);
+
+	_display = EGL_NO_DISPLAY;
+	_context = EGL_NO_CONTEXT;
+	_surface = EGL_NO_SURFACE;
+}
@@ -0,0 +1,51 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef OFFSCREEN_HPP
+#define OFFSCREEN_HPP
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+// A GL context without any window or display server, for batch work on
+// headless machines. Mesa's surfaceless platform is preferred, so this
+// works with llvmpipe as well as with render nodes. If that's not
+// available, a 1x1 pbuffer on the default display is used.
+//
+// There's no default framebuffer to draw to: Bind a Framebuffer.
+class OffscreenContext
+{
+	private:
+		EGLDisplay _display;
+		EGLContext _context;
+		EGLSurface _surface;
+
+		bool createSurfaceless();
+		bool createPbuffer();
+
+	public:
+		OffscreenContext();
+		~OffscreenContext();
+
+		bool create();
+		void destroy();
+};
+
+#endif // OFFSCREEN_HPP
@@ -0,0 +1,65 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <thread>
+#include <vector>
+#include <atomic>
+
+// Number of worker threads used by parallelFor().
+inline int parallelThreads()
+{
+	int n = std::thread::hardware_concurrency();
+	return (n > 0 ? n : 1);
+}
+
+// Call body(i) for every i in [0, n). Work is handed out in small
+// chunks so that expensive and cheap items balance out. The calling
+// thread participates, so this is a plain loop on single core machines.
+template <typename F>
+void parallelFor(int n, F body, int chunk = 1)
+{
+	int threads = parallelThreads();
+	if (threads > n)
+		threads = n;
+
+	std::atomic<int> next(0);
+	auto worker = [&]()
+	{
+		int start;
+		while ((start = next.fetch_add(chunk)) < n)
+		{
+			int end = (start + chunk < n ? start + chunk : n);
+			for (int i = start; i < end; i++)
+				body(i);
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (int t = 1; t < threads; t++)
+		pool.push_back(std::thread(worker));
+	worker();
+	for (size_t t = 0; t < pool.size(); t++)
+		pool[t].join();
+}
+
+#endif // PARALLEL_HPP
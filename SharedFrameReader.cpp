@@ -0,0 +1,128 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SharedFrameReader.hpp"
+
+
+SharedFrameReader::SharedFrameReader()
+{
+	_base = NULL;
+	_size = 0;
+	_header = NULL;
+}
+
+SharedFrameReader::~SharedFrameReader()
+{
+	close();
+}
+
+bool SharedFrameReader::open(const char *name)
+{
+	close();
+
+	std::string path = (name[0] == '/' ? name : std::string("/") + name);
+	int fd = shm_open(path.c_str(), O_RDONLY, 0);
+	if (fd == -1)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) == -1 || (size_t)st.st_size < 4096)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mem == MAP_FAILED)
+		return false;
+
+	_base = (const unsigned char *)mem;
+	_size = st.st_size;
+	_header = (const SharedRingHeader *)_base;
+
+	// The header comes from another process. Don't trust anything in
+	// it that we divide by or index with.
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (_header->magic != SHARED_FRAMES_MAGIC
+			|| _header->version != SHARED_FRAMES_VERSION
+			|| _header->slots == 0
+			|| _header->headerSize + _header->slotSize > _header->slotStride
+			|| sharedFramesSlotOffset(_header->slots, _header->slotStride)
+				> _size)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void SharedFrameReader::close()
+{
+	if (_base != NULL)
+		munmap((void *)_base, _size);
+
+	_base = NULL;
+	_header = NULL;
+	_size = 0;
+}
+
+uint64_t SharedFrameReader::published()
+{
+	if (_header == NULL)
+		return 0;
+	return _header->published.load(std::memory_order_acquire);
+}
+
+bool SharedFrameReader::latest(SharedFrameView& view)
+{
+	uint64_t frame = published();
+	if (frame == 0)
+		return false;
+
+	const unsigned char *at = _base + sharedFramesSlotOffset(
+			frame % _header->slots, _header->slotStride);
+	const SharedSlotHeader *slot = (const SharedSlotHeader *)at;
+
+	uint64_t seq = slot->seq.load(std::memory_order_acquire);
+	if (seq & 1)
+		return false;
+
+	view.meta = slot->meta;
+	view.pixels = at + _header->headerSize;
+	view.seq = seq;
+	view.slot = slot;
+
+	// The metadata must belong to this very frame.
+	return valid(view) && view.meta.frame == frame;
+}
+
+bool SharedFrameReader::valid(const SharedFrameView& view)
+{
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return view.slot->seq.load(std::memory_order_relaxed) == view.seq;
+}
@@ -0,0 +1,76 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SHAREDFRAMEREADER_HPP
+#define SHAREDFRAMEREADER_HPP
+
+#include <cstddef>
+
+#include "SharedFrames.hpp"
+
+// A frame in shared memory. pixels points directly into the ring; it
+// is not copied. The writer will eventually reuse the slot, so check
+// SharedFrameReader::valid() after you are done with the pixels (or
+// before trusting a copy you made of them).
+struct SharedFrameView
+{
+	const unsigned char *pixels;
+	SharedFrameMeta meta;
+	uint64_t seq;
+	const SharedSlotHeader *slot;
+};
+
+// Reading side of the frame export. Link against libtracershm.a.
+//
+//     SharedFrameReader r;
+//     r.open("tracer");
+//     SharedFrameView v;
+//     if (r.latest(v))
+//     {
+//         process(v.pixels, v.meta.width, v.meta.height);
+//         if (!r.valid(v))
+//             discard();
+//     }
+class SharedFrameReader
+{
+	private:
+		const unsigned char *_base;
+		size_t _size;
+		const SharedRingHeader *_header;
+
+	public:
+		SharedFrameReader();
+		~SharedFrameReader();
+
+		bool open(const char *name);
+		void close();
+
+		// Number of the latest published frame, zero if none.
+		uint64_t published();
+
+		// View of the latest frame. Returns false if there is none yet
+		// or if the writer got in the way (just try again).
+		bool latest(SharedFrameView& view);
+
+		// Still the same frame, not overwritten in the meantime?
+		bool valid(const SharedFrameView& view);
+};
+
+#endif // SHAREDFRAMEREADER_HPP
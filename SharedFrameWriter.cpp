@@ -0,0 +1,171 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "SharedFrameWriter.hpp"
+
+
+SharedFrameWriter::SharedFrameWriter()
+{
+	_base = NULL;
+	_size = 0;
+	_header = NULL;
+	_published = 0;
+}
+
+SharedFrameWriter::~SharedFrameWriter()
+{
+	close();
+}
+
+bool SharedFrameWriter::open(const std::string& name, int slots, int maxW,
+		int maxH)
+{
+	close();
+
+	// Every frame goes to slot "frame % slots".
+	if (slots < 1 || maxW < 1 || maxH < 1)
+	{
+		std::cerr << "Shared memory: Need at least one slot and a frame "
+			<< "size." << std::endl;
+		return false;
+	}
+
+	// POSIX wants a leading slash.
+	_name = (name[0] == '/' ? name : "/" + name);
+
+	int fd = shm_open(_name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+	if (fd == -1)
+	{
+		perror("shm_open");
+		return false;
+	}
+
+	uint64_t slotSize = (uint64_t)maxW * maxH * 4;
+	uint64_t slotStride = sizeof(SharedSlotHeader) + slotSize;
+	slotStride = (slotStride + 4095) & ~(uint64_t)4095;
+	_size = sharedFramesSlotOffset(slots, slotStride);
+
+	if (ftruncate(fd, _size) == -1)
+	{
+		perror("ftruncate");
+		::close(fd);
+		shm_unlink(_name.c_str());
+		return false;
+	}
+
+	void *mem = mmap(NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mem == MAP_FAILED)
+	{
+		perror("mmap");
+		shm_unlink(_name.c_str());
+		return false;
+	}
+
+	_base = (unsigned char *)mem;
+	_header = new (_base) SharedRingHeader;
+	_header->slots = slots;
+	_header->headerSize = sizeof(SharedSlotHeader);
+	_header->slotSize = slotSize;
+	_header->slotStride = slotStride;
+	_header->published.store(0);
+
+	for (int i = 0; i < slots; i++)
+	{
+		SharedSlotHeader *slot = new (_base
+				+ sharedFramesSlotOffset(i, slotStride)) SharedSlotHeader;
+		slot->seq.store(0);
+	}
+
+	// Readers check these last.
+	_header->version = SHARED_FRAMES_VERSION;
+	std::atomic_thread_fence(std::memory_order_release);
+	_header->magic = SHARED_FRAMES_MAGIC;
+
+	_published = 0;
+	std::cout << "Exporting frames to shared memory `" << _name << "', "
+		<< slots << " slots of up to " << maxW << "x" << maxH << "."
+		<< std::endl;
+	return true;
+}
+
+void SharedFrameWriter::close()
+{
+	if (_base == NULL)
+		return;
+
+	// Readers that still have it mapped keep their view.
+	munmap(_base, _size);
+	shm_unlink(_name.c_str());
+	_base = NULL;
+	_header = NULL;
+}
+
+void SharedFrameWriter::consume(const unsigned char *rgba, int w, int h,
+		const FrameInfo& info)
+{
+	if (_header == NULL)
+		return;
+
+	uint64_t size = (uint64_t)w * h * 4;
+	if (size > _header->slotSize)
+	{
+		std::cerr << "Shared memory: Frame " << w << "x" << h
+			<< " is too large, skipped." << std::endl;
+		return;
+	}
+
+	uint64_t frame = _published + 1;
+	uint32_t index = frame % _header->slots;
+	unsigned char *at = _base
+		+ sharedFramesSlotOffset(index, _header->slotStride);
+	SharedSlotHeader *slot = (SharedSlotHeader *)at;
+
+	// Sequence lock: Odd while writing.
+	uint64_t seq = slot->seq.load(std::memory_order_relaxed);
+	slot->seq.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	SharedFrameMeta &m = slot->meta;
+	m.frame = frame;
+	m.width = w;
+	m.height = h;
+	m.stride = w * 4;
+	m.format = SHARED_FRAMES_RGBA8;
+	memcpy(m.pos, info.pos, sizeof m.pos);
+	memcpy(m.rot, info.rot, sizeof m.rot);
+	m.fov = info.fov;
+	memcpy(m.user_params, info.user_params, sizeof m.user_params);
+
+	// The one and only copy: Straight from the mapped pixel buffer into
+	// shared memory.
+	memcpy(at + _header->headerSize, rgba, size);
+
+	slot->seq.store(seq + 2, std::memory_order_release);
+	_header->published.store(frame, std::memory_order_release);
+	_published = frame;
+}
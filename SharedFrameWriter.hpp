@@ -0,0 +1,54 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SHAREDFRAMEWRITER_HPP
+#define SHAREDFRAMEWRITER_HPP
+
+#include <string>
+
+#include "Capture.hpp"
+#include "SharedFrames.hpp"
+
+// Publishes captured frames in a POSIX shared memory ring. See
+// SharedFrames.hpp for the layout and SharedFrameReader for the other
+// side.
+class SharedFrameWriter : public FrameSink
+{
+	private:
+		std::string _name;
+		unsigned char *_base;
+		size_t _size;
+		SharedRingHeader *_header;
+		uint64_t _published;
+
+	public:
+		SharedFrameWriter();
+		~SharedFrameWriter();
+
+		// Room for "slots" frames of up to maxW x maxH pixels. Memory
+		// is only used once it has been touched.
+		bool open(const std::string& name, int slots, int maxW, int maxH);
+		void close();
+
+		void consume(const unsigned char *rgba, int w, int h,
+				const FrameInfo& info);
+};
+
+#endif // SHAREDFRAMEWRITER_HPP
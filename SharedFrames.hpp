@@ -0,0 +1,89 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SHAREDFRAMES_HPP
+#define SHAREDFRAMES_HPP
+
+#include <atomic>
+#include <cstdint>
+
+// Layout of the shared memory ring that frames are exported to. It is
+// shared between the tracer and the reader library, so keep it plain:
+// Fixed size types only, no pointers.
+//
+//     SharedRingHeader
+//     slot 0: SharedSlotHeader, pixels
+//     slot 1: SharedSlotHeader, pixels
+//     ...
+//
+// Each slot is guarded by a sequence lock. The writer makes seq odd,
+// writes the slot and makes it even again. Readers check that seq is
+// even and unchanged before and after looking at the data. The writer
+// never waits for anybody.
+
+#define SHARED_FRAMES_MAGIC 0x52545047  // "GPTR"
+#define SHARED_FRAMES_VERSION 1
+
+// Pixels are RGBA, 8 bit per channel, rows bottom to top.
+#define SHARED_FRAMES_RGBA8 1
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+		"Shared frames need lock-free 64 bit atomics.");
+
+struct SharedFrameMeta
+{
+	uint64_t frame;
+	int32_t width;
+	int32_t height;
+	int32_t stride;
+	int32_t format;
+	float pos[3];
+	float rot[16];
+	float fov;
+	float user_params[2][4];
+};
+
+struct SharedSlotHeader
+{
+	std::atomic<uint64_t> seq;
+	SharedFrameMeta meta;
+};
+
+struct SharedRingHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slots;
+	uint32_t headerSize;
+	uint64_t slotSize;
+	uint64_t slotStride;
+
+	// Sequence number of the most recently completed frame. Zero means
+	// nothing has been published yet.
+	std::atomic<uint64_t> published;
+};
+
+// Offset of the first slot. Slots are aligned to 4 KB.
+inline uint64_t sharedFramesSlotOffset(uint32_t slot, uint64_t slotStride)
+{
+	return 4096 + slot * slotStride;
+}
+
+#endif // SHAREDFRAMES_HPP
@@ -0,0 +1,152 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include "Sweep.hpp"
+
+
+bool Sweep::addDimension(const char *spec)
+{
+	SweepDimension d;
+
+	const char *eq = strchr(spec, '=');
+	if (eq == NULL)
+		return false;
+
+	d.name = std::string(spec, eq - spec);
+
+	// Accept "u0.x" as well as "user_params0.x".
+	std::string prefix;
+	if (d.name.compare(0, 11, "user_params") == 0)
+		prefix = d.name.substr(11);
+	else if (d.name.compare(0, 1, "u") == 0)
+		prefix = d.name.substr(1);
+	else
+		return false;
+
+	if (prefix.size() != 3 || prefix[1] != '.'
+			|| (prefix[0] != '0' && prefix[0] != '1'))
+		return false;
+
+	d.vec = prefix[0] - '0';
+
+	// GLSL swizzle names.
+	const char *sets[] = { "xyzw", "rgba", "stpq" };
+	d.component = -1;
+	for (int i = 0; i < 3 && d.component == -1; i++)
+	{
+		const char *at = strchr(sets[i], prefix[2]);
+		if (at != NULL)
+			d.component = at - sets[i];
+	}
+	if (d.component == -1)
+		return false;
+
+	std::string values(eq + 1);
+	if (values.find(':') != std::string::npos)
+	{
+		// Range: from:to:count
+		float from = 0, to = 0;
+		int count = 0;
+		if (sscanf(values.c_str(), "%f:%f:%d", &from, &to, &count) != 3
+				|| count < 1)
+			return false;
+
+		for (int i = 0; i < count; i++)
+		{
+			float t = (count > 1 ? i / (float)(count - 1) : 0);
+			d.values.push_back(from + t * (to - from));
+		}
+	}
+	else
+	{
+		// List: a,b,c
+		std::stringstream ss(values);
+		std::string item;
+		while (std::getline(ss, item, ','))
+		{
+			char *end = NULL;
+			float v = strtof(item.c_str(), &end);
+			if (end == item.c_str())
+				return false;
+			d.values.push_back(v);
+		}
+	}
+
+	if (d.values.empty())
+		return false;
+
+	_dims.push_back(d);
+	return true;
+}
+
+bool Sweep::empty()
+{
+	return _dims.empty();
+}
+
+int Sweep::variants()
+{
+	int n = 1;
+	for (size_t i = 0; i < _dims.size(); i++)
+		n *= _dims[i].values.size();
+	return n;
+}
+
+int Sweep::columns()
+{
+	return (_dims.empty() ? 1 : _dims.back().values.size());
+}
+
+int Sweep::rows()
+{
+	return variants() / columns();
+}
+
+void Sweep::apply(int i, float params[2][4])
+{
+	for (int k = _dims.size() - 1; k >= 0; k--)
+	{
+		SweepDimension &d = _dims[k];
+		int n = d.values.size();
+		params[d.vec][d.component] = d.values[i % n];
+		i /= n;
+	}
+}
+
+std::string Sweep::describe(int i)
+{
+	float params[2][4];
+	apply(i, params);
+
+	std::stringstream ss;
+	for (size_t k = 0; k < _dims.size(); k++)
+	{
+		if (k > 0)
+			ss << " ";
+		ss << _dims[k].name << "="
+			<< params[_dims[k].vec][_dims[k].component];
+	}
+	return ss.str();
+}
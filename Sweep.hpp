@@ -0,0 +1,61 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SWEEP_HPP
+#define SWEEP_HPP
+
+#include <string>
+#include <vector>
+
+// One swept component of the user parameters.
+struct SweepDimension
+{
+	std::string name;
+	int vec;
+	int component;
+	std::vector<float> values;
+};
+
+// Cartesian product of several user parameter components. The last
+// dimension varies fastest and is laid out horizontally on the contact
+// sheet.
+class Sweep
+{
+	private:
+		std::vector<SweepDimension> _dims;
+
+	public:
+		// Parse something like "u0.x=-1:1:5" (five values from -1 to
+		// 1) or "user_params1.s=4,6,8" (a list).
+		bool addDimension(const char *spec);
+
+		bool empty();
+		int variants();
+		int columns();
+		int rows();
+
+		// Write the values of variant i into params.
+		void apply(int i, float params[2][4]);
+
+		// Short description of variant i, e.g. "u0.x=0.5 u1.s=6".
+		std::string describe(int i);
+};
+
+#endif // SWEEP_HPP
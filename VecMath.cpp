@@ -487,6 +487,47 @@ Quat4::Quat4(Vec3 a, double r)
 	q[3] = a[2] * sinHPhi;
 }
 
+Quat4::Quat4(Mat4 m)
+{
+	// Inverse of makeRotate(). Pick the largest diagonal term to avoid
+	// dividing by something close to zero. See:
+	// http://www.euclideanspace.com/maths/geometry/rotations/conversions/matrixToQuaternion/
+	double trace = m[0] + m[5] + m[10];
+
+	if (trace > 0)
+	{
+		double s = 2 * sqrt(trace + 1);
+		q[0] = 0.25 * s;
+		q[1] = (m[6] - m[9]) / s;
+		q[2] = (m[8] - m[2]) / s;
+		q[3] = (m[1] - m[4]) / s;
+	}
+	else if (m[0] > m[5] && m[0] > m[10])
+	{
+		double s = 2 * sqrt(1 + m[0] - m[5] - m[10]);
+		q[0] = (m[6] - m[9]) / s;
+		q[1] = 0.25 * s;
+		q[2] = (m[1] + m[4]) / s;
+		q[3] = (m[8] + m[2]) / s;
+	}
+	else if (m[5] > m[10])
+	{
+		double s = 2 * sqrt(1 + m[5] - m[0] - m[10]);
+		q[0] = (m[8] - m[2]) / s;
+		q[1] = (m[1] + m[4]) / s;
+		q[2] = 0.25 * s;
+		q[3] = (m[6] + m[9]) / s;
+	}
+	else
+	{
+		double s = 2 * sqrt(1 + m[10] - m[0] - m[5]);
+		q[0] = (m[1] - m[4]) / s;
+		q[1] = (m[8] + m[2]) / s;
+		q[2] = (m[6] + m[9]) / s;
+		q[3] = 0.25 * s;
+	}
+}
+
 // Comparison
 bool Quat4::operator == (Quat4& p)
 {
@@ -564,6 +605,94 @@ Quat4 Quat4::operator * (Quat4& B)
 	return A;
 }
 
+// Addition, scalar operations, sign
+Quat4 Quat4::operator + (Quat4& B)
+{
+	return Quat4(q[0] + B[0], q[1] + B[1], q[2] + B[2], q[3] + B[3]);
+}
+
+Quat4 Quat4::operator * (double s)
+{
+	return Quat4(q[0] * s, q[1] * s, q[2] * s, q[3] * s);
+}
+
+Quat4 Quat4::operator - ()
+{
+	return Quat4(-q[0], -q[1], -q[2], -q[3]);
+}
+
+double Quat4::dot(Quat4& B)
+{
+	return q[0]*B[0] + q[1]*B[1] + q[2]*B[2] + q[3]*B[3];
+}
+
+// Unit quaternion algebra
+Quat4 Quat4::conjugated()
+{
+	// For unit quaternions, this is the inverse.
+	return Quat4(q[0], -q[1], -q[2], -q[3]);
+}
+
+Quat4 Quat4::log()
+{
+	// Only valid for unit quaternions: log(cos(t), v sin(t)) = (0, v t).
+	double vlen = sqrt(b()*b() + c()*c() + d()*d());
+	if (vlen < 1e-12)
+		return Quat4(0, 0, 0, 0);
+
+	double theta = atan2(vlen, a());
+	double s = theta / vlen;
+	return Quat4(0, b() * s, c() * s, d() * s);
+}
+
+Quat4 Quat4::exp()
+{
+	// Inverse of log(): Expects a pure quaternion (0, v t).
+	double theta = sqrt(b()*b() + c()*c() + d()*d());
+	if (theta < 1e-12)
+		return Quat4(1, 0, 0, 0);
+
+	double s = sin(theta) / theta;
+	return Quat4(cos(theta), b() * s, c() * s, d() * s);
+}
+
+Quat4 Quat4::slerp(Quat4& B, double t)
+{
+	// Spherical linear interpolation along the shortest arc. See:
+	// http://en.wikipedia.org/wiki/Slerp
+	Quat4 target = Quat4(&B);
+	double cosOmega = dot(B);
+	if (cosOmega < 0)
+	{
+		target = -B;
+		cosOmega = -cosOmega;
+	}
+
+	double wa, wb;
+	if (cosOmega > 0.9995)
+	{
+		// Nearly parallel, a linear blend is just as good and does not
+		// divide by sin(omega) = 0.
+		wa = 1 - t;
+		wb = t;
+	}
+	else
+	{
+		double omega = acos(cosOmega);
+		double sinOmega = sin(omega);
+		wa = sin((1 - t) * omega) / sinOmega;
+		wb = sin(t * omega) / sinOmega;
+	}
+
+	Quat4 R(
+			wa * q[0] + wb * target[0],
+			wa * q[1] + wb * target[1],
+			wa * q[2] + wb * target[2],
+			wa * q[3] + wb * target[3]);
+	R.normalize();
+	return R;
+}
+
 // Simple stuff
 void Quat4::makeIdentity()
 {
@@ -152,6 +152,7 @@ class Quat4
 		Quat4(Quat4 *o);
 		Quat4(double a, double b, double c, double d);
 		Quat4(Vec3 a, double r);
+		Quat4(Mat4 m);
 
 		// Comparison
 		bool operator == (Quat4& p);
@@ -173,6 +174,18 @@ class Quat4
 		Quat4& operator *= (Quat4& B);
 		Quat4 operator * (Quat4& B);
 
+		// Addition, scalar operations, sign
+		Quat4 operator + (Quat4& B);
+		Quat4 operator * (double s);
+		Quat4 operator - ();
+		double dot(Quat4& B);
+
+		// Unit quaternion algebra
+		Quat4 conjugated();
+		Quat4 log();
+		Quat4 exp();
+		Quat4 slerp(Quat4& B, double t);
+
 		// Simple stuff
 		void makeIdentity();
 		double length();
@@ -0,0 +1,339 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "VideoStream.hpp"
+
+
+// Fixed point coefficients, scaled by 2^14. See:
+// http://en.wikipedia.org/wiki/YCbCr#JPEG_conversion
+#define YUV_SHIFT 14
+#define YUV_ROUND (1 << (YUV_SHIFT - 1))
+
+static const int yR =  4899, yG =  9617, yB =  1868;
+static const int uR = -2765, uG = -5427, uB =  8192;
+static const int vR =  8192, vG = -6860, vB = -1332;
+
+static inline unsigned char clamp255(int x)
+{
+	return (x < 0 ? 0 : (x > 255 ? 255 : x));
+}
+
+static void lumaRowScalar(const unsigned char *src, unsigned char *dst,
+		int from, int to)
+{
+	for (int x = from; x < to; x++)
+	{
+		const unsigned char *p = src + x * 4;
+		dst[x] = clamp255((yR * p[0] + yG * p[1] + yB * p[2] + YUV_ROUND)
+				>> YUV_SHIFT);
+	}
+}
+
+static void chromaRowScalar(const unsigned char *s0,
+		const unsigned char *s1, unsigned char *u, unsigned char *v,
+		int from, int to)
+{
+	for (int x = from; x < to; x++)
+	{
+		const unsigned char *a = s0 + x * 8;
+		const unsigned char *b = s1 + x * 8;
+		int r = (a[0] + a[4] + b[0] + b[4] + 2) >> 2;
+		int g = (a[1] + a[5] + b[1] + b[5] + 2) >> 2;
+		int bl = (a[2] + a[6] + b[2] + b[6] + 2) >> 2;
+		u[x] = clamp255(((uR * r + uG * g + uB * bl + YUV_ROUND)
+					>> YUV_SHIFT) + 128);
+		v[x] = clamp255(((vR * r + vG * g + vB * bl + YUV_ROUND)
+					>> YUV_SHIFT) + 128);
+	}
+}
+
+#ifdef __SSE2__
+// Both operands hold two pixels as 16 bit (R, G, B, A). Returns the four
+// dot products with the coefficients as 32 bit integers.
+static inline __m128i dot4(__m128i a, __m128i b, __m128i coef)
+{
+	// madd gives (R*cR + G*cG, B*cB + 0) per pixel, add the halves.
+	__m128i ma = _mm_madd_epi16(a, coef);
+	__m128i mb = _mm_madd_epi16(b, coef);
+	ma = _mm_add_epi32(ma, _mm_shuffle_epi32(ma, _MM_SHUFFLE(2, 3, 0, 1)));
+	mb = _mm_add_epi32(mb, _mm_shuffle_epi32(mb, _MM_SHUFFLE(2, 3, 0, 1)));
+	ma = _mm_shuffle_epi32(ma, _MM_SHUFFLE(3, 1, 2, 0));
+	mb = _mm_shuffle_epi32(mb, _MM_SHUFFLE(3, 1, 2, 0));
+	return _mm_unpacklo_epi64(ma, mb);
+}
+
+static inline __m128i coefficients(int r, int g, int b)
+{
+	return _mm_setr_epi16(r, g, b, 0, r, g, b, 0);
+}
+
+static int lumaRowSSE2(const unsigned char *src, unsigned char *dst, int w)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i coef = coefficients(yR, yG, yB);
+	const __m128i round = _mm_set1_epi32(YUV_ROUND);
+
+	int x = 0;
+	for (; x + 8 <= w; x += 8)
+	{
+		__m128i p0 = _mm_loadu_si128((const __m128i *)(src + x * 4));
+		__m128i p1 = _mm_loadu_si128((const __m128i *)(src + x * 4 + 16));
+
+		__m128i y0 = dot4(_mm_unpacklo_epi8(p0, zero),
+				_mm_unpackhi_epi8(p0, zero), coef);
+		__m128i y1 = dot4(_mm_unpacklo_epi8(p1, zero),
+				_mm_unpackhi_epi8(p1, zero), coef);
+
+		y0 = _mm_srai_epi32(_mm_add_epi32(y0, round), YUV_SHIFT);
+		y1 = _mm_srai_epi32(_mm_add_epi32(y1, round), YUV_SHIFT);
+
+		__m128i y16 = _mm_packs_epi32(y0, y1);
+		_mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(y16, zero));
+	}
+	return x;
+}
+
+static int chromaRowSSE2(const unsigned char *s0, const unsigned char *s1,
+		unsigned char *u, unsigned char *v, int cw)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i two = _mm_set1_epi16(2);
+	const __m128i ucoef = coefficients(uR, uG, uB);
+	const __m128i vcoef = coefficients(vR, vG, vB);
+	const __m128i round = _mm_set1_epi32(YUV_ROUND);
+	const __m128i offset = _mm_set1_epi32(128);
+
+	// Four chroma samples (8x2 pixels) per iteration.
+	int x = 0;
+	for (; x + 4 <= cw; x += 4)
+	{
+		__m128i a0 = _mm_loadu_si128((const __m128i *)(s0 + x * 8));
+		__m128i a1 = _mm_loadu_si128((const __m128i *)(s0 + x * 8 + 16));
+		__m128i b0 = _mm_loadu_si128((const __m128i *)(s1 + x * 8));
+		__m128i b1 = _mm_loadu_si128((const __m128i *)(s1 + x * 8 + 16));
+
+		// Vertical sums, two pixels (one 2x2 block) per register.
+		__m128i q0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero),
+				_mm_unpacklo_epi8(b0, zero));
+		__m128i q1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero),
+				_mm_unpackhi_epi8(b0, zero));
+		__m128i q2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero),
+				_mm_unpacklo_epi8(b1, zero));
+		__m128i q3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero),
+				_mm_unpackhi_epi8(b1, zero));
+
+		// Horizontal sums end up in the lower four lanes.
+		q0 = _mm_add_epi16(q0, _mm_srli_si128(q0, 8));
+		q1 = _mm_add_epi16(q1, _mm_srli_si128(q1, 8));
+		q2 = _mm_add_epi16(q2, _mm_srli_si128(q2, 8));
+		q3 = _mm_add_epi16(q3, _mm_srli_si128(q3, 8));
+
+		// Averages, two blocks per register again.
+		__m128i m01 = _mm_srli_epi16(_mm_add_epi16(
+					_mm_unpacklo_epi64(q0, q1), two), 2);
+		__m128i m23 = _mm_srli_epi16(_mm_add_epi16(
+					_mm_unpacklo_epi64(q2, q3), two), 2);
+
+		__m128i cu = _mm_srai_epi32(_mm_add_epi32(
+					dot4(m01, m23, ucoef), round), YUV_SHIFT);
+		__m128i cv = _mm_srai_epi32(_mm_add_epi32(
+					dot4(m01, m23, vcoef), round), YUV_SHIFT);
+		cu = _mm_add_epi32(cu, offset);
+		cv = _mm_add_epi32(cv, offset);
+
+		__m128i c16 = _mm_packs_epi32(cu, cv);
+		__m128i c8 = _mm_packus_epi16(c16, zero);
+
+		int lanes[4];
+		_mm_storeu_si128((__m128i *)lanes, c8);
+		memcpy(u + x, &lanes[0], 4);
+		memcpy(v + x, &lanes[1], 4);
+	}
+	return x;
+}
+#endif
+
+void rgbaToYUV420(const unsigned char *rgba, int stride, int w, int h,
+		unsigned char *y, unsigned char *u, unsigned char *v)
+{
+	int cw = w / 2;
+
+	for (int row = 0; row < h; row += 2)
+	{
+		// Flip: The first output row is the last one in memory.
+		const unsigned char *s0 = rgba + (size_t)(h - 1 - row) * stride;
+		const unsigned char *s1 = rgba + (size_t)(h - 2 - row) * stride;
+		unsigned char *y0 = y + (size_t)row * w;
+		unsigned char *y1 = y0 + w;
+		unsigned char *cu = u + (size_t)(row / 2) * cw;
+		unsigned char *cv = v + (size_t)(row / 2) * cw;
+
+		int done0 = 0, done1 = 0, doneC = 0;
+#ifdef __SSE2__
+		done0 = lumaRowSSE2(s0, y0, w);
+		done1 = lumaRowSSE2(s1, y1, w);
+		doneC = chromaRowSSE2(s0, s1, cu, cv, cw);
+#endif
+		lumaRowScalar(s0, y0, done0, w);
+		lumaRowScalar(s1, y1, done1, w);
+		chromaRowScalar(s0, s1, cu, cv, doneC, cw);
+	}
+}
+
+
+VideoStream::VideoStream(int fps)
+	: _queue(4)
+{
+	_fp = NULL;
+	_fps = fps;
+	_w = 0;
+	_h = 0;
+	_failed = false;
+	_queued = 0;
+	_written = 0;
+}
+
+VideoStream::~VideoStream()
+{
+	finish();
+}
+
+bool VideoStream::open(const std::string& path)
+{
+	_path = path;
+
+	if (path == "-")
+	{
+		// Everything else that's printed goes to stderr from now on,
+		// stdout belongs to the video.
+		_fp = fdopen(dup(STDOUT_FILENO), "wb");
+		std::cout.rdbuf(std::cerr.rdbuf());
+	}
+	else
+		_fp = fopen(path.c_str(), "wb");
+
+	if (_fp == NULL)
+	{
+		std::cerr << "Could not open video stream `" << path << "'."
+			<< std::endl;
+		return false;
+	}
+
+	// A consumer going away must not kill us, fwrite() will fail
+	// instead.
+	signal(SIGPIPE, SIG_IGN);
+
+	_thread = std::thread(&VideoStream::run, this);
+	return true;
+}
+
+void VideoStream::consume(const unsigned char *rgba, int w, int h,
+		const FrameInfo& info)
+{
+	(void)info;
+
+	if (_fp == NULL || _failed)
+		return;
+
+	// The size is fixed by the first frame.
+	if (_queued == 0)
+	{
+		_w = w & ~1;
+		_h = h & ~1;
+	}
+	else if ((w & ~1) != _w || (h & ~1) != _h)
+	{
+		std::cerr << "Video: Skipping frame of different size." << std::endl;
+		return;
+	}
+	_queued++;
+
+	Job *job = new Job;
+	job->rgba.assign(rgba, rgba + (size_t)w * h * 4);
+	job->w = w;
+	job->h = h;
+
+	// Blocks if the writer is behind. That's the back-pressure.
+	_queue.push(job);
+}
+
+void VideoStream::run()
+{
+	std::vector<unsigned char> yuv;
+	bool headerWritten = false;
+	Job *job;
+
+	while (_queue.pop(job))
+	{
+		if (!_failed)
+		{
+			if (!headerWritten)
+			{
+				fprintf(_fp, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+						_w, _h, _fps);
+				headerWritten = true;
+			}
+
+			size_t ysize = (size_t)_w * _h;
+			yuv.resize(ysize * 3 / 2);
+
+			// Odd sizes are cropped: Skip the topmost row, which is the
+			// last one in memory.
+			rgbaToYUV420(&job->rgba[0], job->w * 4, _w, _h, &yuv[0],
+					&yuv[ysize], &yuv[ysize + ysize / 4]);
+
+			if (fputs("FRAME\n", _fp) < 0
+					|| fwrite(&yuv[0], 1, yuv.size(), _fp) != yuv.size())
+			{
+				std::cerr << "Video: Writing to `" << _path << "' failed, "
+					<< "stopping." << std::endl;
+				_failed = true;
+			}
+			else
+				_written++;
+		}
+
+		delete job;
+	}
+}
+
+void VideoStream::finish()
+{
+	_queue.close();
+	if (_thread.joinable())
+		_thread.join();
+
+	if (_fp != NULL)
+	{
+		fclose(_fp);
+		_fp = NULL;
+		std::cerr << "Video: " << _written << " frames written to `"
+			<< _path << "'." << std::endl;
+	}
+}
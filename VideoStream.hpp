@@ -0,0 +1,79 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef VIDEOSTREAM_HPP
+#define VIDEOSTREAM_HPP
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.hpp"
+#include "Capture.hpp"
+
+// Convert RGBA (rows bottom to top, as read from OpenGL) to planar
+// YUV 4:2:0 with full range BT.601 coefficients. w and h must be even.
+void rgbaToYUV420(const unsigned char *rgba, int stride, int w, int h,
+		unsigned char *y, unsigned char *u, unsigned char *v);
+
+// Writes captured frames as a YUV4MPEG2 stream to a file or to stdout,
+// e.g. to be piped into ffmpeg. Color conversion and writing run on a
+// separate thread. Only a few frames are queued: If the consumer can't
+// keep up, consume() blocks and thereby throttles the renderer.
+class VideoStream : public FrameSink
+{
+	private:
+		struct Job
+		{
+			std::vector<unsigned char> rgba;
+			int w;
+			int h;
+		};
+
+		FILE *_fp;
+		std::string _path;
+		int _fps;
+		int _w;
+		int _h;
+		std::atomic<bool> _failed;
+
+		// Frames handed to the writer thread, and frames it has
+		// actually written.
+		long _queued;
+		long _written;
+		BoundedQueue<Job *> _queue;
+		std::thread _thread;
+
+		void run();
+
+	public:
+		VideoStream(int fps);
+		~VideoStream();
+
+		// "-" means stdout.
+		bool open(const std::string& path);
+		void consume(const unsigned char *rgba, int w, int h,
+				const FrameInfo& info);
+		void finish();
+};
+
+#endif // VIDEOSTREAM_HPP
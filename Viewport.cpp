@@ -140,6 +140,29 @@ Mat4 Viewport::orientationMatrix()
 #endif
 }
 
+Quat4 Viewport::orientationQuat()
+{
+#ifdef MATRIX_ROTATION
+	return Quat4(ori());
+#else
+	return ori();
+#endif
+}
+
+void Viewport::setView(Vec3 p, Quat4 q, double f)
+{
+	// Used when playing back camera paths: Jump directly to the given
+	// configuration.
+#ifdef MATRIX_ROTATION
+	ori() = q.makeRotate();
+#else
+	ori() = q;
+	ori().normalize();
+#endif
+	pos() = p;
+	setFOV(f);
+}
+
 void Viewport::setInitialConfig(Vec3 p, double step, double initialfov)
 {
 	_initPos = p;
@@ -56,6 +56,8 @@ class Viewport
 		void rotateAroundAxis(int whichAxis, double degree);
 		void moveAlongAxis(int whichAxis, int dir, bool faster);
 		Mat4 orientationMatrix();
+		Quat4 orientationQuat();
+		void setView(Vec3 p, Quat4 q, double f);
 
 		void setInitialConfig(Vec3 p, double step, double initialfov);
 		void setSize(int w, int h);
@@ -0,0 +1,234 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "Wavefront.hpp"
+
+
+Wavefront::Wavefront()
+{
+	_program = 0;
+	_steps = 0;
+	_queues[0] = 0;
+	_queues[1] = 0;
+	_counters = 0;
+	_pixelSteps = 0;
+	_hits = 0;
+	_w = 0;
+	_h = 0;
+	_counting = false;
+	_dispatches = 0;
+	_busy = 0;
+}
+
+void Wavefront::setProgram(GLuint program)
+{
+	_program = program;
+}
+
+void Wavefront::setSteps(int steps)
+{
+	_steps = steps;
+}
+
+GLuint Wavefront::program()
+{
+	return _program;
+}
+
+int Wavefront::steps()
+{
+	return _steps;
+}
+
+bool Wavefront::enabled()
+{
+	return (_program != 0 && _steps > 0);
+}
+
+void Wavefront::resize(int w, int h)
+{
+	if (w == _w && h == _h)
+		return;
+
+	if (_hits == 0)
+	{
+		glGenTextures(1, &_hits);
+		glGenBuffers(2, _queues);
+		glGenBuffers(1, &_counters);
+		glGenBuffers(1, &_pixelSteps);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, _counters);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, 8 * sizeof (GLuint), NULL,
+				GL_DYNAMIC_COPY);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, _hits);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, w, h, 0, GL_RGBA, GL_FLOAT,
+			NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// Four words per ray, see shader_wavefront.glsl.
+	for (int i = 0; i < 2; i++)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, _queues[i]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER,
+				(size_t)w * h * 4 * sizeof (GLuint), NULL, GL_DYNAMIC_COPY);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, _pixelSteps);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)w * h * sizeof (GLuint),
+			NULL, GL_DYNAMIC_READ);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	_w = w;
+	_h = h;
+}
+
+void Wavefront::march(const GLint *region, float stepsize)
+{
+	glUseProgram(_program);
+	glUniform1i(glGetUniformLocation(_program, "chunk_steps"), _steps);
+	glUniform4iv(glGetUniformLocation(_program, "region"), 1, region);
+	glUniform2f(glGetUniformLocation(_program, "viewport_size"), _w, _h);
+	GLint handle_prepare = glGetUniformLocation(_program, "prepare_next");
+	GLint handle_first = glGetUniformLocation(_program, "first_chunk");
+
+	glBindImageTexture(0, _hits, 0, GL_FALSE, 0, GL_WRITE_ONLY,
+			GL_RGBA32F);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, _counters);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, _pixelSteps);
+
+	// The first dispatch takes whole tiles of 8x8 pixels. The kernel
+	// sizes the others, so there is no telling when all rays are done.
+	// But no ray takes more steps than fit in front of maxval (10 in
+	// shader_wavefront.glsl), the bisection counts as one, so that many
+	// chunks are queued. Those after the last ray have no groups.
+	GLuint tiles = ((region[2] + 7) / 8) * ((region[3] + 7) / 8);
+	GLuint counters[8] = { tiles, 1, 1, 0, 64 * tiles, 0, 0, 1 };
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, _counters);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof counters, counters);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, _counters);
+
+	int steps = (int)(10 / stepsize) + 2;
+	int chunks = (steps + _steps - 1) / _steps;
+	for (int k = 0; k < chunks; k++)
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _queues[0]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, _queues[1]);
+		glUniform1i(handle_prepare, 0);
+		glUniform1i(handle_first, (k == 0));
+		glDispatchComputeIndirect(0);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		glUniform1i(handle_prepare, 1);
+		glDispatchCompute(1, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT
+				| GL_COMMAND_BARRIER_BIT);
+
+		std::swap(_queues[0], _queues[1]);
+	}
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+	// Only for report(), once after all the work.
+	if (_counting)
+	{
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, _counters);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof counters,
+				counters);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		_dispatches = counters[7];
+		_busy = (counters[6] > 0 ? (double)counters[5] / counters[6] : 1);
+	}
+
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+GLuint Wavefront::hits()
+{
+	return _hits;
+}
+
+// Compares the kernel to fragments: How long the first frame takes and
+// how many lanes are busy on average. For fragments, that's estimated
+// from the steps of each ray: A group of 8x8 pixels takes as long as the
+// ray with the most steps.
+void Wavefront::report(void (*render)(void))
+{
+	typedef std::chrono::steady_clock Clock;
+
+	if (_program == 0)
+	{
+		std::cerr << "Wavefront: Off, see --wavefront." << std::endl;
+		return;
+	}
+
+	// The first round only warms up.
+	int steps = _steps;
+	double ms[3];
+	_counting = true;
+	for (int i = 0; i < 3; i++)
+	{
+		_steps = (i == 1 ? 0 : steps);
+		glFinish();
+		Clock::time_point start = Clock::now();
+		render();
+		glFinish();
+		ms[i] = std::chrono::duration<double>(Clock::now() - start)
+			.count() * 1000;
+	}
+	_steps = steps;
+	_counting = false;
+
+	std::vector<GLuint> pixelSteps((size_t)_w * _h);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, _pixelSteps);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+			pixelSteps.size() * sizeof (GLuint), pixelSteps.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	double done = 0;
+	double possible = 0;
+	for (int y0 = 0; y0 < _h; y0 += 8)
+		for (int x0 = 0; x0 < _w; x0 += 8)
+		{
+			GLuint longest = 0;
+			for (int y = y0; y < std::min(y0 + 8, _h); y++)
+				for (int x = x0; x < std::min(x0 + 8, _w); x++)
+				{
+					done += pixelSteps[y * _w + x];
+					longest = std::max(longest, pixelSteps[y * _w + x]);
+				}
+			possible += 64.0 * longest;
+		}
+
+	std::cout << "Wavefront: " << ms[2] << " ms in " << _dispatches
+		<< " dispatches of " << steps << " steps, "
+		<< (int)(100 * _busy + 0.5) << "% of the lanes busy."
+		<< std::endl << "Fragments: " << ms[1] << " ms, about "
+		<< (int)(100 * (possible > 0 ? done / possible : 1) + 0.5)
+		<< "% of the lanes busy in groups of 8x8 pixels." << std::endl;
+}
@@ -0,0 +1,82 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef WAVEFRONT_HPP
+#define WAVEFRONT_HPP
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+// Wavefront marching: The rays of the first pass march in a compute
+// shader instead of the fragment shader, a few steps per dispatch. Rays
+// that are done are packed out of the queue in between, so no thread
+// waits for the longest ray of its group for long. The hits end up in a
+// texture that the fragment shader only shades. See
+// shader_wavefront.glsl.
+class Wavefront
+{
+	private:
+		GLuint _program;
+		int _steps;
+
+		// Two queues of rays, the one being marched and the next. The
+		// counters are the indirect dispatch and the statistics.
+		GLuint _queues[2];
+		GLuint _counters;
+		GLuint _pixelSteps;
+		GLuint _hits;
+		int _w;
+		int _h;
+
+		// Of the last march() while reporting.
+		bool _counting;
+		int _dispatches;
+		double _busy;
+
+	public:
+		Wavefront();
+
+		// The kernel, built from shader_wavefront_final.glsl, and the
+		// number of steps per dispatch. 0 is off.
+		void setProgram(GLuint program);
+		void setSteps(int steps);
+		GLuint program();
+		int steps();
+		bool enabled();
+
+		// Buffers for a viewport of w x h pixels. Nothing happens if the
+		// size is still the same.
+		void resize(int w, int h);
+
+		// Marches the rays of region (x, y, width, height) with the
+		// kernel's uniforms that only the caller knows already set.
+		// Afterwards, hits() holds the normal and distance of each hit
+		// like out_geometry. No ray takes more steps than fit in front
+		// of maxval at the given step size.
+		void march(const GLint *region, float stepsize);
+		GLuint hits();
+
+		// Times one frame of render() with the kernel against one
+		// without and prints how many lanes are busy in both.
+		void report(void (*render)(void));
+};
+
+#endif // WAVEFRONT_HPP
@@ -0,0 +1,360 @@
+#!/bin/bash
+
+# Turns a scene of several ray marching objects into one object that
+# can be used like any other:
+#
+#     $ ./compose.sh objects/csg.scene scene_final.glsl
+#
+# run.sh does this for files ending in ".scene". Each object file is
+# included once, with its functions renamed by the preprocessor. See
+# README.md for the format of scenes.
+
+if (( $# != 2 ))
+then
+	echo "Usage: $0 SCENE OUT" >&2
+	exit 1
+fi
+
+SCENE=$1
+OUT=$2
+
+awk -v scene="$SCENE" '
+function fail(msg)
+{
+	printf "%s:%d: %s\n", scene, NR, msg > "/dev/stderr"
+	failed = 1
+	exit 1
+}
+
+# Float literals, like in the hand-written shaders. GLSL 1.50 would
+# convert integers next to floats, but between two literals, 1 / 2 is 0.
+function num(x)
+{
+	if (x > -1e-12 && x < 1e-12)
+		x = 0
+	x = sprintf("%.8g", x)
+	if (x !~ /[.e]/)
+		x = x ".0"
+	return x
+}
+
+function vec3(x, y, z)
+{
+	return "vec3(" num(x) ", " num(y) ", " num(z) ")"
+}
+
+# m = a * b, all 3x3, row major, indices 0 to 8.
+function mul(a, b, m,    i, j)
+{
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++)
+			m[3 * i + j] = a[3 * i] * b[j] + a[3 * i + 1] * b[3 + j] \
+				+ a[3 * i + 2] * b[6 + j]
+}
+
+function rotation(axis, deg, m,    c, s, i)
+{
+	c = cos(deg * pi / 180)
+	s = sin(deg * pi / 180)
+	for (i = 0; i < 9; i++)
+		m[i] = (i % 4 == 0)
+	if (axis == 0)
+	{
+		m[4] = c; m[5] = -s; m[7] = s; m[8] = c
+	}
+	else if (axis == 1)
+	{
+		m[0] = c; m[2] = s; m[6] = -s; m[8] = c
+	}
+	else
+	{
+		m[0] = c; m[1] = -s; m[3] = s; m[4] = c
+	}
+}
+
+# The inverse of a rotation is its transpose. GLSL wants columns, so
+# the rows of "m" are written out. With "absolute" set, the absolute
+# values, which map the extents of boxes.
+function inverse(m, absolute,    i, s, x)
+{
+	s = "mat3("
+	for (i = 0; i < 9; i++)
+	{
+		x = m[i]
+		if (absolute && x < 0)
+			x = -x
+		s = s num(x) (i < 8 ? ", " : ")")
+	}
+	return s
+}
+
+# Object coordinates of "p".
+function local(k, p,    q)
+{
+	q = p
+	if (moved[k])
+		q = "(" q " - " at[k] ")"
+	if (rotated[k])
+		q = rot[k] " * " q
+	if (scale[k] != 1)
+		q = q " / " num(scale[k])
+	return q
+}
+
+function scaled(k, v)
+{
+	return (scale[k] != 1 ? v " * " num(scale[k]) : v)
+}
+
+# Functions defined in an object file. They get renamed.
+function scan(k, path,    line, name, r)
+{
+	names[k] = ""
+	while ((r = getline line < path) > 0)
+		if (line ~ /^[a-z][a-z0-9]* +[A-Za-z_][A-Za-z0-9_]* *\(/)
+		{
+			sub(/^[a-z][a-z0-9]* +/, "", line)
+			sub(/ *\(.*/, "", line)
+			names[k] = names[k] " " line
+		}
+	close(path)
+
+	if (r < 0)
+		fail("Could not read `" path "\047.")
+	if (names[k] !~ / evalAt( |$)/)
+		fail("`" path "\047 has no evalAt(), only ray marching objects work.")
+}
+
+BEGIN {
+	pi = atan2(0, -1)
+	n = 0
+}
+
+/^[ \t]*(#|$)/ {
+	next
+}
+
+{
+	if ($1 != "union" && $1 != "intersect" && $1 != "subtract" \
+			&& $1 != "smooth")
+		fail("Unknown operator `" $1 "\047.")
+	if (NF < 2)
+		fail("Object missing.")
+
+	op[n] = $1
+	object[n] = $2
+	scan(n, $2)
+
+	x = y = z = 0
+	rx = ry = rz = 0
+	scale[n] = 1
+	bound[n] = 0
+	smooth[n] = 0.1
+	for (i = 3; i <= NF; )
+	{
+		if ($i == "at" && i + 3 <= NF)
+		{
+			x = $(i + 1); y = $(i + 2); z = $(i + 3)
+			i += 4
+		}
+		else if ($i == "rotate" && i + 3 <= NF)
+		{
+			rx = $(i + 1); ry = $(i + 2); rz = $(i + 3)
+			i += 4
+		}
+		else if ($i == "scale" && i + 1 <= NF)
+		{
+			scale[n] = $(i + 1) + 0
+			i += 2
+		}
+		else if ($i == "bound" && i + 1 <= NF)
+		{
+			bound[n] = $(i + 1) + 0
+			i += 2
+		}
+		else if ($i == "k" && i + 1 <= NF)
+		{
+			smooth[n] = $(i + 1) + 0
+			i += 2
+		}
+		else
+			fail("Unexpected `" $i "\047.")
+	}
+
+	if (scale[n] <= 0 || bound[n] < 0 || smooth[n] <= 0)
+		fail("Scale, bound and k have to be positive.")
+
+	at[n] = vec3(x, y, z)
+	moved[n] = (x != 0 || y != 0 || z != 0)
+
+	# Rotated about x first, then y, then z.
+	rotation(0, rx, a)
+	rotation(1, ry, b)
+	mul(b, a, c)
+	rotation(2, rz, a)
+	mul(a, c, m)
+	rotated[n] = (rx != 0 || ry != 0 || rz != 0)
+	rot[n] = inverse(m, 0)
+	extent[n] = inverse(m, 1)
+
+	n++
+}
+
+END {
+	if (failed)
+		exit 1
+	if (n == 0)
+	{
+		printf "%s: No objects.\n", scene > "/dev/stderr"
+		exit 1
+	}
+
+	print "// Generated by compose.sh from " scene ". Do not edit."
+	print ""
+	print "#include \"objects/lib/scene.glsl\""
+
+	for (k = 0; k < n; k++)
+	{
+		count = split(names[k], fn, " ")
+		print ""
+		for (i = 1; i <= count; i++)
+			print "#define " fn[i] " scene" k "_" fn[i]
+		print "#include \"" object[k] "\""
+		for (i = 1; i <= count; i++)
+			print "#undef " fn[i]
+		print "#ifndef OBJECT_INTERVAL"
+		print "#define SCENE_NO_INTERVAL"
+		print "#endif"
+		print "#undef OBJECT_INTERVAL"
+		print "#ifndef OBJECT_DISTANCE"
+		print "#define SCENE_NO_DISTANCE"
+		print "#endif"
+		print "#undef OBJECT_DISTANCE"
+		print "#undef OBJECT_MANDELBULB"
+	}
+
+	print ""
+	print "float evalAt(vec3 at)"
+	print "{"
+	print "\tfloat v;"
+	print "\tfloat f;"
+	for (k = 0; k < n; k++)
+	{
+		call = scaled(k, "scene" k "_evalAt(" local(k, "at") ")")
+
+		print ""
+		print "\t// " (k == 0 ? "" : op[k] " ") object[k]
+		if (bound[k] > 0)
+		{
+			print "\tf = SCENE_FAR;"
+			print "\tif (sceneInside(at, " at[k] ", " num(bound[k]) "))"
+			print "\t\tf = " call ";"
+		}
+		else
+			print "\tf = " call ";"
+
+		if (k == 0)
+			print "\tv = f;"
+		else if (op[k] == "smooth")
+			print "\tv = sceneSmooth(v, f, " num(smooth[k]) ");"
+		else
+			print "\tv = scene" toupper(substr(op[k], 1, 1)) \
+				substr(op[k], 2) "(v, f);"
+	}
+	print ""
+	print "\treturn v;"
+	print "}"
+
+	print ""
+	print "#ifndef SCENE_NO_DISTANCE"
+	print "#define OBJECT_DISTANCE"
+	print ""
+	print "float distanceAt(vec3 at)"
+	print "{"
+	print "\tfloat v;"
+	print "\tfloat f;"
+	for (k = 0; k < n; k++)
+	{
+		call = scaled(k, "scene" k "_distanceAt(" local(k, "at") ")")
+
+		print ""
+		print "\t// " (k == 0 ? "" : op[k] " ") object[k]
+		if (bound[k] > 0)
+		{
+			print "\tf = sceneBound(at, " at[k] ", " num(bound[k]) ");"
+			print "\tif (f < " num(bound[k]) ")"
+			print "\t\tf = max(f, " call ");"
+		}
+		else
+			print "\tf = " call ";"
+
+		if (k == 0)
+			print "\tv = f;"
+		else if (op[k] == "smooth")
+			print "\tv = sceneSmooth(v, f, " num(smooth[k]) ");"
+		else
+			print "\tv = scene" toupper(substr(op[k], 1, 1)) \
+				substr(op[k], 2) "(v, f);"
+	}
+	print ""
+	print "\treturn v;"
+	print "}"
+	print ""
+	print "#endif"
+
+	print ""
+	print "#ifndef SCENE_NO_INTERVAL"
+	print "#define OBJECT_INTERVAL"
+	print ""
+	print "vec2 evalInterval(vec3 lo, vec3 hi)"
+	print "{"
+	print "\tvec3 c = 0.5 * (lo + hi);"
+	print "\tvec3 e = 0.5 * (hi - lo);"
+	print "\tvec3 qc;"
+	print "\tvec3 qe;"
+	print "\tfloat part;"
+	print "\tvec2 v;"
+	print "\tvec2 f;"
+	for (k = 0; k < n; k++)
+	{
+		qe = "e"
+		if (rotated[k])
+			qe = extent[k] " * " qe
+		if (scale[k] != 1)
+			qe = qe " / " num(scale[k])
+		call = "scene" k "_evalInterval(qc - qe, qc + qe)"
+		if (scale[k] != 1)
+			call = "iscale(" num(scale[k]) ", " call ")"
+
+		print ""
+		print "\t// " (k == 0 ? "" : op[k] " ") object[k]
+		print "\tqc = " local(k, "c") ";"
+		print "\tqe = " qe ";"
+		if (bound[k] > 0)
+		{
+			print "\tf = vec2(SCENE_FAR);"
+			print "\tpart = isceneInside(lo, hi, " at[k] ", " \
+				num(bound[k]) ");"
+			print "\tif (part > 0.0)"
+			print "\t\tf = " call ";"
+			print "\tif (part > 0.0 && part < 1.0)"
+			print "\t\tf = iscenePart(f);"
+		}
+		else
+			print "\tf = " call ";"
+
+		if (k == 0)
+			print "\tv = f;"
+		else if (op[k] == "smooth")
+			print "\tv = isceneSmooth(v, f, " num(smooth[k]) ");"
+		else
+			print "\tv = iscene" toupper(substr(op[k], 1, 1)) \
+				substr(op[k], 2) "(v, f);"
+	}
+	print ""
+	print "\treturn v;"
+	print "}"
+	print ""
+	print "#endif"
+}
+' "$SCENE" > "$OUT" || { rm -f "$OUT"; exit 1; }
@@ -0,0 +1,194 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Spheres, boxes and capsules loaded with --instances. Rays walk
+// through the cells of the grid with a 3D-DDA and only test the
+// instances of the cells they pass. They stop in the first cell that
+// contains a hit.
+
+#include "lib/instances.glsl"
+
+// Shadow rays use getIntersection() as well, see lib/shadows.glsl.
+#define OBJECT_DIRECT
+
+float hitSphere(vec3 c, float r, vec3 orig, vec3 dir, float tmin,
+	out vec3 normal)
+{
+	vec3 oc = orig - c;
+	float b = dot(oc, dir);
+	float h = b * b - dot(oc, oc) + r * r;
+	if (h < 0.0)
+		return 1e30;
+
+	h = sqrt(h);
+	float t = -b - h;
+	if (t <= tmin)
+		t = -b + h;
+	normal = orig + t * dir - c;
+	return (t > tmin ? t : 1e30);
+}
+
+float hitBox(vec3 c, vec3 extent, vec3 orig, vec3 inv, float tmin,
+	out vec3 normal)
+{
+	vec3 t0 = (c - extent - orig) * inv;
+	vec3 t1 = (c + extent - orig) * inv;
+	vec3 near = min(t0, t1);
+	vec3 far = max(t0, t1);
+	float a = max(max(near.x, near.y), near.z);
+	float b = min(min(far.x, far.y), far.z);
+	if (a > b)
+		return 1e30;
+
+	// The normal is along the axis of the slab that was entered last
+	// (or is left first).
+	if (a > tmin)
+	{
+		normal = -sign(inv) * step(near.yzx, near) * step(near.zxy, near);
+		return a;
+	}
+	if (b > tmin)
+	{
+		normal = sign(inv) * step(far, far.yzx) * step(far, far.zxy);
+		return b;
+	}
+	return 1e30;
+}
+
+float hitCapsule(vec3 pa, vec3 pb, float r, vec3 orig, vec3 dir,
+	float tmin, out vec3 normal)
+{
+	// Infinite cylinder first, then the caps. See:
+	// http://iquilezles.org/articles/intersectors
+	vec3 ba = pb - pa;
+	vec3 oa = orig - pa;
+	float baba = dot(ba, ba);
+	float bard = dot(ba, dir);
+	float baoa = dot(ba, oa);
+	float rdoa = dot(dir, oa);
+	float oaoa = dot(oa, oa);
+
+	float a = baba - bard * bard;
+	float b = baba * rdoa - baoa * bard;
+	float c = baba * oaoa - baoa * baoa - r * r * baba;
+	float h = b * b - a * c;
+	float t = 1e30;
+	if (h >= 0.0)
+	{
+		t = (-b - sqrt(h)) / a;
+		float y = baoa + t * bard;
+		if (y <= 0.0 || y >= baba)
+		{
+			vec3 oc = (y <= 0.0 ? oa : orig - pb);
+			b = dot(dir, oc);
+			h = b * b - dot(oc, oc) + r * r;
+			t = (h > 0.0 ? -b - sqrt(h) : 1e30);
+		}
+	}
+	if (t <= tmin)
+		return 1e30;
+
+	vec3 pa_hit = orig + t * dir - pa;
+	normal = pa_hit - ba * clamp(dot(pa_hit, ba) / baba, 0.0, 1.0);
+	return t;
+}
+
+bool getIntersection(in vec3 orig, in vec3 dir, inout vec3 hitpoint,
+	inout vec3 normal)
+{
+	if (grid_res.x == 0.0)
+		return false;
+
+	// Axis parallel rays never step along those axes.
+	vec3 inv = 1.0 / (dir + vec3(equal(dir, vec3(0.0))) * 1e-20);
+
+	vec3 t0 = (grid_lo - orig) * inv;
+	vec3 t1 = (grid_lo + grid_res * grid_cell - orig) * inv;
+	vec3 near = min(t0, t1);
+	vec3 far = max(t0, t1);
+	float tenter = max(max(near.x, near.y), max(near.z, ray_start));
+	float texit = min(min(far.x, far.y), far.z);
+	if (tenter > texit)
+		return false;
+
+	vec3 cell = clamp(floor((orig + tenter * dir - grid_lo) / grid_cell),
+			vec3(0.0), grid_res - 1.0);
+	vec3 stp = sign(inv);
+	vec3 tnext = (grid_lo + (cell + max(stp, 0.0)) * grid_cell - orig) * inv;
+	vec3 delta = abs(grid_cell * inv);
+
+	float best = 1e30;
+	while (true)
+	{
+		ivec2 range = instanceCell(cell);
+		for (int k = range.x; k < range.x + range.y; k++)
+		{
+			vec4 p, q;
+			instanceData(instanceRef(k), p, q);
+
+			vec3 n;
+			float t;
+			if (q.w == INSTANCE_SPHERE)
+				t = hitSphere(p.xyz, p.w, orig, dir, ray_start, n);
+			else if (q.w == INSTANCE_BOX)
+				t = hitBox(p.xyz, q.xyz, orig, inv, ray_start, n);
+			else
+				t = hitCapsule(p.xyz, q.xyz, p.w, orig, dir, ray_start, n);
+
+			if (t < best)
+			{
+				best = t;
+				normal = n;
+			}
+		}
+
+		// Instances reach into other cells. A hit behind this cell may
+		// not be the nearest one yet.
+		float leave = min(min(tnext.x, tnext.y), tnext.z);
+		if (best <= leave)
+			break;
+
+		if (tnext.x <= tnext.y && tnext.x <= tnext.z)
+		{
+			cell.x += stp.x;
+			tnext.x += delta.x;
+		}
+		else if (tnext.y <= tnext.z)
+		{
+			cell.y += stp.y;
+			tnext.y += delta.y;
+		}
+		else
+		{
+			cell.z += stp.z;
+			tnext.z += delta.z;
+		}
+
+		if (outsideGrid(cell))
+			break;
+	}
+
+	if (best == 1e30)
+		return false;
+
+	hitpoint = orig + best * dir;
+	normal = normalize(normal);
+	return true;
+}
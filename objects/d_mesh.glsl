@@ -0,0 +1,176 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Triangle mesh loaded with --model. The tracer builds a bounding
+// volume hierarchy (see Bvh.hpp) and uploads it as three textures:
+//
+//   bvh_nodes:     4 float texels per inner node, the boxes of both
+//                  children: lo, hi, lo, hi
+//   bvh_children:  1 unsigned texel per inner node:
+//                  (ref, count, ref, count)
+//   bvh_triangles: 3 float texels per triangle: v0, v1 - v0, v2 - v0
+//
+// An inner child has count 0 and ref is the index of its node. A leaf
+// covers triangles ref to ref + count - 1.
+
+#include "lib/texels.glsl"
+
+// Shadow rays use getIntersection() as well, see lib/shadows.glsl.
+#define OBJECT_DIRECT
+
+uniform sampler2D bvh_nodes;
+uniform usampler2D bvh_children;
+uniform sampler2D bvh_triangles;
+
+// Must be at least BVH_MAX_DEPTH.
+#define BVH_STACK 48
+
+// Distance to the box along the ray, or "tmax" if there's no hit in
+// between.
+float bvhBox(vec3 lo, vec3 hi, vec3 orig, vec3 inv, float tmin, float tmax)
+{
+	vec3 t0 = (lo - orig) * inv;
+	vec3 t1 = (hi - orig) * inv;
+	vec3 near = min(t0, t1);
+	vec3 far = max(t0, t1);
+	float a = max(max(near.x, near.y), max(near.z, tmin));
+	float b = min(min(far.x, far.y), min(far.z, tmax));
+	return (a <= b ? a : tmax);
+}
+
+void bvhLeaf(int first, int count, vec3 orig, vec3 dir, float tmin,
+	inout float best, inout vec3 normal)
+{
+	for (int i = first; i < first + count; i++)
+	{
+		// Moeller-Trumbore.
+		vec3 v0 = dataTexel(bvh_triangles, 3 * i).xyz;
+		vec3 e1 = dataTexel(bvh_triangles, 3 * i + 1).xyz;
+		vec3 e2 = dataTexel(bvh_triangles, 3 * i + 2).xyz;
+
+		vec3 p = cross(dir, e2);
+		float det = dot(e1, p);
+		if (det == 0.0)
+			continue;
+
+		float inv = 1.0 / det;
+		vec3 s = orig - v0;
+		float u = dot(s, p) * inv;
+		if (u < 0.0 || u > 1.0)
+			continue;
+
+		vec3 q = cross(s, e1);
+		float v = dot(dir, q) * inv;
+		if (v < 0.0 || u + v > 1.0)
+			continue;
+
+		float t = dot(e2, q) * inv;
+		if (t > tmin && t < best)
+		{
+			best = t;
+			normal = cross(e1, e2);
+		}
+	}
+}
+
+bool getIntersection(in vec3 orig, in vec3 dir, inout vec3 hitpoint,
+	inout vec3 normal)
+{
+	// Same traversal as Bvh::intersect(): Leaves are tested right away,
+	// of two inner children the nearer one is visited first and the
+	// other one waits on the stack.
+	int stackNode[BVH_STACK];
+	float stackT[BVH_STACK];
+	int sp = 0;
+
+	vec3 inv = 1.0 / dir;
+	float tmin = ray_start;
+	float tmax = 1e30;
+	float best = tmax;
+	int node = 0;
+
+	while (node >= 0)
+	{
+		vec3 lo0 = dataTexel(bvh_nodes, 4 * node).xyz;
+		vec3 hi0 = dataTexel(bvh_nodes, 4 * node + 1).xyz;
+		vec3 lo1 = dataTexel(bvh_nodes, 4 * node + 2).xyz;
+		vec3 hi1 = dataTexel(bvh_nodes, 4 * node + 3).xyz;
+		ivec4 child = ivec4(dataTexelU(bvh_children, node));
+
+		float t0 = bvhBox(lo0, hi0, orig, inv, tmin, best);
+		float t1 = bvhBox(lo1, hi1, orig, inv, tmin, best);
+
+		// Nearer child into slot 0.
+		if (t1 < t0)
+		{
+			child = child.zwxy;
+			float tt = t0;
+			t0 = t1;
+			t1 = tt;
+		}
+
+		if (child.y > 0 && t0 < best)
+			bvhLeaf(child.x, child.y, orig, dir, tmin, best, normal);
+		if (child.w > 0 && t1 < best)
+			bvhLeaf(child.z, child.w, orig, dir, tmin, best, normal);
+
+		bool go0 = (child.y == 0 && t0 < best);
+		bool go1 = (child.w == 0 && t1 < best);
+
+		if (go0 && go1)
+		{
+			stackNode[sp] = child.z;
+			stackT[sp] = t1;
+			sp++;
+			node = child.x;
+		}
+		else if (go0)
+		{
+			node = child.x;
+		}
+		else if (go1)
+		{
+			node = child.z;
+		}
+		else
+		{
+			node = -1;
+			while (sp > 0)
+			{
+				sp--;
+				if (stackT[sp] < best)
+				{
+					node = stackNode[sp];
+					break;
+				}
+			}
+		}
+	}
+
+	if (best == tmax)
+		return false;
+
+	// Both sides of the triangles are lit.
+	hitpoint = orig + best * dir;
+	normal = normalize(normal);
+	if (dot(normal, dir) > 0.0)
+		normal = -normal;
+	return true;
+}
@@ -18,6 +18,9 @@
 */
 
 
+// Shadow rays use getIntersection() as well, see lib/shadows.glsl.
+#define OBJECT_DIRECT
+
 bool getIntersection(in vec3 orig, in vec3 dir, inout vec3 hitpoint,
 	inout vec3 normal)
 {
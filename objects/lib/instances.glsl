@@ -0,0 +1,77 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef LIB_INSTANCES_GLSL
+#define LIB_INSTANCES_GLSL
+
+// Primitives loaded with --instances. The tracer sorts them into a
+// uniform grid (see Instances.hpp) and uploads three textures:
+//
+//   instance_data:  2 float texels per instance, see struct Instance
+//   instance_cells: 1 unsigned texel per cell, x fastest:
+//                   (first, count, 0, 0)
+//   instance_refs:  4 unsigned references per texel, indices of
+//                   instances
+//
+// Each cell refers to all instances whose bounding boxes overlap it.
+
+#include "texels.glsl"
+
+uniform sampler2D instance_data;
+uniform usampler2D instance_cells;
+uniform usampler2D instance_refs;
+
+// grid_res is 0 if there are no instances.
+uniform vec3 grid_lo;
+uniform vec3 grid_cell;
+uniform vec3 grid_res;
+
+#define INSTANCE_SPHERE 0.0
+#define INSTANCE_BOX 1.0
+#define INSTANCE_CAPSULE 2.0
+
+bool outsideGrid(vec3 cell)
+{
+	return any(lessThan(cell, vec3(0.0)))
+		|| any(greaterThanEqual(cell, grid_res));
+}
+
+// First reference and number of references of a cell.
+ivec2 instanceCell(vec3 cell)
+{
+	ivec3 c = ivec3(cell);
+	ivec3 res = ivec3(grid_res);
+	return ivec2(dataTexelU(instance_cells,
+				c.x + res.x * (c.y + res.y * c.z)).xy);
+}
+
+// Index of the instance that reference k points to.
+int instanceRef(int k)
+{
+	return int(dataTexelU(instance_refs, k / 4)[k % 4]);
+}
+
+void instanceData(int id, out vec4 p, out vec4 q)
+{
+	p = dataTexel(instance_data, 2 * id);
+	q = dataTexel(instance_data, 2 * id + 1);
+}
+
+#endif // LIB_INSTANCES_GLSL
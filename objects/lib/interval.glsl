@@ -0,0 +1,72 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef LIB_INTERVAL_GLSL
+#define LIB_INTERVAL_GLSL
+
+// Interval arithmetic for evalInterval(). An interval is a vec2 with
+// the lower bound in x and the upper bound in y. All results contain
+// every value the operation can take for arguments from the intervals
+// (up to rounding, there's no control over that in GLSL).
+
+vec2 iconst(float a)
+{
+	return vec2(a, a);
+}
+
+vec2 iadd(vec2 a, vec2 b)
+{
+	return a + b;
+}
+
+vec2 isub(vec2 a, vec2 b)
+{
+	return a - b.yx;
+}
+
+vec2 iscale(float s, vec2 a)
+{
+	return (s >= 0.0 ? s * a : s * a.yx);
+}
+
+vec2 imul(vec2 a, vec2 b)
+{
+	vec4 p = vec4(a.x * b.x, a.x * b.y, a.y * b.x, a.y * b.y);
+	return vec2(min(min(p.x, p.y), min(p.z, p.w)),
+		max(max(p.x, p.y), max(p.z, p.w)));
+}
+
+vec2 isqr(vec2 a)
+{
+	// Unlike imul(a, a), this knows that both factors are the same.
+	if (a.x >= 0.0)
+		return a * a;
+	if (a.y <= 0.0)
+		return a.yx * a.yx;
+	return vec2(0.0, max(a.x * a.x, a.y * a.y));
+}
+
+vec2 icube(vec2 a)
+{
+	// Monotonic.
+	return a * a * a;
+}
+
+#endif // LIB_INTERVAL_GLSL
@@ -0,0 +1,90 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef LIB_LIGHTS_GLSL
+#define LIB_LIGHTS_GLSL
+
+// Lights loaded with --lights, three texels each, see struct Light in
+// Lights.hpp. Point and spot lights fade out to zero at their radius,
+// so they can be skipped wherever they are farther away than that.
+//
+// With LIGHT_SHADOWS defined, lights cast shadows. shadow() has to be
+// defined later on, see shadows.glsl.
+
+#include "texels.glsl"
+
+uniform sampler2D light_data;
+uniform int light_count;
+
+#define LIGHT_POINT 0.0
+#define LIGHT_SPOT 1.0
+#define LIGHT_DIRECTIONAL 2.0
+#define LIGHT_NO_SHADOW 4.0
+
+#ifdef LIGHT_SHADOWS
+float shadow(vec3 at, vec3 facing, vec3 dir, float len);
+#endif
+
+// Phong shading with light i, the same as for the two built-in lights.
+vec3 listLight(int i, vec3 hitpoint, vec3 normal, vec3 eye_dir,
+	vec3 diffuse, float shininess)
+{
+	vec4 p = dataTexel(light_data, 3 * i);
+	vec4 c = dataTexel(light_data, 3 * i + 1);
+	float type = mod(c.w, LIGHT_NO_SHADOW);
+
+	vec3 light_dir = -p.xyz;
+	float len = 1e30;
+	float falloff = 1.0;
+	if (type != LIGHT_DIRECTIONAL)
+	{
+		vec3 to = p.xyz - hitpoint;
+		float d = dot(to, to) / (p.w * p.w);
+		if (d >= 1.0)
+			return vec3(0.0);
+
+		falloff = (1.0 - d) * (1.0 - d);
+		len = length(to);
+		light_dir = to / len;
+
+		if (type == LIGHT_SPOT)
+		{
+			// The edge of the cone is soft.
+			vec4 s = dataTexel(light_data, 3 * i + 2);
+			falloff *= smoothstep(s.w, mix(s.w, 1.0, 0.2),
+					dot(-light_dir, s.xyz));
+		}
+	}
+
+#ifdef LIGHT_SHADOWS
+	// Lights behind the surface as seen from the eye are always in
+	// shadow, no need to look for occluders.
+	vec3 facing = faceforward(normal, -eye_dir, normal);
+	if (c.w < LIGHT_NO_SHADOW && falloff > 0.0)
+		falloff *= (dot(light_dir, facing) > 0.0
+				? shadow(hitpoint, facing, light_dir, len) : 0.0);
+#endif
+
+	float lit = max(dot(light_dir, normal), 0.0);
+	float specular = max(dot(reflect(-light_dir, normal), eye_dir), 0.0);
+	return falloff * c.rgb * (lit * diffuse + pow(specular, shininess));
+}
+
+#endif // LIB_LIGHTS_GLSL
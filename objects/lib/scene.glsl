@@ -0,0 +1,113 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef LIB_SCENE_GLSL
+#define LIB_SCENE_GLSL
+
+// Operators for scenes of several objects, see compose.sh. Only the
+// sign of evalAt() counts, so the regular operators work for any
+// implicit function. The smooth union blends over a range of k in
+// values of evalAt(), which is a distance only for some objects. The
+// same operators combine distanceAt() of objects that have it.
+
+#include "interval.glsl"
+
+// Objects are only evaluated inside of their bounding spheres. Outside,
+// they are far away.
+#define SCENE_FAR 1e10
+
+bool sceneInside(vec3 at, vec3 center, float radius)
+{
+	vec3 d = at - center;
+	return dot(d, d) < radius * radius;
+}
+
+// Distance to the bounding sphere. The object is at least that far
+// away. Close to the sphere, that's a poor estimate for soft shadows, so
+// distanceAt() asks the object as well there.
+float sceneBound(vec3 at, vec3 center, float radius)
+{
+	return length(at - center) - radius;
+}
+
+float sceneUnion(float a, float b)
+{
+	return min(a, b);
+}
+
+float sceneIntersect(float a, float b)
+{
+	return max(a, b);
+}
+
+float sceneSubtract(float a, float b)
+{
+	return max(a, -b);
+}
+
+float sceneSmooth(float a, float b, float k)
+{
+	// Polynomial smooth minimum: Never more than k / 4 below min().
+	float h = max(k - abs(a - b), 0.0) / k;
+	return min(a, b) - h * h * k * 0.25;
+}
+
+// The same for intervals, see evalInterval().
+
+// 0: The box misses the sphere, 1: it's completely inside, 0.5: both.
+float isceneInside(vec3 lo, vec3 hi, vec3 center, float radius)
+{
+	vec3 near = clamp(center, lo, hi) - center;
+	vec3 far = max(abs(lo - center), abs(hi - center));
+	if (dot(near, near) >= radius * radius)
+		return 0.0;
+	if (dot(far, far) < radius * radius)
+		return 1.0;
+	return 0.5;
+}
+
+// The object on a box that is only partly inside of its bound.
+vec2 iscenePart(vec2 a)
+{
+	return vec2(a.x, SCENE_FAR);
+}
+
+vec2 isceneUnion(vec2 a, vec2 b)
+{
+	return min(a, b);
+}
+
+vec2 isceneIntersect(vec2 a, vec2 b)
+{
+	return max(a, b);
+}
+
+vec2 isceneSubtract(vec2 a, vec2 b)
+{
+	return max(a, -b.yx);
+}
+
+vec2 isceneSmooth(vec2 a, vec2 b, float k)
+{
+	vec2 m = min(a, b);
+	return vec2(m.x - k * 0.25, m.y);
+}
+
+#endif // LIB_SCENE_GLSL
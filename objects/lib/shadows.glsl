@@ -0,0 +1,103 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef LIB_SHADOWS_GLSL
+#define LIB_SHADOWS_GLSL
+
+// Shadow rays, included after the object. How they march depends on
+// what the object offers:
+//
+//   OBJECT_DIRECT:   One ray with getIntersection(), hard shadows.
+//   OBJECT_DISTANCE: Sphere tracing with distanceAt(). How close the
+//                    ray passes by the object gives soft shadows.
+//   anything else:   Samples of evalAt() at coarse steps, stretched so
+//                    that shadow_budget of them reach the light. Hard
+//                    shadows, thin parts may be missed.
+//
+// Rays stop at the first occluder. Marching rays evaluate the object at
+// most shadow_budget times and count as lit if they run out. A budget
+// of 0 turns shadows off.
+
+uniform float shadow_budget;
+uniform float shadow_step;
+uniform float shadow_offset;
+uniform float shadow_soft;
+
+// Directional lights are looked for this far, as far as the marchers
+// look for hits.
+#define SHADOW_FAR 10.0
+
+// How much of a light in direction "dir" and at distance "len" reaches
+// "at", from 0 to 1. "facing" is the normal, turned towards the eye.
+// Hits are only as exact as the accuracy of the marcher, so rays start
+// shadow_offset (twice that) above the surface. Sphere tracing counts
+// as a hit only well below that.
+float shadow(vec3 at, vec3 facing, vec3 dir, float len)
+{
+	if (shadow_budget < 1.0)
+		return 1.0;
+
+	vec3 orig = at + shadow_offset * facing;
+	len = min(len, SHADOW_FAR);
+
+#if defined(OBJECT_DIRECT)
+	// Not the start of the primary ray, see shader_fragment.glsl.
+	float start = ray_start;
+	ray_start = 0.0;
+
+	vec3 hitpoint;
+	vec3 normal;
+	bool hit = getIntersection(orig, dir, hitpoint, normal)
+		&& distance(orig, hitpoint) < len;
+
+	ray_start = start;
+	return (hit ? 0.0 : 1.0);
+#elif defined(OBJECT_DISTANCE)
+	float lit = 1.0;
+	float t = 0.0;
+	for (float i = 0.0; i < shadow_budget; i += 1.0)
+	{
+		float d = distanceAt(orig + t * dir);
+		if (d < 0.25 * shadow_offset)
+			return 0.0;
+		if (t > 0.0)
+			lit = min(lit, shadow_soft * d / t);
+
+		t += max(d, shadow_offset);
+		if (t >= len)
+			break;
+	}
+	return lit;
+#else
+	float step = max(shadow_step, len / max(shadow_budget - 1.0, 1.0));
+	bool outside = (evalAt(orig) >= 0.0);
+	for (float i = 1.0; i < shadow_budget; i += 1.0)
+	{
+		float t = i * step;
+		if (t >= len)
+			break;
+		if ((evalAt(orig + t * dir) >= 0.0) != outside)
+			return 0.0;
+	}
+	return 1.0;
+#endif
+}
+
+#endif // LIB_SHADOWS_GLSL
@@ -0,0 +1,41 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef LIB_TEXELS_GLSL
+#define LIB_TEXELS_GLSL
+
+// Arbitrary data in RGBA textures (see createDataTexture() in
+// GPUTracer.cpp): Texel i is in row i / width. Indices are integers, so
+// they are exact for any texture the GL can hold. Float data is in
+// float textures, indices and counts are in unsigned ones.
+
+vec4 dataTexel(sampler2D s, int i)
+{
+	int w = textureSize(s, 0).x;
+	return texelFetch(s, ivec2(i % w, i / w), 0);
+}
+
+uvec4 dataTexelU(usampler2D s, int i)
+{
+	int w = textureSize(s, 0).x;
+	return texelFetch(s, ivec2(i % w, i / w), 0);
+}
+
+#endif // LIB_TEXELS_GLSL
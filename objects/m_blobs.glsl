@@ -0,0 +1,75 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "lib/instances.glsl"
+
+// Wyvill's kernel: 1 at the center, 0 with zero slope at s = 1.
+float blobKernel(float s)
+{
+	if (s >= 1.0)
+		return 0.0;
+
+	float t = 1.0 - s * s;
+	return t * t * t;
+}
+
+float evalAt(vec3 at)
+{
+	// Any number of blobs, loaded with --instances. To be used with ray
+	// marching. Radii are the radii of influence: Kernels have finite
+	// support, so only the blobs listed in the cell of "at" contribute.
+	// Spheres are metaballs, boxes metacubes (half extents are the
+	// influence) and capsules metapills.
+
+	// Control the threshold with user_params0.w.
+	float threshold = clamp(0.25 + user_params0.w, 0.01, 0.99);
+
+	vec3 cell = floor((at - grid_lo) / grid_cell);
+	if (grid_res.x == 0.0 || outsideGrid(cell))
+		return threshold;
+
+	float sum = 0.0;
+	ivec2 range = instanceCell(cell);
+	for (int k = range.x; k < range.x + range.y; k++)
+	{
+		vec4 p, q;
+		instanceData(instanceRef(k), p, q);
+
+		float s;
+		if (q.w == INSTANCE_SPHERE)
+			s = distance(at, p.xyz) / p.w;
+		else if (q.w == INSTANCE_BOX)
+		{
+			vec3 d = abs(at - p.xyz) / q.xyz;
+			s = max(d.x, max(d.y, d.z));
+		}
+		else
+		{
+			vec3 ba = q.xyz - p.xyz;
+			vec3 pa = at - p.xyz;
+			float h = clamp(dot(pa, ba) / dot(ba, ba), 0.0, 1.0);
+			s = length(pa - h * ba) / p.w;
+		}
+
+		sum += blobKernel(s);
+	}
+
+	return threshold - sum;
+}
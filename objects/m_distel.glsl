@@ -18,6 +18,11 @@
 */
 
 
+#include "lib/interval.glsl"
+
+// Bounds over boxes for ray/interval.glsl and shader_occupancy.glsl.
+#define OBJECT_INTERVAL
+
 float evalAt(vec3 at)
 {
 	// The so-called "distel". To be used with ray marching.
@@ -28,3 +33,16 @@ float evalAt(vec3 at)
 		dot(at.xz, at.xz) *
 		dot(at.yz, at.yz) - 1.0;
 }
+
+vec2 evalInterval(vec3 lo, vec3 hi)
+{
+	// Bounds of evalAt() inside the box from lo to hi. All squares are
+	// positive, so are their products.
+	vec2 x = isqr(vec2(lo.x, hi.x));
+	vec2 y = isqr(vec2(lo.y, hi.y));
+	vec2 z = isqr(vec2(lo.z, hi.z));
+	return iadd(iadd(x, y), z) + 1000.0 *
+		iadd(x, y) *
+		iadd(x, z) *
+		iadd(y, z) - 1.0;
+}
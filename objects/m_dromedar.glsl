@@ -18,6 +18,11 @@
 */
 
 
+#include "lib/interval.glsl"
+
+// Bounds over boxes for ray/interval.glsl and shader_occupancy.glsl.
+#define OBJECT_INTERVAL
+
 float evalAt(vec3 at)
 {
 	// The so-called "dromedar". To be used with ray marching.
@@ -27,3 +32,12 @@ float evalAt(vec3 at)
 		+ at.y * at.y
 		+ at.z * at.z * at.z;
 }
+
+vec2 evalInterval(vec3 lo, vec3 hi)
+{
+	// Bounds of evalAt() inside the box from lo to hi.
+	vec2 x = isqr(vec2(lo.x, hi.x));
+	vec2 y = isqr(vec2(lo.y, hi.y));
+	vec2 z = icube(vec2(lo.z, hi.z));
+	return iadd(iadd(isub(isqr(x), iscale(3.0, x)), y), z);
+}
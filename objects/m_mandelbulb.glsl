@@ -18,14 +18,23 @@
 */
 
 
-float evalAt(vec3 at)
+// Soft shadows from distanceAt(), see lib/shadows.glsl.
+#define OBJECT_DISTANCE
+
+// evalAt() exists in C++ as well, see CpuMarcher.cpp.
+#define OBJECT_MANDELBULB
+
+// |z| of the last iteration and the length of its derivative, for both
+// evalAt() and distanceAt().
+vec2 mandelbulb(vec3 at)
 {
-	// Trig-free order 8 Mandelbulb. To be used with ray marching.
+	// Trig-free order 8 Mandelbulb.
 
 	float eps = 1e-7;
 	vec3 z = at;
 	vec3 c = at;
 	float r = 0.0;
+	float dr = 1.0;
 
 	// Read nMax from first item of second user settings.
 	for (float count = 0.0; count < user_params1.s - 1.0; count += 1.0)
@@ -66,6 +75,7 @@ float evalAt(vec3 at)
 		float rPow = r * r;
 		rPow *= rPow;
 		rPow *= rPow;
+		dr = 8.0 * rPow / r * dr + 1.0;
 
 		// Set new z.
 		z.x = sinThe * cosPhi;
@@ -75,5 +85,21 @@ float evalAt(vec3 at)
 		z += c;
 	}
 
-	return r - 2.0;
+	return vec2(r, dr);
+}
+
+float evalAt(vec3 at)
+{
+	// To be used with ray marching.
+	return mandelbulb(at).x - 2.0;
+}
+
+float distanceAt(vec3 at)
+{
+	// The usual estimate from the derivative. Points that don't escape
+	// are inside, as for evalAt().
+	vec2 r = mandelbulb(at);
+	if (r.x <= 2.0)
+		return 0.0;
+	return 0.5 * log(r.x) * r.x / r.y;
 }
@@ -18,6 +18,11 @@
 */
 
 
+#include "lib/interval.glsl"
+
+// Bounds over boxes for ray/interval.glsl and shader_occupancy.glsl.
+#define OBJECT_INTERVAL
+
 float evalAt(vec3 at)
 {
 	// Simple iso surface cube. To be used with ray marching.
@@ -25,3 +30,12 @@ float evalAt(vec3 at)
 	// This results in x^6 + y^6 + z^6.
 	return dot(at * at * at, at * at * at) - 1.0;
 }
+
+vec2 evalInterval(vec3 lo, vec3 hi)
+{
+	// Bounds of evalAt() inside the box from lo to hi.
+	vec2 x = icube(isqr(vec2(lo.x, hi.x)));
+	vec2 y = icube(isqr(vec2(lo.y, hi.y)));
+	vec2 z = icube(isqr(vec2(lo.z, hi.z)));
+	return iadd(iadd(x, y), z) - 1.0;
+}
@@ -18,6 +18,14 @@
 */
 
 
+#include "lib/interval.glsl"
+
+// Bounds over boxes for ray/interval.glsl and shader_occupancy.glsl.
+#define OBJECT_INTERVAL
+
+// Soft shadows from distanceAt(), see lib/shadows.glsl.
+#define OBJECT_DISTANCE
+
 float evalAt(vec3 at)
 {
 	// Simple iso surface sphere. To be used with ray marching.
@@ -25,3 +33,18 @@ float evalAt(vec3 at)
 	// This results in x^2 + y^2 + z^2.
 	return dot(at, at) - 1.0;
 }
+
+vec2 evalInterval(vec3 lo, vec3 hi)
+{
+	// Bounds of evalAt() inside the box from lo to hi.
+	vec2 x = isqr(vec2(lo.x, hi.x));
+	vec2 y = isqr(vec2(lo.y, hi.y));
+	vec2 z = isqr(vec2(lo.z, hi.z));
+	return iadd(iadd(x, y), z) - 1.0;
+}
+
+float distanceAt(vec3 at)
+{
+	// Signed distance to the surface.
+	return length(at) - 1.0;
+}
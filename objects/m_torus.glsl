@@ -18,6 +18,14 @@
 */
 
 
+#include "lib/interval.glsl"
+
+// Bounds over boxes for ray/interval.glsl and shader_occupancy.glsl.
+#define OBJECT_INTERVAL
+
+// Soft shadows from distanceAt(), see lib/shadows.glsl.
+#define OBJECT_DISTANCE
+
 float evalAt(vec3 at)
 {
 	// A torus. To be used with ray marching.
@@ -32,3 +40,29 @@ float evalAt(vec3 at)
 
 	return t * t - 4.0 * R * dot(at.xy, at.xy);
 }
+
+vec2 evalInterval(vec3 lo, vec3 hi)
+{
+	// Bounds of evalAt() inside the box from lo to hi.
+	float R = 1.0;
+	float r = 0.5;
+
+	R *= R;
+	r *= r;
+
+	vec2 x = isqr(vec2(lo.x, hi.x));
+	vec2 y = isqr(vec2(lo.y, hi.y));
+	vec2 z = isqr(vec2(lo.z, hi.z));
+	vec2 t = iadd(iadd(x, y), z) + R - r;
+
+	return isub(isqr(t), iscale(4.0 * R, iadd(x, y)));
+}
+
+float distanceAt(vec3 at)
+{
+	// Signed distance to the surface.
+	float R = 1.0;
+	float r = 0.5;
+
+	return length(vec2(length(at.xy) - R, at.z)) - r;
+}
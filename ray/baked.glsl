@@ -0,0 +1,167 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Parameters for ray marching. stepsize and accuracy come with the
+// frame, see shader_frame.glsl.
+float normalEps = 1e-5;
+
+// evalAt() sampled on a grid inside a box, see shader_bake.glsl. The
+// object has to be completely inside this box. Levels 1 to baked_levels
+// tell where whole blocks of samples are saturated, see
+// buildBakedLevels() in GPUTracer.cpp.
+uniform sampler3D baked_field;
+uniform vec3 baked_min;
+uniform vec3 baked_size;
+uniform float baked_band;
+uniform int baked_levels;
+
+float evalBaked(vec3 at)
+{
+	// Trilinear interpolation is only an approximation. Close to the
+	// surface, ask the object itself. The baked values are clamped to
+	// the band, so this is everywhere but in empty space and deep inside.
+	float val = textureLod(baked_field, (at - baked_min) / baked_size,
+			0.0).r;
+	if (abs(val) < baked_band)
+		val = evalAt(at);
+	return val;
+}
+
+// How far all samples are saturated around a point where a level is.
+// If the level is saturated there, so are all of its texels that the
+// lookup touched, and they cover at least half a texel in every
+// direction. Less one texel of the finest level, evalBaked() can't see
+// anything else within that distance.
+float bakedReach(int level)
+{
+	int res = textureSize(baked_field, 0).x;
+	return baked_size.x * (0.5 / float(res >> level) - 1.0 / float(res));
+}
+
+// The last step "n" that can be skipped from "at" on, looking at levels
+// "first" and up. A level can only be saturated where the one below is,
+// so the first level that isn't ends the search. evalBaked() would
+// return the sign of "sit" at each of the skipped steps, so the hit
+// doesn't change.
+float skipBaked(vec3 at, float alpha, float n, bool sit, int first)
+{
+	vec3 uvw = (at - baked_min) / baked_size;
+	for (int level = first; level <= baked_levels; level++)
+	{
+		float val = textureLod(baked_field, uvw, float(level)).r;
+		if (abs(val) < baked_band || (val < 0.0) != sit)
+			break;
+
+		n = max(n, floor((alpha + bakedReach(level)) / stepsize));
+	}
+	return n;
+}
+
+bool bounds(in vec3 orig, in vec3 dir, inout float a1, inout float a2)
+{
+	// Slab test against the box.
+	vec3 inv = 1.0 / dir;
+	vec3 t1 = (baked_min - orig) * inv;
+	vec3 t2 = (baked_min + baked_size - orig) * inv;
+	vec3 tmin = min(t1, t2);
+	vec3 tmax = max(t1, t2);
+
+	a1 = max(max(tmin.x, tmin.y), max(tmin.z, 0.0));
+	a2 = min(min(tmax.x, tmax.y), tmax.z);
+	return a1 < a2;
+}
+
+bool findIntersection(in vec3 orig, in vec3 dir, inout vec3 hitpoint,
+	inout vec3 normal)
+{
+	// Raymarching with fixed initial step size and final bisection,
+	// just like marching.glsl. Steps use the baked field, bisection
+	// uses evalAt().
+	float a1 = 0.0;
+	float a2 = 0.0;
+	if (!bounds(orig, dir, a1, a2))
+		return false;
+
+	// Same grid of steps as marching.glsl.
+	float cstep = stepsize;
+	float n = floor(max(a1, ray_start) / cstep) + 1.0;
+	float alpha = cstep * n;
+
+	vec3 at = orig + alpha * dir;
+	float val = evalBaked(at);
+	bool sit = (val < 0.0);
+
+	n += 1.0;
+	alpha = cstep * n;
+
+	bool sitStart = sit;
+
+	// Levels that don't reach two steps far are not worth a lookup.
+	int first = 1;
+	while (first <= baked_levels && bakedReach(first) < 2.0 * stepsize)
+		first++;
+
+	while (alpha < min(a2, ray_end + cstep))
+	{
+		at = orig + alpha * dir;
+		val = evalBaked(at);
+		sit = (val < 0.0);
+
+		// Far from the surface, larger steps.
+		if (first <= baked_levels && sit == sitStart
+				&& abs(val) >= baked_band)
+			n = skipBaked(at, alpha, n, sit, first);
+
+		// Situation changed, start bisection.
+		if (sit != sitStart)
+		{
+			float a1 = alpha - stepsize;
+
+			while (cstep > accuracy)
+			{
+				cstep *= 0.5;
+				alpha = a1 + cstep;
+
+				at = orig + alpha * dir;
+				val = evalAt(at);
+				sit = (val < 0.0);
+
+				if (sit == sitStart)
+					a1 = alpha;
+			}
+
+			hitpoint = at;
+
+			// "Finite difference thing". :)
+			normal.x = evalAt(at + vec3(normalEps, 0, 0));
+			normal.y = evalAt(at + vec3(0, normalEps, 0));
+			normal.z = evalAt(at + vec3(0, 0, normalEps));
+			normal -= val;
+			normal = normalize(normal);
+
+			return true;
+		}
+
+		n += 1.0;
+		alpha = cstep * n;
+	}
+
+	return false;
+}
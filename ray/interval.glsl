@@ -0,0 +1,96 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Parameters for ray marching. stepsize and accuracy come with the
+// frame, see shader_frame.glsl.
+float maxval = 10.0;
+float normalEps = 1e-5;
+
+// At most this many segments are looked at per ray.
+const int maxSegments = 2048;
+
+bool findIntersection(in vec3 orig, in vec3 dir, inout vec3 hitpoint,
+	inout vec3 normal)
+{
+	// Root isolation by interval arithmetic: The ray is split in halves
+	// over and over again, but only those halves whose bounding boxes
+	// may contain the surface according to evalInterval(). Everything
+	// else is certainly empty and skipped as a whole. Once a segment
+	// is shorter than "accuracy", a sign change of evalAt() at its ends
+	// is a hit. There are no fixed steps that could jump over thin
+	// parts. The object has to define evalAt() and evalInterval().
+	//
+	// The segments are visited depth-first, from front to back. n is
+	// the index of the current segment among those of the same length.
+	float total = min(maxval, ray_end) - ray_start;
+	float len = total;
+	float n = 0.0;
+
+	for (int i = 0; i < maxSegments; i++)
+	{
+		float ta = ray_start + n * len;
+		float tb = ta + len;
+		vec3 a = orig + ta * dir;
+		vec3 b = orig + tb * dir;
+
+		vec2 f = evalInterval(min(a, b), max(a, b));
+		if (f.x <= 0.0 && f.y >= 0.0)
+		{
+			if (len > accuracy)
+			{
+				// Look at the first half next.
+				len *= 0.5;
+				n *= 2.0;
+				continue;
+			}
+
+			float fa = evalAt(a);
+			float fb = evalAt(b);
+			if ((fa < 0.0) != (fb < 0.0))
+			{
+				hitpoint = orig + (ta + len * fa / (fa - fb)) * dir;
+
+				// "Finite difference thing". :)
+				float val = evalAt(hitpoint);
+				normal.x = evalAt(hitpoint + vec3(normalEps, 0, 0));
+				normal.y = evalAt(hitpoint + vec3(0, normalEps, 0));
+				normal.z = evalAt(hitpoint + vec3(0, 0, normalEps));
+				normal -= val;
+				normal = normalize(normal);
+
+				return true;
+			}
+		}
+
+		// Go on with the next segment. If that's the second half of a
+		// larger segment, continue with the larger one's successor.
+		n += 1.0;
+		while (mod(n, 2.0) == 0.0 && len < total)
+		{
+			n *= 0.5;
+			len *= 2.0;
+		}
+
+		if (n * len >= total)
+			return false;
+	}
+
+	return false;
+}
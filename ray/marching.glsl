@@ -18,29 +18,37 @@
 */
 
 
-// Parameters for ray marching
-uniform float stepsize;
-uniform float accuracy;
+// Parameters for ray marching. stepsize and accuracy come with the
+// frame, see shader_frame.glsl.
 float maxval = 10.0;
 float normalEps = 1e-5;
 
+// --wavefront marches exactly like this, see shader_fragment.glsl.
+#define RAY_MARCHING
+
 bool findIntersection(in vec3 orig, in vec3 dir, inout vec3 hitpoint,
 	inout vec3 normal)
 {
 	// Raymarching with fixed initial step size and final bisection.
 	// The object has to define evalAt().
 	float cstep = stepsize;
-	float alpha = cstep;
+
+	// Stay on the same grid of steps when starting further away, so
+	// that the result does not depend on where the march started. The
+	// steps are counted instead of summed up for the same reason.
+	float n = floor(ray_start / cstep) + 1.0;
+	float alpha = cstep * n;
 
 	vec3 at = orig + alpha * dir;
 	float val = evalAt(at);
 	bool sit = (val < 0.0);
 
-	alpha += cstep;
+	n += 1.0;
+	alpha = cstep * n;
 
 	bool sitStart = sit;
 
-	while (alpha < maxval)
+	while (alpha < min(maxval, ray_end + cstep))
 	{
 		at = orig + alpha * dir;
 		val = evalAt(at);
@@ -76,7 +84,8 @@ bool findIntersection(in vec3 orig, in vec3 dir, inout vec3 hitpoint,
 			return true;
 		}
 
-		alpha += cstep;
+		n += 1.0;
+		alpha = cstep * n;
 	}
 
 	return false;
@@ -18,9 +18,8 @@
 */
 
 
-// Parameters for ray marching
-uniform float stepsize;
-uniform float accuracy;
+// Parameters for ray marching. stepsize and accuracy come with the
+// frame, see shader_frame.glsl.
 float normalEps = 1e-5;
 
 // Read bounding sphere radius from very last user setting.
@@ -55,6 +54,10 @@ bool findIntersection(in vec3 orig, in vec3 dir, inout vec3 hitpoint,
 	float cstep = stepsize;
 	float alpha = a1;
 
+	// Skip whole steps only, see marching.glsl.
+	if (ray_start > a1)
+		alpha += cstep * floor((ray_start - a1) / cstep);
+
 	vec3 at = orig + alpha * dir;
 	float val = evalAt(at);
 	bool sit = (val < 0.0);
@@ -63,7 +66,7 @@ bool findIntersection(in vec3 orig, in vec3 dir, inout vec3 hitpoint,
 
 	bool sitStart = sit;
 
-	while (alpha < a2)
+	while (alpha < min(a2, ray_end + cstep))
 	{
 		at = orig + alpha * dir;
 		val = evalAt(at);
@@ -0,0 +1,146 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Parameters for ray marching. stepsize and accuracy come with the
+// frame, see shader_frame.glsl.
+float maxval = 10.0;
+float normalEps = 1e-5;
+
+// Same hits as ray/marching.glsl, see shader_fragment.glsl.
+#define RAY_MARCHING
+
+// Coarse grid of cells that may contain the surface, see
+// shader_occupancy.glsl. Outside of it, nothing is known.
+uniform sampler3D occupancy_grid;
+uniform vec3 occupancy_min;
+uniform vec3 occupancy_size;
+uniform float occupancy_res;
+
+bool emptyCell(in vec3 orig, in vec3 dir, in vec3 at, out float leave)
+{
+	// Returns whether "at" is in an empty cell and where the ray leaves
+	// that cell. Nothing has to be checked again before that. Outside
+	// of the grid, the object may still reach on, so that's never
+	// empty. The grid is asked again where the ray enters it.
+	vec3 inv = 1.0 / dir;
+	vec3 p = (at - occupancy_min) / occupancy_size * occupancy_res;
+	if (any(lessThan(p, vec3(0.0))) || any(greaterThanEqual(p,
+		vec3(occupancy_res))))
+	{
+		vec3 t1 = (occupancy_min - orig) * inv;
+		vec3 t2 = (occupancy_min + occupancy_size - orig) * inv;
+		vec3 tmin = min(t1, t2);
+		vec3 tmax = max(t1, t2);
+		float enter = max(max(tmin.x, tmin.y), tmin.z);
+		float exit = min(min(tmax.x, tmax.y), tmax.z);
+
+		leave = (enter < exit && dot(at - orig, dir) < enter ? enter
+			: maxval);
+		return false;
+	}
+
+	vec3 cell = floor(p);
+	vec3 lo = occupancy_min + cell * occupancy_size / occupancy_res;
+	vec3 hi = lo + occupancy_size / occupancy_res;
+	vec3 t = max((lo - orig) * inv, (hi - orig) * inv);
+	leave = min(min(t.x, t.y), t.z);
+
+	return texture(occupancy_grid, (cell + 0.5) / occupancy_res).r < 0.5;
+}
+
+bool findIntersection(in vec3 orig, in vec3 dir, inout vec3 hitpoint,
+	inout vec3 normal)
+{
+	// Just like marching.glsl, but steps that would end up in an empty
+	// cell are skipped, walking from cell to cell instead. They would
+	// have found the same situation as the start anyway. This only
+	// holds if the ray starts outside of the object.
+	float cstep = stepsize;
+
+	// Stay on the same grid of steps when starting further away, so
+	// that the result does not depend on where the march started.
+	float n = floor(ray_start / cstep) + 1.0;
+	float alpha = cstep * n;
+
+	vec3 at = orig + alpha * dir;
+	float val = evalAt(at);
+	bool sit = (val < 0.0);
+
+	n += 1.0;
+	alpha = cstep * n;
+
+	bool sitStart = sit;
+	float known = 0.0;
+
+	while (alpha < min(maxval, ray_end + cstep))
+	{
+		at = orig + alpha * dir;
+
+		if (!sitStart && alpha >= known)
+		{
+			if (emptyCell(orig, dir, at, known))
+			{
+				// First step behind the cell, on the same grid.
+				n = max(n + 1.0, floor(known / cstep) + 1.0);
+				alpha = cstep * n;
+				continue;
+			}
+		}
+
+		val = evalAt(at);
+		sit = (val < 0.0);
+
+		// Situation changed, start bisection.
+		if (sit != sitStart)
+		{
+			float a1 = alpha - stepsize;
+
+			while (cstep > accuracy)
+			{
+				cstep *= 0.5;
+				alpha = a1 + cstep;
+
+				at = orig + alpha * dir;
+				val = evalAt(at);
+				sit = (val < 0.0);
+
+				if (sit == sitStart)
+					a1 = alpha;
+			}
+
+			hitpoint = at;
+
+			// "Finite difference thing". :)
+			normal.x = evalAt(at + vec3(normalEps, 0, 0));
+			normal.y = evalAt(at + vec3(0, normalEps, 0));
+			normal.z = evalAt(at + vec3(0, 0, normalEps));
+			normal -= val;
+			normal = normalize(normal);
+
+			return true;
+		}
+
+		n += 1.0;
+		alpha = cstep * n;
+	}
+
+	return false;
+}
+
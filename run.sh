@@ -3,8 +3,31 @@
 RAY=${1:-ray/marching.glsl}
 OBJECT=${2:-objects/m_mandelbulb.glsl}
 
+# Everything after the first two arguments is passed on to the tracer.
+shift $(( $# < 2 ? $# : 2 ))
+
+# Scenes of several objects become one object first.
+if [[ $OBJECT == *.scene ]]
+then
+	./compose.sh "$OBJECT" scene_final.glsl || exit 1
+	OBJECT=scene_final.glsl
+fi
+
 cpp -P \
 	-DOBJECT_FUNCTIONS=\"$OBJECT\" \
 	-DRAY_FUNCTIONS=\"$RAY\" \
 	shader_fragment.glsl shader_fragment_final.glsl || exit 1
-./tracer
+cpp -P \
+	-DOBJECT_FUNCTIONS=\"$OBJECT\" \
+	shader_bake.glsl shader_bake_final.glsl || exit 1
+cpp -P \
+	-DOBJECT_FUNCTIONS=\"$OBJECT\" \
+	shader_occupancy.glsl shader_occupancy_final.glsl || exit 1
+cpp -P shader_light_tiles.glsl shader_light_tiles_final.glsl || exit 1
+cpp -P \
+	-DOBJECT_FUNCTIONS=\"$OBJECT\" \
+	shader_lights.glsl shader_lights_final.glsl || exit 1
+cpp -P \
+	-DOBJECT_FUNCTIONS=\"$OBJECT\" \
+	shader_wavefront.glsl shader_wavefront_final.glsl || exit 1
+./tracer "$@"
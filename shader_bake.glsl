@@ -0,0 +1,49 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Samples evalAt() on a regular grid, one slice of a 3D texture at a
+// time. Just like shader_fragment.glsl, this has to be processed by CPP
+// first (see run.sh):
+//
+//     $ cpp -P -DOBJECT_FUNCTIONS='"myObject.glsl"' \
+//         shader_bake.glsl shader_bake_final.glsl
+
+uniform vec3 bake_min;
+uniform vec3 bake_size;
+uniform vec2 bake_res;
+uniform float bake_slice;
+uniform float bake_band;
+
+out vec4 out_color;
+
+#include OBJECT_FUNCTIONS
+
+void main(void)
+{
+	// Texel centers, the same positions texture() uses.
+	vec3 uvw = vec3(gl_FragCoord.xy / bake_res, bake_slice);
+	float val = evalAt(bake_min + uvw * bake_size);
+
+	// Most objects are not distance fields and jump around close to the
+	// surface. Clamped to the band, any interpolated value next to a
+	// sample inside the band is inside the band as well, so the marcher
+	// asks evalAt() there.
+	out_color = vec4(clamp(val, -bake_band, bake_band));
+}
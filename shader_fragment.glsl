@@ -18,22 +18,63 @@
 */
 
 
-varying vec3 p;
+// Camera, quality and user settings are in the frame's uniform block,
+// see shader_frame.glsl.
+in vec3 p;
 
-uniform mat4 rot;
-uniform vec3 pos;
-uniform float eyedist;
+// Color and geometry (see shadeRay()) of the first pass.
+out vec4 out_color;
+out vec4 out_geometry;
 
-uniform vec4 user_params0;
-uniform vec4 user_params1;
+// Pass 0 renders the image and stores normal and hit distance in a
+// second buffer. Pass 1 refines pixels at edges of the result: There,
+// aa_samples more rays are shot. All other pixels are discarded.
+uniform int pass;
+uniform vec2 viewport_size;
+uniform sampler2D primary_color;
+uniform sampler2D primary_geometry;
+uniform int aa_samples;
+uniform float aa_depth;
+uniform float aa_normal;
 
-vec3 light0 = gl_LightSource[0].position.xyz;
-vec3 light0_diffuse = gl_LightSource[0].diffuse.xyz;
-vec3 light0_specular = gl_LightSource[0].specular.xyz;
+// Marchers start this far away from the eye. If the hit of the last
+// frame has been reprojected to this pixel, main() moves the start to a
+// little bit in front of it. With a proxy, shadeRay() moves it to where
+// the ray enters the box from proxy_lo to proxy_hi and sets ray_end to
+// where it leaves. Marchers take one more step beyond that.
+uniform int reproject;
+uniform sampler2D reprojected;
+uniform float reproject_margin;
+uniform float reproject_offset;
+uniform int proxy;
+uniform vec3 proxy_lo;
+uniform vec3 proxy_hi;
+float ray_start = 0.0;
+float ray_end = 1e30;
 
-vec3 light1 = gl_LightSource[1].position.xyz;
-vec3 light1_diffuse = gl_LightSource[1].diffuse.xyz;
-vec3 light1_specular = gl_LightSource[1].specular.xyz;
+// With --wavefront, shader_wavefront.glsl has marched the rays of the
+// first pass already. Their hits are in wavefront_hits, which starts at
+// wavefront_origin in window coordinates.
+uniform int wavefront;
+uniform sampler2D wavefront_hits;
+uniform ivec2 wavefront_origin;
+
+// Hits are written to the depth buffer, distances mapped like in
+// shader_reproject_vertex.glsl. Misses are at the far plane.
+float depth_far = 100.0;
+
+// Positions of the headlight and the static light, see main().
+vec3 light0;
+vec3 light1;
+
+// Shadows of the two lights above, 1 where they're on. See
+// objects/lib/shadows.glsl.
+uniform vec2 shadow_lights;
+
+// More lights from --lights. light_count is 0 when the tiled pass in
+// shader_lights.glsl adds them later.
+#define LIGHT_SHADOWS
+#include "objects/lib/lights.glsl"
 
 vec3 object_diffuse = vec3(1.0, 0.7, 0.3);
 float object_shininess = 10.0;
@@ -47,71 +88,205 @@ float object_shininess = 10.0;
 // This will include your object code at this point.
 #include OBJECT_FUNCTIONS
 #include RAY_FUNCTIONS
+#include "objects/lib/shadows.glsl"
+
+// What else can march the first pass for this object and ray file.
+// loadShaders() in GPUTracer.cpp looks for these names, CPP only keeps
+// the ones that apply.
+#if defined(RAY_MARCHING) && !defined(OBJECT_DIRECT)
+const bool can_wavefront = true;
+#endif
+#if defined(RAY_MARCHING) && defined(OBJECT_MANDELBULB)
+const bool can_cpu = true;
+#endif
+
+// Shadow of a built-in light. Lights behind the surface as seen from
+// the eye are always in shadow.
+float builtinShadow(in float on, in vec3 light, in vec3 hitpoint,
+	in vec3 facing)
+{
+	if (on == 0.0)
+		return 1.0;
+
+	vec3 light_dir = normalize(light - hitpoint);
+	if (dot(light_dir, facing) <= 0.0)
+		return 0.0;
+	return shadow(hitpoint, facing, light_dir, distance(light, hitpoint));
+}
 
 void lighting(in vec3 eye, in vec3 hitpoint, in vec3 normal,
 	inout vec3 color)
 {
 	vec3 eye_dir = normalize(eye - hitpoint);
+	vec3 facing = faceforward(normal, -eye_dir, normal);
 	vec3 light_dir;
 	vec3 temp;
 	float diffuse;
 	float specular;
+	float lit;
 
 	// Phong shading for: Headlight.
-	if (gl_LightSource[0].spotCutoff == 1.0)
+	if (light_on.x == 1.0)
 	{
 		light_dir = normalize(light0 - hitpoint);
 		diffuse = max(dot(light_dir, normal), 0.0);
 		specular = max(dot(reflect(-light_dir, normal), eye_dir), 0.0);
-		temp = (light0_diffuse * diffuse);
+		lit = builtinShadow(shadow_lights.x, light0, hitpoint, facing);
+		temp = (light_diffuse[0].xyz * diffuse);
 		temp.xyz *= object_diffuse.xyz;
-		color += temp;
-		color += (light0_specular * pow(specular, object_shininess));
+		color += lit * temp;
+		color += lit * (light_specular[0].xyz
+				* pow(specular, object_shininess));
 	}
 
 	// Phong shading for: Static light.
-	if (gl_LightSource[1].spotCutoff == 1.0)
+	if (light_on.y == 1.0)
 	{
 		light_dir = normalize(light1 - hitpoint);
 		diffuse = max(dot(light_dir, normal), 0.0);
 		specular = max(dot(reflect(-light_dir, normal), eye_dir), 0.0);
-		temp = (light1_diffuse * diffuse);
+		lit = builtinShadow(shadow_lights.y, light1, hitpoint, facing);
+		temp = (light_diffuse[1].xyz * diffuse);
 		temp.xyz *= object_diffuse.xyz;
-		color += temp;
-		color += (light1_specular * pow(specular, object_shininess));
+		color += lit * temp;
+		color += lit * (light_specular[1].xyz
+				* pow(specular, object_shininess));
 	}
+
+	for (int i = 0; i < light_count; i++)
+		color += listLight(i, hitpoint, normal, eye_dir, object_diffuse,
+				object_shininess);
 }
 
-void main(void)
+// Color of the ray through the given point on the viewing plane.
+// geometry is set to the normal and the distance of the hit, the
+// distance is -1 on misses.
+vec3 shadeRay(in vec3 plane, out vec4 geometry)
 {
-	// Ray from eye to interpolated position on viewing plane.
+	// Ray from eye to position on viewing plane.
 	vec3 eye = vec3(0.0, 0.0, 0.0);
-	vec3 poi = p + vec3(0.0, 0.0, -eyedist);
+	vec3 poi = plane + vec3(0.0, 0.0, -eyedist);
 
-	// Rotate them all according to rotation matrix of main program.
+	// Rotate them according to rotation matrix of main program.
 	eye = vec3(rot * vec4(eye, 1.0));
 	poi = vec3(rot * vec4(poi, 1.0));
-	light0 = vec3(rot * vec4(light0, 1.0));
 
 	// Move them to desired position of the eye.
 	eye += pos;
 	poi += pos;
-	light0 += pos;
 
 	vec3 ray = normalize(poi - eye);
 
+	// Only the part of the ray inside of the proxy's box is looked at.
+	// Objects may touch the box, so marching starts a bit in front of
+	// it, just like at reprojected hits: The first step must not land
+	// inside.
+	float start = ray_start;
+	bool inside = true;
+	if (proxy == 1)
+	{
+		vec3 t1 = (proxy_lo - eye) / ray;
+		vec3 t2 = (proxy_hi - eye) / ray;
+		vec3 tmin = min(t1, t2);
+		vec3 tmax = max(t1, t2);
+		float enter = max(max(tmin.x, tmin.y), tmin.z);
+		ray_end = min(min(tmax.x, tmax.y), tmax.z);
+		inside = (enter < ray_end && ray_end > 0.0);
+		ray_start = max(ray_start, enter - reproject_offset);
+	}
+
 	// Does this ray hit the surface of the object?
 	vec3 hitpoint;
 	vec3 normal;
-	if (!findIntersection(eye, ray, hitpoint, normal))
+	bool hit;
+	if (wavefront == 1)
+	{
+		geometry = texelFetch(wavefront_hits,
+				ivec2(gl_FragCoord.xy) - wavefront_origin, 0);
+		hit = (geometry.w >= 0.0);
+		hitpoint = eye + geometry.w * ray;
+		normal = geometry.xyz;
+	}
+	else
+		hit = (inside && findIntersection(eye, ray, hitpoint, normal));
+	ray_start = start;
+	ray_end = 1e30;
+	if (!hit)
 	{
 		// Draw a dark grey on ray misses. Makes debugging easier.
-		gl_FragColor = vec4(0.05, 0.05, 0.05, 1);
-		return;
+		geometry = vec4(0.0, 0.0, 0.0, -1.0);
+		return vec3(0.05, 0.05, 0.05);
 	}
 
 	// There's an intersection with the object, so do lighting.
+	geometry = vec4(normal, distance(eye, hitpoint));
 	vec3 col = vec3(0, 0, 0);
 	lighting(eye, hitpoint, normal, col);
-	gl_FragColor = vec4(col, 1);
+	return col;
+}
+
+// Is the neighbour at the given offset (in pixels) on the other side of
+// a silhouette, a depth step or a crease?
+bool differs(in vec4 center, in vec2 offset)
+{
+	vec4 other = texture(primary_geometry,
+			(gl_FragCoord.xy + offset) / viewport_size);
+
+	if ((center.w < 0.0) != (other.w < 0.0))
+		return true;
+	if (center.w < 0.0)
+		return false;
+
+	return abs(center.w - other.w) > aa_depth * center.w
+		|| dot(center.xyz, other.xyz) < aa_normal;
+}
+
+void main(void)
+{
+	// The headlight moves along with the camera.
+	light0 = vec3(rot * vec4(light_position[0].xyz, 1.0)) + pos;
+	light1 = light_position[1].xyz;
+
+	vec4 geometry;
+	if (pass == 0)
+	{
+		if (reproject == 1)
+		{
+			float d = texture(reprojected,
+					gl_FragCoord.xy / viewport_size).r;
+			if (d > 0.0)
+				ray_start = max(0.0,
+						d * (1.0 - reproject_margin) - reproject_offset);
+		}
+
+		out_color = vec4(shadeRay(p, geometry), 1);
+		out_geometry = geometry;
+		gl_FragDepth = (geometry.w < 0.0 ? 1.0
+				: min(geometry.w / depth_far, 1.0));
+		return;
+	}
+
+	vec2 at = gl_FragCoord.xy / viewport_size;
+	vec4 center = texture(primary_geometry, at);
+	if (!differs(center, vec2(-1.0, 0.0)) && !differs(center, vec2(1.0, 0.0))
+			&& !differs(center, vec2(0.0, -1.0))
+			&& !differs(center, vec2(0.0, 1.0)))
+		discard;
+
+	// Jittered samples inside the pixel: Stratified in y, golden ratio
+	// sequence in x with a random start for each pixel. The viewing
+	// plane is 2 units high.
+	float pixel = 2.0 / viewport_size.y;
+	float start = fract(sin(dot(gl_FragCoord.xy, vec2(12.9898, 78.233)))
+			* 43758.5453);
+	vec3 sum = texture(primary_color, at).rgb;
+	for (int i = 0; i < aa_samples; i++)
+	{
+		vec2 jitter = vec2(fract(start + float(i) * 0.618034),
+				(float(i) + 0.5) / float(aa_samples)) - 0.5;
+		sum += shadeRay(p + vec3(jitter * pixel, 0.0), geometry);
+	}
+
+	out_color = vec4(sum / float(aa_samples + 1), 1);
+	gl_FragDepth = (center.w < 0.0 ? 1.0 : min(center.w / depth_far, 1.0));
 }
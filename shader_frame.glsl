@@ -0,0 +1,52 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Prepended to every shader by buildProgram() and buildCompute() in
+// GPUTracer.cpp, right after the version line, so this file does not go
+// through CPP. Everything that stays the same during a frame is in one
+// uniform buffer. updateFrame() fills it, its layout has to match
+// FrameBlock.
+
+layout(std140) uniform Frame
+{
+	// Camera: Rays start at pos and go through the viewing plane, which
+	// is eyedist away and spans [-ratio, ratio] x [-1, 1]. plane_rect is
+	// the part of it the viewport shows (left, bottom, right, top), see
+	// shader_vertex.glsl.
+	layout(row_major) mat4 rot;
+	vec3 pos;
+	float eyedist;
+	vec4 plane_rect;
+	float ratio;
+
+	// Quality of ray marching.
+	float stepsize;
+	float accuracy;
+
+	vec4 user_params0;
+	vec4 user_params1;
+
+	// Headlight and static light, see lighting() in shader_fragment.glsl.
+	// The headlight's position is relative to the camera.
+	vec4 light_position[2];
+	vec4 light_diffuse[2];
+	vec4 light_specular[2];
+	vec2 light_on;
+};
@@ -0,0 +1,130 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Culling pass for --lights, in three stages. Stage 0 renders one texel
+// per screen tile: The range of distances of the hits in the tile (from
+// the first pass), or -1 if there are none. Stage 1 has one texel per
+// tile and group of 64 lights. It sets the bit of each light of its
+// group that can reach a point of the tile in that range. Each channel
+// holds 16 bits, which floats represent exactly. Stage 2 adds the range
+// of groups with any bits set to the texels of stage 0, so the shading
+// pass skips the empty ones at both ends.
+//
+// Assembled by CPP like shader_fragment.glsl.
+
+#include "objects/lib/lights.glsl"
+
+uniform int stage;
+uniform sampler2D primary_geometry;
+uniform sampler2D tile_depth;
+uniform sampler2D light_tiles;
+uniform vec2 light_tiles_size;
+uniform vec2 viewport_size;
+uniform float tile_size;
+uniform float words;
+
+out vec4 out_color;
+
+vec2 depthRange(vec2 lo, vec2 hi)
+{
+	float near = 1e30;
+	float far = -1.0;
+	for (float y = lo.y; y < hi.y; y += 1.0)
+		for (float x = lo.x; x < hi.x; x += 1.0)
+		{
+			float d = texture(primary_geometry,
+					(vec2(x, y) + 0.5) / viewport_size).w;
+			if (d >= 0.0)
+			{
+				near = min(near, d);
+				far = max(far, d);
+			}
+		}
+	return vec2(near, far);
+}
+
+void main(void)
+{
+	vec2 texel = floor(gl_FragCoord.xy);
+	vec2 tile = vec2(floor(texel.x / words), texel.y);
+	if (stage != 1)
+		tile = texel;
+
+	vec2 lo = tile * tile_size;
+	vec2 hi = min(lo + tile_size, viewport_size);
+	if (stage == 0)
+	{
+		out_color = vec4(depthRange(lo, hi), 0.0, 0.0);
+		return;
+	}
+	if (stage == 2)
+	{
+		// Only z and w get written.
+		vec2 used = vec2(words, 0.0);
+		for (float w = 0.0; w < words; w += 1.0)
+		{
+			vec4 bits = texture(light_tiles,
+					(vec2(tile.x * words + w, tile.y) + 0.5)
+					/ light_tiles_size);
+			if (bits != vec4(0.0))
+				used = vec2(min(used.x, w), w + 1.0);
+		}
+		out_color = vec4(0.0, 0.0, used);
+		return;
+	}
+
+	vec2 range = texture(tile_depth,
+			(tile + 0.5) / ceil(viewport_size / tile_size)).xy;
+	out_color = vec4(0.0);
+	if (range.y < 0.0)
+		return;
+
+	// Planes through the eye and the edges of the tile on the viewing
+	// plane, in camera space. Normals point inwards.
+	vec2 scale = vec2(2.0 * ratio, 2.0) / viewport_size;
+	vec2 a = vec2(-ratio, -1.0) + lo * scale;
+	vec2 b = vec2(-ratio, -1.0) + hi * scale;
+	vec3 left = normalize(vec3(eyedist, 0.0, a.x));
+	vec3 right = normalize(vec3(-eyedist, 0.0, -b.x));
+	vec3 bottom = normalize(vec3(0.0, eyedist, a.y));
+	vec3 top = normalize(vec3(0.0, -eyedist, -b.y));
+
+	float first = mod(texel.x, words) * 64.0;
+	for (float k = 0.0; k < 64.0; k += 1.0)
+	{
+		int i = int(first + k);
+		if (i >= light_count)
+			break;
+
+		// Spheres of point and spot lights against the tile's frustum,
+		// cut off at the nearest and farthest hit. Directional lights
+		// have no radius and reach everything.
+		vec4 p = dataTexel(light_data, 3 * i);
+		vec3 w = p.xyz - pos;
+		vec3 v = vec3(dot(rot[0].xyz, w), dot(rot[1].xyz, w),
+				dot(rot[2].xyz, w));
+		float d = length(v);
+		if (p.w == 0.0 || (dot(left, v) > -p.w && dot(right, v) > -p.w
+					&& dot(bottom, v) > -p.w && dot(top, v) > -p.w
+					&& d - p.w < range.y && d + p.w > range.x))
+			out_color += vec4(equal(vec4(floor(k / 16.0)),
+						vec4(0.0, 1.0, 2.0, 3.0))) * exp2(mod(k, 16.0));
+	}
+}
@@ -0,0 +1,104 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Shading pass for --lights: Adds the lights of each pixel's tile (see
+// shader_light_tiles.glsl) to the result of the first pass. The hit is
+// rebuilt from its distance. Only the groups of lights between the
+// first and the last one with any bits set are looked at. Shadow rays
+// need the object, so this is assembled by CPP like shader_bake.glsl.
+
+// Direct objects read this, see shader_fragment.glsl.
+float ray_start = 0.0;
+
+#define LIGHT_SHADOWS
+#include "objects/lib/lights.glsl"
+
+in vec3 p;
+
+out vec4 out_color;
+
+uniform sampler2D primary_geometry;
+uniform sampler2D tile_depth;
+uniform sampler2D light_tiles;
+uniform vec2 light_tiles_size;
+uniform vec2 viewport_size;
+uniform float tile_size;
+uniform float words;
+
+// Same as in shader_fragment.glsl.
+vec3 object_diffuse = vec3(1.0, 0.7, 0.3);
+float object_shininess = 10.0;
+
+#include OBJECT_FUNCTIONS
+#include "objects/lib/shadows.glsl"
+
+// Lights first, first + 1, ... for each set bit of a 16 bit mask.
+vec3 maskLights(float bits, float first, vec3 hitpoint, vec3 normal,
+	vec3 eye_dir)
+{
+	vec3 color = vec3(0.0);
+	while (bits > 0.0)
+	{
+		// Highest bit left. log2() might be off by a little.
+		float b = floor(log2(bits));
+		if (exp2(b) > bits)
+			b -= 1.0;
+		else if (exp2(b + 1.0) <= bits)
+			b += 1.0;
+		bits -= exp2(b);
+
+		color += listLight(int(first + b), hitpoint, normal, eye_dir,
+				object_diffuse, object_shininess);
+	}
+	return color;
+}
+
+void main(void)
+{
+	vec4 geometry = texture(primary_geometry,
+			gl_FragCoord.xy / viewport_size);
+	if (geometry.w < 0.0)
+		discard;
+
+	// The same ray as in shadeRay().
+	vec3 eye = vec3(rot * vec4(0.0, 0.0, 0.0, 1.0)) + pos;
+	vec3 poi = vec3(rot * vec4(p + vec3(0.0, 0.0, -eyedist), 1.0)) + pos;
+	vec3 ray = normalize(poi - eye);
+
+	vec3 hitpoint = eye + geometry.w * ray;
+	vec3 normal = geometry.xyz;
+
+	vec2 tile = floor(gl_FragCoord.xy / tile_size);
+	vec2 used = texture(tile_depth,
+			(tile + 0.5) / ceil(viewport_size / tile_size)).zw;
+	vec3 color = vec3(0.0);
+	for (float w = used.x; w < used.y; w += 1.0)
+	{
+		vec4 bits = texture(light_tiles,
+				(vec2(tile.x * words + w, tile.y) + 0.5) / light_tiles_size);
+		float first = 64.0 * w;
+		color += maskLights(bits.x, first, hitpoint, normal, -ray);
+		color += maskLights(bits.y, first + 16.0, hitpoint, normal, -ray);
+		color += maskLights(bits.z, first + 32.0, hitpoint, normal, -ray);
+		color += maskLights(bits.w, first + 48.0, hitpoint, normal, -ray);
+	}
+
+	out_color = vec4(color, 0.0);
+}
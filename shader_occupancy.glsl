@@ -0,0 +1,90 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Marks the cells of a coarse grid that may contain a part of the
+// surface, see ray/marching_occupancy.glsl. Processed by CPP just like
+// shader_bake.glsl.
+
+uniform vec3 bake_min;
+uniform vec3 bake_size;
+uniform vec2 bake_res;
+uniform float bake_slice;
+uniform float bake_band;
+
+out vec4 out_color;
+
+#include OBJECT_FUNCTIONS
+
+void main(void)
+{
+	vec3 cell = bake_size / bake_res.x;
+	vec3 lo = bake_min + vec3(floor(gl_FragCoord.xy), floor(bake_slice
+		* bake_res.x)) * cell;
+
+#ifdef OBJECT_INTERVAL
+	// The object knows bounds of evalAt() over boxes, so cells can be
+	// proven to be empty. Large boxes give loose bounds, so if the whole
+	// cell is not obviously empty, its 4^3 subcells are checked (two
+	// levels of an octree). Cells inside the object are never empty.
+	vec3 hi = lo + cell;
+	vec2 f = evalInterval(lo, hi);
+	float occupied = (f.x > 0.0 ? 0.0 : 1.0);
+
+	if (occupied > 0.0 && f.y >= 0.0)
+	{
+		vec3 d = cell / 4.0;
+
+		occupied = 0.0;
+		for (float z = 0.0; z < 4.0; z += 1.0)
+			for (float y = 0.0; y < 4.0; y += 1.0)
+				for (float x = 0.0; x < 4.0; x += 1.0)
+				{
+					vec3 sub = lo + vec3(x, y, z) * d;
+					if (evalInterval(sub, sub + d).x <= 0.0)
+						occupied = 1.0;
+				}
+	}
+#elif defined(OBJECT_DISTANCE)
+	// distanceAt() doesn't overestimate the distance to the surface, so
+	// a cell whose center is farther away than half its diagonal holds
+	// no surface. This is a proof, not sampling, so the band is not
+	// needed. Inside the object, the distance is at most zero.
+	vec3 center = lo + 0.5 * cell;
+	float occupied = (distanceAt(center) > 0.5 * length(cell)
+		? 0.0 : 1.0);
+#else
+	// Objects without bounds of any kind. There's no bound on how fast evalAt() can change, so this is
+	// only sampling. The samples cover a quarter of the neighbouring
+	// cells as well, and anything closer to the surface than the band
+	// counts, which leaves some room for thin parts. Cells inside the
+	// object are never empty.
+	lo -= 0.25 * cell;
+	vec3 d = 1.5 * cell / 4.0;
+
+	float occupied = 0.0;
+	for (float z = 0.0; z <= 4.0; z += 1.0)
+		for (float y = 0.0; y <= 4.0; y += 1.0)
+			for (float x = 0.0; x <= 4.0; x += 1.0)
+				if (evalAt(lo + vec3(x, y, z) * d) < bake_band)
+					occupied = 1.0;
+#endif
+
+	out_color = vec4(occupied);
+}
@@ -0,0 +1,34 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+// Lines of the coordinate system, already in normalized device
+// coordinates, see drawCoordinateSystem() in GPUTracer.cpp.
+in vec3 vertex;
+in vec3 color;
+
+out vec3 shade;
+
+void main(void)
+{
+	gl_Position = vec4(vertex, 1.0);
+	shade = color;
+}
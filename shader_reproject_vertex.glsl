@@ -0,0 +1,66 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Moves the hits of the last frame into the current view. There's one
+// point per pixel, "vertex" holds the texture coordinates of its
+// center. The construction of the rays is the same as in
+// shader_fragment.glsl.
+
+uniform sampler2D previous_geometry;
+
+uniform mat4 prev_rot;
+uniform vec3 prev_pos;
+uniform float prev_eyedist;
+uniform float prev_ratio;
+
+in vec2 vertex;
+
+// Distances are mapped to depth in [0, far].
+float far = 100.0;
+
+out float dist;
+
+void main(void)
+{
+	// Misses are moved out of the clip volume.
+	dist = 0.0;
+	gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+
+	vec4 geometry = textureLod(previous_geometry, vertex, 0.0);
+	if (geometry.w < 0.0)
+		return;
+
+	// Where the ray through this pixel hit the object last time.
+	vec3 plane = vec3((vertex.x * 2.0 - 1.0) * prev_ratio,
+			vertex.y * 2.0 - 1.0, -prev_eyedist);
+	vec3 dir = normalize(vec3(prev_rot * vec4(plane, 1.0)));
+	vec3 hit = prev_pos + geometry.w * dir;
+
+	// The same point in the local coordinates of the current camera.
+	// rot only rotates, so multiplying from the left inverts it.
+	vec3 local = vec3(vec4(hit - pos, 0.0) * rot);
+	if (local.z > -1e-4)
+		return;
+
+	vec2 onPlane = local.xy * (eyedist / -local.z);
+	dist = length(local);
+	gl_Position = vec4(onPlane.x / ratio, onPlane.y, 2.0 * dist / far - 1.0,
+			1.0);
+}
@@ -18,18 +18,19 @@
 */
 
 
-varying vec3 p;
+// Corners in normalized device coordinates: One static quad covering
+// the viewport (see drawQuad() in GPUTracer.cpp) or the faces of the
+// proxy box.
+in vec2 vertex;
+
+out vec3 p;
 
 void main(void)
 {
-	// Keep the original positions of the vertices of the quad by
-	// applying the projection matrix only. It describes an orthographic
-	// projection so the quad will get expanded to the whole screen.
-	gl_Position = gl_ProjectionMatrix * gl_Vertex;
-
-	// Save the positions of all four vertices of the quad. However,
-	// this is a vertex shader and "p" is a varying variable. That
-	// means, this position will get interpolated over the quad. So we
-	// get a point on the viewing plane -- for each pixel.
-	p = gl_Vertex.xyz;
+	gl_Position = vec4(vertex, 0.0, 1.0);
+
+	// The point on the viewing plane that ends up at this corner. "p"
+	// gets interpolated over the quad. So we get a point on the viewing
+	// plane -- for each pixel.
+	p = vec3(mix(plane_rect.xy, plane_rect.zw, 0.5 * vertex + 0.5), 0.0);
 }
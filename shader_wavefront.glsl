@@ -0,0 +1,294 @@
+/*
+	Copyright 2010 Peter Hofmann
+
+	This file is part of GPUTracer.
+
+	GPUTracer is free software: you can redistribute it and/or modify it
+	under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	GPUTracer is distributed in the hope that it will be useful, but
+	WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with GPUTracer. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+// Compute kernel for --wavefront: The rays of the first pass march in
+// chunks of chunk_steps steps, one dispatch per chunk. Rays that are
+// done write their hit to an image and drop out. The others are packed
+// into the queue of the next dispatch, so each dispatch only has as
+// many threads as there are rays left. A single thread in between
+// (prepare_next) turns that number into the size of the next dispatch,
+// which is indirect, so the CPU never waits. shader_fragment.glsl
+// shades the hits afterwards. Processed by CPP just like
+// shader_bake.glsl:
+//
+//     $ cpp -P -DOBJECT_FUNCTIONS='"myObject.glsl"' \
+//         shader_wavefront.glsl shader_wavefront_final.glsl
+//
+// Marching is the same as in ray/marching.glsl, just resumable.
+
+layout(local_size_x = 64) in;
+
+// Rays waiting for this chunk and those left after it: The pixel (the
+// highest bit is the situation at the start), the number of the next
+// step, where the ray ends and the number of steps so far.
+layout(std430, binding = 1) readonly buffer QueueIn
+{
+	uvec4 queue_in[];
+};
+layout(std430, binding = 2) writeonly buffer QueueOut
+{
+	uvec4 queue_out[];
+};
+
+// The groups of the next dispatch, read by glDispatchComputeIndirect(),
+// the rays in queue_out and in queue_in, the steps of all rays and what
+// the steps could have been: Each group of threads takes as long as its
+// longest ray. And the dispatches that had any rays.
+layout(std430, binding = 3) buffer Counters
+{
+	uint groups_x;
+	uint groups_y;
+	uint groups_z;
+	uint queued;
+	uint ray_count;
+	uint steps_done;
+	uint steps_possible;
+	uint dispatches;
+};
+
+// Steps of each ray in the end, see Wavefront::report().
+layout(std430, binding = 4) writeonly buffer PixelSteps
+{
+	uint pixel_steps[];
+};
+
+// Normal and distance of each hit, like out_geometry.
+layout(rgba32f, binding = 0) writeonly uniform image2D hits;
+
+// In the first chunk, there is no queue yet. Each group of threads
+// takes a tile of 8x8 pixels of the region (x, y, width, height), like
+// fragments, and ray_count covers all tiles.
+uniform int prepare_next;
+uniform int first_chunk;
+uniform int chunk_steps;
+uniform ivec4 region;
+uniform vec2 viewport_size;
+
+// Same meaning as in shader_fragment.glsl.
+uniform int reproject;
+uniform sampler2D reprojected;
+uniform float reproject_margin;
+uniform float reproject_offset;
+uniform int proxy;
+uniform vec3 proxy_lo;
+uniform vec3 proxy_hi;
+float ray_start = 0.0;
+
+float maxval = 10.0;
+float normalEps = 1e-5;
+
+#include OBJECT_FUNCTIONS
+
+shared uint scan[64];
+shared uint base;
+shared uint longest;
+
+void finish(in ivec2 pixel, in uint index, in uint steps, in vec4 geometry)
+{
+	imageStore(hits, pixel, geometry);
+	pixel_steps[index] = steps;
+}
+
+void main(void)
+{
+	uint i = gl_GlobalInvocationID.x;
+	uint lane = gl_LocalInvocationIndex;
+
+	if (prepare_next == 1)
+	{
+		if (i == 0u)
+		{
+			ray_count = queued;
+			queued = 0u;
+			groups_x = (ray_count + 63u) / 64u;
+			if (ray_count > 0u)
+				dispatches++;
+		}
+		return;
+	}
+
+	uvec4 ray = uvec4(i, 0u, 0u, 0u);
+	bool alive = false;
+	uint steps = 0u;
+
+	if (lane == 0u)
+		longest = 0u;
+	barrier();
+
+	// Threads of the first chunk outside of the region have nothing to
+	// do. Neither have those beyond the end of the queue.
+	bool hasRay = (i < ray_count);
+	if (hasRay && first_chunk == 1)
+	{
+		int tiles = (region.z + 7) / 8;
+		int tile = int(i) / 64;
+		ivec2 local = 8 * ivec2(tile % tiles, tile / tiles)
+			+ ivec2(int(lane) % 8, int(lane) / 8);
+		hasRay = (local.x < region.z && local.y < region.w);
+		ray.x = uint(local.y * region.z + local.x);
+	}
+	else if (hasRay)
+		ray = queue_in[i];
+
+	if (hasRay)
+	{
+		uint index = ray.x & 0x7fffffffu;
+		ivec2 pixel = region.xy + ivec2(int(index) % region.z,
+				int(index) / region.z);
+		vec2 uv = (vec2(pixel) + 0.5) / viewport_size;
+		vec3 plane = vec3(mix(plane_rect.xy, plane_rect.zw, uv), 0.0);
+
+		// The same ray as in shadeRay().
+		vec3 eye = vec3(rot * vec4(0.0, 0.0, 0.0, 1.0)) + pos;
+		vec3 poi = vec3(rot * vec4(plane + vec3(0.0, 0.0, -eyedist), 1.0))
+			+ pos;
+		vec3 dir = normalize(poi - eye);
+
+		float cstep = stepsize;
+		float n = 0.0;
+		float end = 1e30;
+		bool sitStart = false;
+		alive = true;
+
+		if (first_chunk == 1)
+		{
+			if (reproject == 1)
+			{
+				float d = texelFetch(reprojected, pixel, 0).r;
+				if (d > 0.0)
+					ray_start = max(0.0,
+							d * (1.0 - reproject_margin) - reproject_offset);
+			}
+
+			bool inside = true;
+			if (proxy == 1)
+			{
+				vec3 t1 = (proxy_lo - eye) / dir;
+				vec3 t2 = (proxy_hi - eye) / dir;
+				vec3 tmin = min(t1, t2);
+				vec3 tmax = max(t1, t2);
+				float enter = max(max(tmin.x, tmin.y), tmin.z);
+				end = min(min(tmax.x, tmax.y), tmax.z);
+				inside = (enter < end && end > 0.0);
+				ray_start = max(ray_start, enter - reproject_offset);
+			}
+
+			if (!inside)
+			{
+				finish(pixel, index, 0u, vec4(0.0, 0.0, 0.0, -1.0));
+				alive = false;
+			}
+			else
+			{
+				n = floor(ray_start / cstep) + 1.0;
+				sitStart = (evalAt(eye + cstep * n * dir) < 0.0);
+				n += 1.0;
+				steps = 1u;
+			}
+		}
+		else
+		{
+			sitStart = (ray.x >> 31) == 1u;
+			n = uintBitsToFloat(ray.y);
+			end = uintBitsToFloat(ray.z);
+		}
+
+		for (int k = 0; alive && k < chunk_steps; k++)
+		{
+			float alpha = cstep * n;
+			if (alpha >= min(maxval, end + cstep))
+			{
+				finish(pixel, index, ray.w + steps,
+						vec4(0.0, 0.0, 0.0, -1.0));
+				alive = false;
+				break;
+			}
+
+			vec3 at = eye + alpha * dir;
+			float val = evalAt(at);
+			bool sit = (val < 0.0);
+			steps++;
+
+			// Situation changed, bisection right away: It takes only a
+			// few steps.
+			if (sit != sitStart)
+			{
+				float a1 = alpha - stepsize;
+
+				while (cstep > accuracy)
+				{
+					cstep *= 0.5;
+					alpha = a1 + cstep;
+
+					at = eye + alpha * dir;
+					val = evalAt(at);
+					sit = (val < 0.0);
+					steps++;
+
+					if (sit == sitStart)
+						a1 = alpha;
+				}
+
+				vec3 normal;
+				normal.x = evalAt(at + vec3(normalEps, 0, 0));
+				normal.y = evalAt(at + vec3(0, normalEps, 0));
+				normal.z = evalAt(at + vec3(0, 0, normalEps));
+				normal -= val;
+				normal = normalize(normal);
+
+				finish(pixel, index, ray.w + steps,
+						vec4(normal, distance(eye, at)));
+				alive = false;
+				break;
+			}
+
+			n += 1.0;
+		}
+
+		ray = uvec4(index | (sitStart ? 0x80000000u : 0u),
+				floatBitsToUint(n), floatBitsToUint(end), ray.w + steps);
+		atomicAdd(steps_done, steps);
+		atomicMax(longest, steps);
+	}
+
+	// Prefix sum of the rays left in this group, then one slot in the
+	// next queue for all of them.
+	scan[lane] = (alive ? 1u : 0u);
+	barrier();
+	for (uint d = 1u; d < 64u; d *= 2u)
+	{
+		uint add = (lane >= d ? scan[lane - d] : 0u);
+		barrier();
+		scan[lane] += add;
+		barrier();
+	}
+
+	if (lane == 63u)
+	{
+		base = atomicAdd(queued, scan[63]);
+		atomicAdd(steps_possible, 64u * longest);
+	}
+	barrier();
+
+	if (alive)
+		queue_out[base + scan[lane] - 1u] = ray;
+}